@@ -0,0 +1,376 @@
+#ifndef CACHINGSTORE_H
+#define CACHINGSTORE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "recordStore.h"
+#include "../header/logger.h"
+#include "../header/metrics.h"
+
+namespace DNS {
+
+    // Cache in front of a remote record store (PostgreSQL), so that an outage
+    // or a slow database does not take answers down with it:
+    //
+    //  - Lookups are cached for the records' TTL, capped at maxTtl, and the
+    //    TTLs handed out count down with the entry's age.
+    //  - Expired entries are kept for staleWindow. When the backend fails, or
+    //    has not answered within the deadline, the stale records are served
+    //    with staleTtl (RFC 8767) while the lookup finishes in the background.
+    //    Without stale records a lookup past the deadline fails (SERVFAIL).
+    //  - Entries hit at least prefetchHits times are refreshed in the background
+    //    during the last tenth of their lifetime, so popular names do not all
+    //    expire at once and send a burst of misses to the database.
+    //  - A circuit breaker stops sending lookups after breakerFailures failures
+    //    in a row; after breakerCooldown one probe is let through, and a success
+    //    closes it again. While it is open only stale data is served.
+    //
+    // Backend lookups run on a few refresher threads; concurrent misses for the
+    // same owner share one lookup. A full cache drops its least recently used
+    // entry.
+    class CachingStore : public RecordStore {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit CachingStore(std::unique_ptr<RecordStore> inner)
+            : inner(std::move(inner)), maxTtl(30), staleWindow(86400), staleTtl(30), deadline(1800),
+              breakerFailures(5), breakerCooldown(10), maxEntries(100000), prefetchHits(3) {}
+
+        void setMaxTtl(int seconds) { maxTtl = std::chrono::seconds(seconds); }
+
+        void setStaleWindow(int seconds) { staleWindow = std::chrono::seconds(seconds); }
+
+        void setStaleTtl(int seconds) { staleTtl = seconds; }
+
+        void setDeadline(int milliseconds) { deadline = std::chrono::milliseconds(milliseconds); }
+
+        void setBreaker(int failures, int cooldownSeconds) {
+            breakerFailures = std::max(failures, 1);
+            breakerCooldown = std::chrono::seconds(cooldownSeconds);
+        }
+
+        void setMaxEntries(size_t entries) { maxEntries = entries; }
+
+        // 0 disables refresh-ahead
+        void setPrefetchHits(int hits) { prefetchHits = hits; }
+
+        void start(int threads) {
+            for (int i = 0; i < std::max(threads, 1); i++) {
+                std::thread([this] { refreshLoop(); }).detach();
+            }
+        }
+
+        ZoneRecords zoneRecords(const std::string &zone) override {
+            return inner->zoneRecords(zone);
+        }
+
+        OwnerLookup lookup(const std::string &zone, const std::string &owner) override {
+            std::string key = zone + '\0' + owner;
+            auto now = Clock::now();
+            std::shared_ptr<Fetch> fetch;
+            OwnerLookup stale;
+            bool haveStale = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = cache.find(key);
+                if (it != cache.end()) {
+                    Entry &entry = it->second;
+                    if (now < entry.expires) {
+                        Metrics::add(Metrics::RECORD_CACHE_HITS);
+                        entry.hits++;
+                        recent.splice(recent.begin(), recent, entry.recent);
+                        if (entry.prefetched && now >= entry.replacedExpiry) {
+                            // Without the prefetch this lookup would have gone to the database
+                            Metrics::add(Metrics::PREFETCH_SAVED_MISSES);
+                            entry.prefetched = false;
+                        }
+                        if (prefetchHits > 0 && entry.hits >= prefetchHits && breaker == Breaker::CLOSED &&
+                            now >= entry.expires - (entry.expires - entry.fetched) / PREFETCH_FRACTION &&
+                            inflight.find(key) == inflight.end()) {
+                            Metrics::add(Metrics::PREFETCHES);
+                            startFetch(key, zone, owner, true);
+                        }
+                        auto age = std::chrono::duration_cast<std::chrono::seconds>(now - entry.fetched).count();
+                        if (age == 0) {
+                            return entry.value;
+                        }
+                        return withTtl(entry.value, [age](uint32_t ttl) {
+                            return ttl > age ? ttl - static_cast<uint32_t>(age) : 0;
+                        });
+                    }
+                    if (now < entry.expires + staleWindow) {
+                        stale = entry.value;
+                        haveStale = true;
+                    }
+                }
+                Metrics::add(Metrics::RECORD_CACHE_MISSES);
+
+                auto running = inflight.find(key);
+                if (running != inflight.end()) {
+                    fetch = running->second;
+                } else if (!allowRequest(now)) {
+                    Metrics::add(Metrics::BREAKER_REJECTIONS);
+                    if (haveStale) {
+                        return serveStale(stale);
+                    }
+                    throw std::runtime_error("record store circuit breaker open");
+                } else {
+                    fetch = startFetch(key, zone, owner, false);
+                }
+            }
+
+            std::unique_lock<std::mutex> wait(fetch->mutex);
+            if (!fetch->finished.wait_for(wait, deadline, [&fetch] { return fetch->done; })) {
+                Metrics::add(Metrics::BACKEND_TIMEOUTS);
+                if (haveStale) {
+                    return serveStale(stale);
+                }
+                // Nothing to fall back on: SERVFAIL now, and the lookup still
+                // fills the cache for the client's retry
+                throw std::runtime_error("record store deadline exceeded");
+            }
+            if (fetch->error) {
+                if (haveStale) {
+                    return serveStale(stale);
+                }
+                std::rethrow_exception(fetch->error);
+            }
+            return fetch->result;
+        }
+
+        // Fresh entries only; peeking neither counts as a hit nor fetches
+        std::optional<OwnerLookup> peek(const std::string &zone, const std::string &owner) override {
+            auto now = Clock::now();
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = cache.find(zone + '\0' + owner);
+            if (it == cache.end() || now >= it->second.expires) {
+                return std::nullopt;
+            }
+            auto age = std::chrono::duration_cast<std::chrono::seconds>(now - it->second.fetched).count();
+            return withTtl(it->second.value, [age](uint32_t ttl) {
+                return ttl > age ? ttl - static_cast<uint32_t>(age) : 0;
+            });
+        }
+
+        std::vector<std::string> zoneNames() override {
+            return inner->zoneNames();
+        }
+
+        const char *name() const override { return inner->name(); }
+
+        void setZoneListener(std::function<void(const std::string &zone)> listener) override {
+            inner->setZoneListener(std::move(listener));
+        }
+
+    private:
+
+        struct Fetch {
+            std::mutex mutex;
+            std::condition_variable finished;
+            bool done = false;
+            OwnerLookup result;
+            std::exception_ptr error;
+        };
+
+        struct Request {
+            std::string key;
+            std::string zone;
+            std::string owner;
+            std::shared_ptr<Fetch> fetch;
+            bool prefetch;
+        };
+
+        struct Entry {
+            OwnerLookup value;
+            Clock::time_point fetched;
+            Clock::time_point expires;
+            int hits = 0;
+            // Refreshed ahead of time; replacedExpiry is when the entry it
+            // replaced would have run out
+            bool prefetched = false;
+            Clock::time_point replacedExpiry;
+            std::list<std::string>::iterator recent; // place in the LRU order
+        };
+
+        // Refresh-ahead starts in the last 1/PREFETCH_FRACTION of an entry's lifetime
+        static constexpr int PREFETCH_FRACTION = 10;
+
+        enum class Breaker { CLOSED, OPEN, HALF_OPEN };
+
+        // Queues a backend lookup for key; caller holds mutex
+        std::shared_ptr<Fetch> startFetch(const std::string &key, const std::string &zone, const std::string &owner,
+                                          bool prefetch) {
+            auto fetch = std::make_shared<Fetch>();
+            inflight.emplace(key, fetch);
+            queue.push_back({key, zone, owner, fetch, prefetch});
+            queueReady.notify_one();
+            return fetch;
+        }
+
+        // Breaker check before a backend lookup; caller holds mutex
+        bool allowRequest(Clock::time_point now) {
+            if (breaker == Breaker::CLOSED) {
+                return true;
+            }
+            if (breaker == Breaker::OPEN && now >= openedAt + breakerCooldown) {
+                breaker = Breaker::HALF_OPEN; // this lookup is the probe
+                return true;
+            }
+            return false;
+        }
+
+        // Caller holds mutex
+        void recordOutcome(bool success, Clock::time_point now) {
+            if (success) {
+                if (breaker != Breaker::CLOSED) {
+                    Logger::info("record store recovered, circuit breaker closed");
+                }
+                breaker = Breaker::CLOSED;
+                consecutiveFailures = 0;
+                return;
+            }
+            consecutiveFailures++;
+            if (breaker == Breaker::HALF_OPEN || (breaker == Breaker::CLOSED && consecutiveFailures >= breakerFailures)) {
+                if (breaker == Breaker::CLOSED) {
+                    Metrics::add(Metrics::BREAKER_TRIPS);
+                    Logger::warn("record store failing, circuit breaker open", {{"failures", consecutiveFailures}});
+                }
+                breaker = Breaker::OPEN;
+                openedAt = now;
+            }
+        }
+
+        // Cache lifetime: the smallest TTL among the records, at most maxTtl.
+        // Negative answers go by the apex records, which hold the SOA.
+        Clock::duration freshFor(const OwnerLookup &value) const {
+            Clock::duration lifetime = maxTtl;
+            for (const auto &record: value.records.empty() ? value.apex : value.records) {
+                lifetime = std::min<Clock::duration>(lifetime, std::chrono::seconds(record.ttl));
+            }
+            return lifetime;
+        }
+
+        // Copy of value with every TTL passed through adjust
+        template<typename Adjust>
+        static OwnerLookup withTtl(const OwnerLookup &value, Adjust adjust) {
+            auto copyRange = [&adjust](const RecordRange &range) {
+                auto records = std::make_shared<std::vector<ZoneRecord>>(range.begin(), range.end());
+                for (auto &record: *records) {
+                    record.ttl = adjust(record.ttl);
+                }
+                return RecordRange{records, records->data(), records->size()};
+            };
+            OwnerLookup result;
+            result.zoneFound = value.zoneFound;
+            result.records = copyRange(value.records);
+            result.apex = copyRange(value.apex);
+            return result;
+        }
+
+        OwnerLookup serveStale(const OwnerLookup &stale) const {
+            Metrics::add(Metrics::STALE_ANSWERS);
+            return withTtl(stale, [this](uint32_t ttl) { return std::min(ttl, staleTtl); });
+        }
+
+        // Caller holds mutex
+        void store(const std::string &key, OwnerLookup value, Clock::time_point now, bool prefetch) {
+            Entry entry;
+            entry.value = std::move(value);
+            entry.fetched = now;
+            entry.expires = now + freshFor(entry.value);
+            auto existing = cache.find(key);
+            if (existing != cache.end()) {
+                if (prefetch && now < existing->second.expires) {
+                    entry.prefetched = true;
+                    entry.replacedExpiry = existing->second.expires;
+                }
+                entry.recent = existing->second.recent;
+                recent.splice(recent.begin(), recent, entry.recent);
+                existing->second = std::move(entry);
+                return;
+            }
+            if (maxEntries == 0) {
+                return;
+            }
+            if (cache.size() >= maxEntries) {
+                cache.erase(recent.back());
+                recent.pop_back();
+            }
+            recent.push_front(key);
+            entry.recent = recent.begin();
+            cache.emplace(key, std::move(entry));
+        }
+
+        void refreshLoop() {
+            while (true) {
+                Request request;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    queueReady.wait(lock, [this] { return !queue.empty(); });
+                    request = std::move(queue.front());
+                    queue.pop_front();
+                }
+
+                OwnerLookup result;
+                std::exception_ptr error;
+                try {
+                    result = inner->lookup(request.zone, request.owner);
+                } catch (const std::exception &e) {
+                    Logger::warn("record store lookup failed", {{"zone", request.zone}, {"error", e.what()}});
+                    error = std::current_exception();
+                }
+
+                auto now = Clock::now();
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    inflight.erase(request.key);
+                    recordOutcome(error == nullptr, now);
+                    if (error == nullptr) {
+                        store(request.key, result, now, request.prefetch);
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> lock(request.fetch->mutex);
+                    request.fetch->result = std::move(result);
+                    request.fetch->error = error;
+                    request.fetch->done = true;
+                }
+                request.fetch->finished.notify_all();
+            }
+        }
+
+        std::unique_ptr<RecordStore> inner;
+        Clock::duration maxTtl;
+        Clock::duration staleWindow;
+        uint32_t staleTtl;
+        Clock::duration deadline;
+        int breakerFailures;
+        Clock::duration breakerCooldown;
+        size_t maxEntries;
+        int prefetchHits;
+
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> cache;
+        std::list<std::string> recent; // cache keys, most recently used first
+        std::unordered_map<std::string, std::shared_ptr<Fetch>> inflight;
+        std::deque<Request> queue;
+        std::condition_variable queueReady;
+        Breaker breaker = Breaker::CLOSED;
+        int consecutiveFailures = 0;
+        Clock::time_point openedAt;
+    };
+
+}
+
+#endif // CACHINGSTORE_H
@@ -0,0 +1,64 @@
+#ifndef FAULTSTORE_H
+#define FAULTSTORE_H
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "recordStore.h"
+
+namespace DNS {
+
+    // Wraps another store and makes it slow or unreliable on purpose: every
+    // lookup waits latency plus up to jitter, and errorPercent of them throw as
+    // if the backend were down. Used to benchmark and test failure handling
+    // without a real database outage.
+    class FaultInjectingStore : public RecordStore {
+    public:
+        FaultInjectingStore(std::unique_ptr<RecordStore> inner, int latencyMs, int jitterMs, int errorPercent)
+            : inner(std::move(inner)), latencyMs(latencyMs), jitterMs(jitterMs), errorPercent(errorPercent) {}
+
+        ZoneRecords zoneRecords(const std::string &zone) override {
+            inject();
+            return inner->zoneRecords(zone);
+        }
+
+        OwnerLookup lookup(const std::string &zone, const std::string &owner) override {
+            inject();
+            return inner->lookup(zone, owner);
+        }
+
+        std::vector<std::string> zoneNames() override {
+            return inner->zoneNames();
+        }
+
+        const char *name() const override { return "fault"; }
+
+        void setZoneListener(std::function<void(const std::string &zone)> listener) override {
+            inner->setZoneListener(std::move(listener));
+        }
+
+    private:
+        void inject() {
+            thread_local std::minstd_rand random(std::random_device{}());
+            int delay = latencyMs + (jitterMs > 0 ? static_cast<int>(random() % (jitterMs + 1)) : 0);
+            if (delay > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+            }
+            if (errorPercent > 0 && static_cast<int>(random() % 100) < errorPercent) {
+                throw std::runtime_error("injected record store failure");
+            }
+        }
+
+        std::unique_ptr<RecordStore> inner;
+        int latencyMs;
+        int jitterMs;
+        int errorPercent;
+    };
+
+}
+
+#endif // FAULTSTORE_H
@@ -0,0 +1,104 @@
+#ifndef IMAGESTORE_H
+#define IMAGESTORE_H
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sys/stat.h>
+
+#include "recordStore.h"
+#include "zoneImage.h"
+#include "../header/logger.h"
+
+namespace DNS {
+
+    // Serves from a compiled zone image (see ZoneImage). Startup only maps the
+    // file; pages are read in as they are used. A watcher notices when the file
+    // is replaced (dns-zonec renames the new image into place) and swaps the new
+    // image in atomically; lookups in flight finish on the one they started with.
+    class ImageRecordStore : public RecordStore {
+    public:
+
+        bool load(const std::string &imagePath) {
+            path = imagePath;
+            std::string error;
+            auto opened = ZoneImage::open(path, error);
+            if (opened == nullptr) {
+                std::cerr << "Cannot load zone image " << path << ": " << error << std::endl;
+                return false;
+            }
+            image.store(opened);
+            identity = fileIdentity();
+            std::cout << "Zone image " << path << ": " << opened->zoneCount() << " zones, " << opened->rrsetCount()
+                      << " RRsets, built " << opened->createdAt() << '\n';
+            return true;
+        }
+
+        // Checks every interval whether the file was replaced and reloads it
+        void watch(int intervalSeconds) {
+            std::thread([this, intervalSeconds] {
+                while (true) {
+                    std::this_thread::sleep_for(std::chrono::seconds(intervalSeconds));
+                    std::string current = fileIdentity();
+                    if (current.empty() || current == identity) {
+                        continue;
+                    }
+                    std::string error;
+                    auto opened = ZoneImage::open(path, error);
+                    identity = current;
+                    if (opened == nullptr) {
+                        Logger::warn("zone image not reloaded", {{"path", path}, {"error", error}});
+                        continue;
+                    }
+                    image.store(opened);
+                    Logger::info("zone image reloaded", {{"path", path}, {"zones", opened->zoneCount()},
+                                                         {"built", opened->createdAt()}});
+                    for (const auto &zone: opened->zoneNames()) {
+                        zoneChanged(zone);
+                    }
+                }
+            }).detach();
+        }
+
+        ZoneRecords zoneRecords(const std::string &zone) override {
+            return image.load()->zoneRecords(zone);
+        }
+
+        OwnerLookup lookup(const std::string &zone, const std::string &owner) override {
+            return image.load()->lookup(zone, owner);
+        }
+
+        std::optional<OwnerLookup> peek(const std::string &zone, const std::string &owner) override {
+            return lookup(zone, owner);
+        }
+
+        std::vector<std::string> zoneNames() override {
+            return image.load()->zoneNames();
+        }
+
+        const char *name() const override { return "image"; }
+
+    private:
+
+        // Inode, size and modification time; changes whenever the file is replaced
+        std::string fileIdentity() const {
+            struct stat info{};
+            if (stat(path.c_str(), &info) != 0) {
+                return {};
+            }
+            return std::to_string(info.st_ino) + ":" + std::to_string(info.st_size) + ":" +
+                   std::to_string(info.st_mtim.tv_sec) + "." + std::to_string(info.st_mtim.tv_nsec);
+        }
+
+        std::string path;
+        std::string identity;
+        std::atomic<std::shared_ptr<const ZoneImage>> image;
+    };
+
+}
+
+#endif // IMAGESTORE_H
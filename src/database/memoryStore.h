@@ -0,0 +1,226 @@
+#ifndef MEMORYSTORE_H
+#define MEMORYSTORE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "recordStore.h"
+#include "zoneFile.h"
+#include "../header/rdata.h"
+
+namespace DNS {
+
+    // Zones held in process memory. Each zone is an immutable snapshot: its
+    // records grouped by owner plus an owner index, so a lookup is one hash probe
+    // and hands out a range of the snapshot without copying. Replacing a zone
+    // swaps in a new snapshot; readers holding the old one are unaffected.
+    // Zone and owner names are stored in lowercase.
+    class MemoryRecordStore : public RecordStore {
+    public:
+
+        ZoneRecords zoneRecords(const std::string &zone) override {
+            auto data = find(zone);
+            if (data == nullptr) {
+                return std::make_shared<const std::vector<ZoneRecord>>();
+            }
+            return ZoneRecords(data, &data->records);
+        }
+
+        OwnerLookup lookup(const std::string &zone, const std::string &owner) override {
+            OwnerLookup result;
+            auto data = find(zone);
+            if (data == nullptr) {
+                return result;
+            }
+            result.zoneFound = true;
+            result.records = data->range(data, owner);
+            result.apex = data->range(data, "@");
+            return result;
+        }
+
+        std::optional<OwnerLookup> peek(const std::string &zone, const std::string &owner) override {
+            return lookup(zone, owner);
+        }
+
+        const char *name() const override { return "memory"; }
+
+        void replaceZone(const std::string &zoneName, std::vector<ZoneRecord> records) {
+            std::string zone = lowercaseName(zoneName);
+            for (auto &record: records) {
+                record.name = lowercaseName(std::move(record.name));
+            }
+            auto data = std::make_shared<ZoneData>();
+            data->records = std::move(records);
+            if (!data->buildIndex()) {
+                data->groupByOwner();
+                data->buildIndex();
+            }
+            {
+                std::unique_lock<std::shared_mutex> lock(mutex);
+                zones[zone] = std::move(data);
+            }
+            zoneChanged(zone);
+        }
+
+        size_t zoneCount() {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            return zones.size();
+        }
+
+        std::vector<std::string> zoneNames() override {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            std::vector<std::string> names;
+            for (const auto &[zone, data]: zones) {
+                names.push_back(zone);
+            }
+            return names;
+        }
+
+        // Loads "zone name [ttl] type value..." lines; '#' starts a comment line.
+        // Records without a TTL get defaultTtl. Lines whose value does not
+        // parse are reported and skipped.
+        bool loadFile(const std::string &path, uint32_t defaultTtl = 3600) {
+            std::ifstream file(path);
+            if (!file) {
+                std::cerr << "Cannot open records file " << path << std::endl;
+                return false;
+            }
+            std::unordered_map<std::string, std::vector<ZoneRecord>> loaded;
+            std::string line;
+            size_t lineNumber = 0;
+            while (std::getline(file, line)) {
+                lineNumber++;
+                std::istringstream fields(line);
+                std::string zone, name, type, value;
+                if (!(fields >> zone) || zone[0] == '#' || !(fields >> name >> type)) {
+                    continue;
+                }
+                // An optional TTL sits between the name and the type
+                uint32_t ttl = defaultTtl;
+                if (!type.empty() && std::all_of(type.begin(), type.end(), ::isdigit)) {
+                    ttl = static_cast<uint32_t>(std::strtoul(type.c_str(), nullptr, 10));
+                    if (!(fields >> type)) {
+                        continue;
+                    }
+                }
+                std::getline(fields >> std::ws, value);
+                auto queryType = RRTypes::fromMnemonic(type);
+                if (!queryType) {
+                    std::cerr << path << ":" << lineNumber << ": unknown type '" << type << "'" << std::endl;
+                    continue;
+                }
+                std::vector<uint8_t> rdata;
+                try {
+                    rdata = RData::encode(*queryType, value);
+                } catch (const std::exception &e) {
+                    std::cerr << path << ":" << lineNumber << ": " << e.what() << std::endl;
+                    continue;
+                }
+                loaded[zone].push_back({name, *queryType, value, ttl, std::move(rdata)});
+            }
+            for (auto &[zone, records]: loaded) {
+                replaceZone(zone, std::move(records));
+            }
+            std::cout << "Loaded " << loaded.size() << " zones from " << path << '\n';
+            return true;
+        }
+
+        // Loads an RFC 1035 master file as one zone; an empty zone name is taken
+        // from the file (see ZoneFile::load)
+        bool loadZoneFile(const std::string &path, std::string zone = "") {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<ZoneRecord> records;
+            if (!ZoneFile::load(path, zone, records)) {
+                return false;
+            }
+            size_t count = records.size();
+            replaceZone(zone, std::move(records));
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            std::cout << "Loaded zone " << zone << " (" << count << " records) from " << path << " in "
+                      << elapsed.count() << " ms" << '\n';
+            return true;
+        }
+
+    private:
+
+        struct ZoneData {
+            std::vector<ZoneRecord> records;
+            // owner -> first record and count; keys point into records
+            std::unordered_map<std::string_view, std::pair<uint32_t, uint32_t>> index;
+
+            // Indexes records whose owners are already contiguous, as zone files
+            // and most tables list them; false if some owner is split up
+            bool buildIndex() {
+                index.clear();
+                index.reserve(records.size());
+                for (uint32_t i = 0; i < records.size();) {
+                    uint32_t first = i;
+                    while (i < records.size() && records[i].name == records[first].name) {
+                        i++;
+                    }
+                    if (!index.emplace(records[first].name, std::make_pair(first, i - first)).second) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Brings each owner's records together, keeping their order: owners
+            // are numbered by first appearance and placed with a counting sort
+            void groupByOwner() {
+                std::unordered_map<std::string_view, uint32_t> groups;
+                std::vector<uint32_t> groupOf(records.size());
+                std::vector<uint32_t> offsets;
+                for (size_t i = 0; i < records.size(); i++) {
+                    auto [it, added] = groups.emplace(records[i].name, offsets.size());
+                    if (added) {
+                        offsets.push_back(0);
+                    }
+                    groupOf[i] = it->second;
+                    offsets[it->second]++;
+                }
+                uint32_t first = 0;
+                for (auto &offset: offsets) {
+                    first += std::exchange(offset, first);
+                }
+                std::vector<ZoneRecord> grouped(records.size());
+                for (size_t i = 0; i < records.size(); i++) {
+                    grouped[offsets[groupOf[i]]++] = std::move(records[i]);
+                }
+                records = std::move(grouped);
+            }
+
+            RecordRange range(const std::shared_ptr<const ZoneData> &self, std::string_view owner) const {
+                auto it = index.find(owner);
+                if (it == index.end()) {
+                    return {};
+                }
+                return {self, records.data() + it->second.first, it->second.second};
+            }
+        };
+
+        std::shared_ptr<const ZoneData> find(const std::string &zone) {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = zones.find(zone);
+            return it != zones.end() ? it->second : nullptr;
+        }
+
+        std::shared_mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<const ZoneData>> zones;
+    };
+
+}
+
+#endif // MEMORYSTORE_H
@@ -5,8 +5,11 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <vector>
 
+#include "../header/logger.h"
+
 namespace postegre {
     class Database {
     public:
@@ -17,24 +20,31 @@ namespace postegre {
 
         template<typename... Args>
         pqxx::result execute_query(const std::string& query, Args... args) {
-            if (!connection->is_open()) {
-                std::cerr << "Veritabanı bağlantısı başarısız!" << std::endl;
-                throw std::runtime_error("Veritabanına bağlanılamadı");
+            // One connection is shared by the UDP loop and the TLS connection threads.
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!connection || !connection->is_open()) {
+                connect();
             }
 
-            pqxx::work txn(*connection);
             pqxx::result res;
-
             try {
-                if (sizeof...(args) == 0) {
-                    res = txn.exec(query);
-                } else {
-                    res = txn.exec_params(query, args...);
+                pqxx::work txn(*connection);
+                try {
+                    if (sizeof...(args) == 0) {
+                        res = txn.exec(query);
+                    } else {
+                        res = txn.exec_params(query, args...);
+                    }
+                    txn.commit();
+                } catch (const std::exception& e) {
+                    // Çağıran taraf hatayı zaten warn ile kaydediyor
+                    DNS::Logger::debug("database query failed", {{"error", e.what()}});
+                    txn.abort(); // İşlemi geri al
+                    throw;
                 }
-                txn.commit();
-            } catch (const std::exception& e) {
-                std::cerr << "Hata: " << e.what() << std::endl;
-                txn.abort(); // İşlemi geri al
+            } catch (const pqxx::broken_connection&) {
+                // Bağlantı koptu: bir sonraki sorgu yeniden bağlanır
+                connection.reset();
                 throw;
             }
 
@@ -42,15 +52,29 @@ namespace postegre {
         }
 
     private:
+        std::string connectionString;
         std::unique_ptr<pqxx::connection> connection;
+        std::mutex mutex;
 
         Database(const std::string& conn_str)
-            : connection(std::make_unique<pqxx::connection>(conn_str.empty() ? "host=localhost dbname=test" : conn_str)) {
-            if (connection->is_open()) {
+            : connectionString(conn_str.empty() ? "host=localhost dbname=test" : conn_str) {
+            // Sunucu veritabanı kapalıyken de açılabilsin; ilk sorgu tekrar dener
+            try {
+                connect();
                 std::cout << "Veritabanına başarılı şekilde bağlandınız." << std::endl;
-            } else {
-                std::cerr << "Veritabanı bağlantısı başarısız!" << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "Veritabanı bağlantısı başarısız! " << e.what() << std::endl;
+            }
+        }
+
+        // Caller holds mutex
+        void connect() {
+            connection.reset();
+            auto fresh = std::make_unique<pqxx::connection>(connectionString);
+            if (!fresh->is_open()) {
+                throw pqxx::broken_connection("Veritabanına bağlanılamadı");
             }
+            connection = std::move(fresh);
         }
 
         Database(const Database&) = delete;
@@ -0,0 +1,102 @@
+#ifndef POSTEGRESTORE_H
+#define POSTEGRESTORE_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "postegre.h"
+#include "recordStore.h"
+#include "../header/logger.h"
+#include "../header/rdata.h"
+
+namespace postegre {
+
+    // Reads zones from the dnsrecord_entries table, one query per lookup. A
+    // row's TTL comes from its ttl column; tables without one, and NULLs, get
+    // defaultTtl. Values are encoded to wire format as they are read; rows
+    // whose value does not parse are skipped with a warning. Zone and owner
+    // names are matched and returned in lowercase.
+    class PostgresStore : public DNS::RecordStore {
+    public:
+        explicit PostgresStore(const std::string &conn_str, uint32_t defaultTtl = 3600)
+            : db(Database::get_database(conn_str)), defaultTtl(defaultTtl) {}
+
+        DNS::ZoneRecords zoneRecords(const std::string &zone) override {
+            static const std::string domainQuery =
+                    "SELECT * FROM dnsrecord_entries WHERE archived = FALSE AND deleted = FALSE AND lower(domain_name) = ($1)";
+            pqxx::result rows = db.execute_query(domainQuery, zone);
+
+            auto records = std::make_shared<std::vector<DNS::ZoneRecord>>();
+            records->reserve(rows.size());
+            int ttl = ttlColumn(rows);
+            for (const auto &row: rows) {
+                addRecord(*records, row, ttl);
+            }
+            return records;
+        }
+
+        std::vector<std::string> zoneNames() override {
+            static const std::string zonesQuery =
+                    "SELECT DISTINCT lower(domain_name) AS domain_name FROM dnsrecord_entries WHERE archived = FALSE AND deleted = FALSE";
+            std::vector<std::string> names;
+            for (const auto &row: db.execute_query(zonesQuery)) {
+                names.push_back(row["domain_name"].as<std::string>());
+            }
+            return names;
+        }
+
+        // Every live row, grouped by zone; used to compile zone images
+        std::map<std::string, std::vector<DNS::ZoneRecord>> allRecords() {
+            static const std::string allQuery =
+                    "SELECT * FROM dnsrecord_entries WHERE archived = FALSE AND deleted = FALSE";
+            pqxx::result rows = db.execute_query(allQuery);
+
+            std::map<std::string, std::vector<DNS::ZoneRecord>> zones;
+            int ttl = ttlColumn(rows);
+            for (const auto &row: rows) {
+                addRecord(zones[DNS::lowercaseName(row["domain_name"].as<std::string>())], row, ttl);
+            }
+            return zones;
+        }
+
+        const char *name() const override { return "postgres"; }
+
+    private:
+
+        // Index of the optional ttl column, -1 if the table has none
+        static int ttlColumn(const pqxx::result &rows) {
+            try {
+                return static_cast<int>(rows.column_number("ttl"));
+            } catch (const std::exception &) {
+                return -1;
+            }
+        }
+
+        void addRecord(std::vector<DNS::ZoneRecord> &records, const pqxx::row &row, int ttl) const {
+            auto type = DNS::RRTypes::fromMnemonic(row["type"].as<std::string>());
+            if (!type) {
+                DNS::Logger::warn("skipping record with unknown type", {{"name", row["name"].as<std::string>()},
+                                                                        {"type", row["type"].as<std::string>()}});
+                return;
+            }
+            DNS::ZoneRecord record{DNS::lowercaseName(row["name"].as<std::string>()), *type, row["value"].as<std::string>(),
+                                   ttl < 0 ? defaultTtl : row[ttl].as<uint32_t>(defaultTtl), {}};
+            try {
+                record.rdata = DNS::RData::encode(record.type, record.value);
+            } catch (const std::exception &e) {
+                DNS::Logger::warn("skipping record with invalid value", {{"name", record.name}, {"value", record.value},
+                                                                         {"error", e.what()}});
+                return;
+            }
+            records.push_back(std::move(record));
+        }
+
+        Database &db;
+        uint32_t defaultTtl;
+    };
+
+}
+
+#endif // POSTEGRESTORE_H
@@ -0,0 +1,129 @@
+#ifndef RECORDSTORE_H
+#define RECORDSTORE_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../header/dnsEnum.h"
+
+namespace DNS {
+
+    // One row of a zone as the resolver sees it; name is relative to the zone
+    // ("@" for the apex) and value is the record's presentation-format rdata.
+    // Records loaded from zone files carry pre-encoded wire rdata instead.
+    struct ZoneRecord {
+        std::string name;
+        DnsEnum::QueryType type;
+        std::string value;
+        uint32_t ttl = 3600;
+        std::vector<uint8_t> rdata;
+    };
+
+    using ZoneRecords = std::shared_ptr<const std::vector<ZoneRecord>>;
+
+    // Names are compared case-insensitively (RFC 4343); stores keep zone and
+    // owner names in lowercase and are asked with lowercase names
+    inline std::string lowercaseName(std::string name) {
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        return name;
+    }
+
+    // A run of records inside some snapshot, which it keeps alive
+    struct RecordRange {
+        std::shared_ptr<const void> snapshot;
+        const ZoneRecord *first = nullptr;
+        size_t count = 0;
+
+        const ZoneRecord *begin() const { return first; }
+        const ZoneRecord *end() const { return first + count; }
+        bool empty() const { return count == 0; }
+        size_t size() const { return count; }
+    };
+
+    // What one question needs: the records at its owner name and at the apex
+    struct OwnerLookup {
+        bool zoneFound = false;
+        RecordRange records;
+        RecordRange apex;
+    };
+
+    // Where authoritative data comes from. resolveQuery only talks to this
+    // interface, so the backend (PostgreSQL, in-memory, fault-injecting) is
+    // chosen at startup from the configuration.
+    class RecordStore {
+    public:
+        virtual ~RecordStore() = default;
+
+        // Every record of the zone, or an empty list when it is not ours.
+        // Throws when the backend cannot be reached.
+        virtual ZoneRecords zoneRecords(const std::string &zone) = 0;
+
+        // Records at owner ("@" for the apex), both names in lowercase. The
+        // default filters zoneRecords; indexed stores answer without touching
+        // the rest of the zone.
+        virtual OwnerLookup lookup(const std::string &zone, const std::string &owner) {
+            ZoneRecords all = zoneRecords(zone);
+            auto matched = std::make_shared<std::vector<ZoneRecord>>();
+            auto apex = std::make_shared<std::vector<ZoneRecord>>();
+            for (const auto &record: *all) {
+                if (record.name == owner) {
+                    matched->push_back(record);
+                }
+                if (record.name == "@") {
+                    apex->push_back(record);
+                }
+            }
+            OwnerLookup result;
+            result.zoneFound = !all->empty();
+            result.records = {matched, matched->data(), matched->size()};
+            result.apex = {apex, apex->data(), apex->size()};
+            return result;
+        }
+
+        // Records at owner if the store has them at hand, without a trip to the
+        // backend; used for optional extras such as glue. Nothing by default.
+        virtual std::optional<OwnerLookup> peek(const std::string &/*zone*/, const std::string &/*owner*/) {
+            return std::nullopt;
+        }
+
+        // Names of the zones the store holds, for work done once per zone
+        // (DNSSEC keys). Throws when the backend cannot be reached.
+        virtual std::vector<std::string> zoneNames() = 0;
+
+        virtual const char *name() const = 0;
+
+        // Called with a zone's name each time the store has loaded or replaced
+        // it, for work done once per version of a zone (DNSSEC signatures).
+        // Stores that fetch rows on demand never call it.
+        virtual void setZoneListener(std::function<void(const std::string &zone)> listener) {
+            std::lock_guard<std::mutex> lock(listenerMutex);
+            zoneListener = std::move(listener);
+        }
+
+    protected:
+        void zoneChanged(const std::string &zone) {
+            std::function<void(const std::string &)> listener;
+            {
+                std::lock_guard<std::mutex> lock(listenerMutex);
+                listener = zoneListener;
+            }
+            if (listener) {
+                listener(zone);
+            }
+        }
+
+    private:
+        std::mutex listenerMutex;
+        std::function<void(const std::string &)> zoneListener;
+    };
+
+}
+
+#endif // RECORDSTORE_H
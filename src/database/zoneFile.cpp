@@ -0,0 +1,538 @@
+#include "zoneFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../header/rdata.h"
+
+
+namespace {
+
+    using Wire = std::vector<uint8_t>;
+
+    // Chunks handed to the parser threads; small enough to balance the load,
+    // large enough that per-chunk setup does not matter
+    constexpr size_t CHUNK_BYTES = 4 << 20;
+    constexpr size_t MAX_REPORTED_ERRORS = 10;
+    constexpr int MAX_INCLUDE_DEPTH = 8;
+
+    // TTL of records without one when the file has no $TTL and no earlier record set it
+    constexpr uint32_t FALLBACK_TTL = 3600;
+
+    using ParseError = DNS::RData::Error;
+    using Token = DNS::RData::Token;
+
+    // Read-only mapping of a whole file
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string &path) {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            struct stat info{};
+            if (fstat(fd, &info) == 0) {
+                if (info.st_size == 0) {
+                    opened = true;
+                } else {
+                    void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (mapped != MAP_FAILED) {
+                        madvise(mapped, info.st_size, MADV_WILLNEED);
+                        data = static_cast<const char *>(mapped);
+                        size = info.st_size;
+                        opened = true;
+                    }
+                }
+            }
+            close(fd);
+        }
+
+        ~MappedFile() {
+            if (data != nullptr) {
+                munmap(const_cast<char *>(data), size);
+            }
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool opened = false;
+        const char *data = nullptr;
+        size_t size = 0;
+    };
+
+    using DNS::RRTypes::equalsIgnoreCase;
+
+    bool isDelimiter(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ';' || c == '(' || c == ')' || c == '"';
+    }
+
+    // Splits [begin, end) into entries: one line, or several joined by parentheses
+    class Lexer {
+    public:
+        Lexer(const char *begin, const char *end, size_t line) : line(line), p(begin), end(end) {}
+
+        // Tokens of the next entry; hasOwner tells whether it starts with an owner
+        // name rather than whitespace. False at the end of the input.
+        bool next(std::vector<Token> &tokens, bool &hasOwner, size_t &entryLine) {
+            tokens.clear();
+            while (p < end) {
+                entryLine = line;
+                hasOwner = !isDelimiter(*p);
+                int depth = 0;
+                while (p < end) {
+                    char c = *p;
+                    if (c == '\n') {
+                        line++;
+                        p++;
+                        if (depth == 0) {
+                            break;
+                        }
+                    } else if (c == ' ' || c == '\t' || c == '\r') {
+                        p++;
+                    } else if (c == ';') {
+                        while (p < end && *p != '\n') {
+                            p++;
+                        }
+                    } else if (c == '(') {
+                        depth++;
+                        p++;
+                    } else if (c == ')') {
+                        if (depth == 0) {
+                            throw ParseError("unbalanced ')'");
+                        }
+                        depth--;
+                        p++;
+                    } else if (c == '"') {
+                        const char *start = ++p;
+                        while (p < end && *p != '"') {
+                            if (*p == '\\' && p + 1 < end) {
+                                p++;
+                            }
+                            if (*p == '\n') {
+                                line++;
+                            }
+                            p++;
+                        }
+                        if (p >= end) {
+                            throw ParseError("unterminated quoted string");
+                        }
+                        tokens.push_back({std::string_view(start, p - start), true});
+                        p++;
+                    } else {
+                        const char *start = p;
+                        while (p < end && !isDelimiter(*p)) {
+                            if (*p == '\\' && p + 1 < end) {
+                                p++;
+                            }
+                            p++;
+                        }
+                        tokens.push_back({std::string_view(start, p - start), false});
+                    }
+                }
+                if (depth != 0) {
+                    throw ParseError("missing ')'");
+                }
+                if (!tokens.empty()) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        size_t line;
+
+    private:
+        const char *p;
+        const char *end;
+    };
+
+    // Record classes; NONE and ANY only occur in questions and updates
+    std::optional<uint16_t> classCode(std::string_view text) {
+        auto code = DNS::RRTypes::classCode(text);
+        if (code == static_cast<uint16_t>(DNS::DnsEnum::QueryClass::NONE) ||
+            code == static_cast<uint16_t>(DNS::DnsEnum::QueryClass::ANY)) {
+            return std::nullopt;
+        }
+        return code;
+    }
+
+
+    struct LoadState {
+        std::string zone;
+        std::vector<DNS::ZoneRecord> records;
+        std::vector<std::string> errors;
+        size_t errorCount = 0;
+        size_t outOfZone = 0;
+
+        void error(const std::string &path, size_t line, const std::string &message) {
+            errorCount++;
+            if (errors.size() < MAX_REPORTED_ERRORS) {
+                errors.push_back(path + ":" + std::to_string(line) + ": " + message);
+            }
+        }
+    };
+
+    // A run of entries between two directives, parsed by one thread
+    struct Chunk {
+        const char *begin;
+        const char *end;
+        size_t line;
+        size_t originIndex;
+        std::optional<uint32_t> defaultTtl;     // $TTL in effect
+        const char *previousOwner;              // last owner line before the chunk, if any
+        size_t previousOwnerOrigin;
+
+        std::vector<DNS::ZoneRecord> records{};
+        std::vector<std::pair<size_t, std::string>> errors{};
+        size_t errorCount = 0;
+        size_t outOfZone = 0;
+        size_t inheritedTtl = 0;                // leading records that take the previous chunk's TTL
+        std::optional<uint32_t> lastTtl{};
+    };
+
+    // Owner relative to the zone, or nothing when it lies outside
+    std::optional<std::string> relativeOwner(const Wire &owner, const std::string &zone) {
+        std::string text = DNS::RData::nameText(owner);
+        if (text == zone) {
+            return "@";
+        }
+        if (text.size() > zone.size() && text.compare(text.size() - zone.size(), zone.size(), zone) == 0 &&
+            text[text.size() - zone.size() - 1] == '.') {
+            return text.substr(0, text.size() - zone.size() - 1);
+        }
+        return std::nullopt;
+    }
+
+    std::string_view ownerToken(const char *p, const char *end) {
+        Lexer lexer(p, end, 0);
+        std::vector<Token> tokens;
+        bool hasOwner;
+        size_t line;
+        lexer.next(tokens, hasOwner, line);
+        return tokens.empty() ? std::string_view() : tokens[0].text;
+    }
+
+    void parseChunk(Chunk &chunk, const std::vector<Wire> &origins, const std::string &zone, const char *fileEnd) {
+        Lexer lexer(chunk.begin, chunk.end, chunk.line);
+        const Wire &origin = origins[chunk.originIndex];
+        std::vector<Token> tokens;
+        Wire ownerWire;
+        std::optional<std::string> owner;
+        bool ownerKnown = false;
+
+        auto fail = [&chunk](size_t line, const std::string &message) {
+            chunk.errorCount++;
+            if (chunk.errors.size() < MAX_REPORTED_ERRORS) {
+                chunk.errors.emplace_back(line, message);
+            }
+        };
+
+        while (true) {
+            bool hasOwner = false;
+            size_t line = lexer.line;
+            try {
+                if (!lexer.next(tokens, hasOwner, line)) {
+                    break;
+                }
+            } catch (const ParseError &e) {
+                fail(line, e.what());
+                break;
+            }
+
+            try {
+                size_t i = 0;
+                if (hasOwner) {
+                    ownerWire.clear();
+                    DNS::RData::appendName(ownerWire, tokens[i++].text, origin);
+                    owner = relativeOwner(ownerWire, zone);
+                    ownerKnown = true;
+                } else if (!ownerKnown) {
+                    if (chunk.previousOwner == nullptr) {
+                        throw ParseError("record without an owner name");
+                    }
+                    ownerWire.clear();
+                    DNS::RData::appendName(ownerWire, ownerToken(chunk.previousOwner, fileEnd), origins[chunk.previousOwnerOrigin]);
+                    owner = relativeOwner(ownerWire, zone);
+                    ownerKnown = true;
+                }
+
+                // [TTL] [class] or [class] [TTL] before the type
+                std::optional<uint32_t> ttl;
+                std::optional<uint16_t> recordClass;
+                for (int field = 0; field < 2 && i < tokens.size(); field++) {
+                    if (!ttl && (ttl = DNS::RData::period(tokens[i].text))) {
+                        i++;
+                    } else if (!recordClass && (recordClass = classCode(tokens[i].text))) {
+                        i++;
+                    } else {
+                        break;
+                    }
+                }
+                if (i >= tokens.size()) {
+                    throw ParseError("missing type");
+                }
+                auto type = DNS::RRTypes::typeCode(tokens[i].text);
+                if (!type) {
+                    throw ParseError("unknown type '" + std::string(tokens[i].text) + "'");
+                }
+                if (recordClass && *recordClass != 1) {
+                    throw ParseError("only class IN is supported");
+                }
+                i++;
+                Wire rdata = DNS::RData::encode(*type, tokens.data() + i, tokens.size() - i, origin);
+
+                uint32_t recordTtl;
+                if (ttl) {
+                    recordTtl = *ttl;
+                    chunk.lastTtl = ttl;
+                } else if (chunk.defaultTtl) {
+                    recordTtl = *chunk.defaultTtl;
+                } else if (chunk.lastTtl) {
+                    recordTtl = *chunk.lastTtl;
+                } else {
+                    recordTtl = FALLBACK_TTL;
+                    if (owner) {
+                        chunk.inheritedTtl++;
+                    }
+                }
+
+                if (!owner) {
+                    chunk.outOfZone++;
+                    continue;
+                }
+                chunk.records.push_back({*owner, static_cast<DNS::DnsEnum::QueryType>(*type), {}, recordTtl, std::move(rdata)});
+            } catch (const ParseError &e) {
+                fail(line, e.what());
+            }
+        }
+    }
+
+    std::string includePath(const std::string &file, std::string_view target) {
+        if (!target.empty() && target[0] == '/') {
+            return std::string(target);
+        }
+        size_t slash = file.find_last_of('/');
+        return slash == std::string::npos ? std::string(target) : file.substr(0, slash + 1) + std::string(target);
+    }
+
+    void parseFile(const std::string &path, const Wire &initialOrigin, std::optional<uint32_t> defaultTtl, int depth,
+                   LoadState &state) {
+        MappedFile file(path);
+        if (!file.opened) {
+            state.error(path, 0, "cannot open file");
+            return;
+        }
+        const char *p = file.data;
+        const char *end = file.data + file.size;
+
+        // Sequential pass: directives change the state every later entry is read
+        // with, so they are handled here; everything between them is cut into
+        // chunks at entry boundaries.
+        std::vector<Wire> origins{initialOrigin};
+        size_t originIndex = 0;
+        std::vector<Chunk> chunks;
+        size_t line = 1;
+        const char *previousOwner = nullptr;
+        size_t previousOwnerOrigin = 0;
+
+        auto startChunk = [&](const char *at) {
+            chunks.push_back(Chunk{at, at, line, originIndex, defaultTtl, previousOwner, previousOwnerOrigin});
+        };
+        startChunk(p);
+
+        while (p < end) {
+            if (*p == '$') {
+                const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+                lineEnd = lineEnd == nullptr ? end : lineEnd;
+                chunks.back().end = p;
+                try {
+                    Lexer lexer(p, lineEnd, line);
+                    std::vector<Token> tokens;
+                    bool hasOwner;
+                    size_t entryLine;
+                    lexer.next(tokens, hasOwner, entryLine);
+                    if (equalsIgnoreCase(tokens[0].text, "$ORIGIN") && tokens.size() == 2) {
+                        Wire origin;
+                        DNS::RData::appendName(origin, tokens[1].text, origins[originIndex]);
+                        origins.push_back(std::move(origin));
+                        originIndex = origins.size() - 1;
+                        if (state.zone.empty()) {
+                            state.zone = DNS::RData::nameText(origins.back());
+                        }
+                    } else if (equalsIgnoreCase(tokens[0].text, "$TTL") && tokens.size() == 2) {
+                        defaultTtl = DNS::RData::period(tokens[1].text);
+                        if (!defaultTtl) {
+                            throw ParseError("bad $TTL '" + std::string(tokens[1].text) + "'");
+                        }
+                    } else if (equalsIgnoreCase(tokens[0].text, "$INCLUDE") && (tokens.size() == 2 || tokens.size() == 3)) {
+                        if (depth >= MAX_INCLUDE_DEPTH) {
+                            throw ParseError("$INCLUDE nested too deeply");
+                        }
+                        Wire origin = origins[originIndex];
+                        if (tokens.size() == 3) {
+                            origin.clear();
+                            DNS::RData::appendName(origin, tokens[2].text, origins[originIndex]);
+                        }
+                        parseFile(includePath(path, tokens[1].text), origin, defaultTtl, depth + 1, state);
+                    } else {
+                        throw ParseError("unsupported directive '" + std::string(tokens[0].text) + "'");
+                    }
+                } catch (const ParseError &e) {
+                    state.error(path, line, e.what());
+                }
+                p = lineEnd < end ? lineEnd + 1 : end;
+                line++;
+                startChunk(p);
+                continue;
+            }
+
+            if (static_cast<size_t>(p - chunks.back().begin) >= CHUNK_BYTES) {
+                chunks.back().end = p;
+                startChunk(p);
+            }
+            if (!isDelimiter(*p)) {
+                previousOwner = p;
+                previousOwnerOrigin = originIndex;
+                if (state.zone.empty()) {
+                    // No zone given and no $ORIGIN: the first owner must be the absolute apex
+                    std::string_view owner = ownerToken(p, end);
+                    if (owner.empty() || owner.back() != '.') {
+                        state.error(path, line, "no $ORIGIN and no zone name given");
+                        return;
+                    }
+                    Wire apex;
+                    DNS::RData::appendName(apex, owner, origins[0]);
+                    state.zone = DNS::RData::nameText(apex);
+                    if (originIndex == 0) {
+                        origins[0] = apex;
+                    }
+                }
+            }
+
+            // Skip to the end of the entry, which may span lines inside parentheses
+            int parens = 0;
+            while (p < end) {
+                char c = *p++;
+                if (c == '\n') {
+                    line++;
+                    if (parens <= 0) {
+                        break;
+                    }
+                } else if (c == ';') {
+                    while (p < end && *p != '\n') {
+                        p++;
+                    }
+                } else if (c == '"') {
+                    while (p < end && *p != '"') {
+                        if (*p == '\\') {
+                            p++;
+                        } else if (*p == '\n') {
+                            line++;
+                        }
+                        p++;
+                    }
+                    p++;
+                } else if (c == '\\') {
+                    p++;
+                } else if (c == '(') {
+                    parens++;
+                } else if (c == ')') {
+                    parens--;
+                }
+            }
+        }
+        chunks.back().end = std::min(p, end);
+
+        if (state.zone.empty()) {
+            return;
+        }
+
+        std::atomic<size_t> nextChunk{0};
+        auto worker = [&] {
+            for (size_t i; (i = nextChunk.fetch_add(1)) < chunks.size();) {
+                parseChunk(chunks[i], origins, state.zone, end);
+            }
+        };
+        size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), chunks.size());
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < threadCount; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread: threads) {
+            thread.join();
+        }
+
+        // Without $TTL a record takes the TTL of the record before it, which for
+        // the first records of a chunk only the previous chunks know
+        size_t total = 0;
+        std::optional<uint32_t> carriedTtl;
+        for (auto &chunk: chunks) {
+            if (carriedTtl) {
+                for (size_t i = 0; i < chunk.inheritedTtl; i++) {
+                    chunk.records[i].ttl = *carriedTtl;
+                }
+            }
+            if (chunk.lastTtl) {
+                carriedTtl = chunk.lastTtl;
+            }
+            total += chunk.records.size();
+        }
+
+        state.records.reserve(state.records.size() + total);
+        for (auto &chunk: chunks) {
+            std::move(chunk.records.begin(), chunk.records.end(), std::back_inserter(state.records));
+            std::vector<DNS::ZoneRecord>().swap(chunk.records);
+            for (const auto &[errorLine, message]: chunk.errors) {
+                state.error(path, errorLine, message);
+            }
+            state.errorCount += chunk.errorCount - chunk.errors.size();
+            state.outOfZone += chunk.outOfZone;
+        }
+    }
+
+}
+
+bool DNS::ZoneFile::load(const std::string &path, std::string &zone, std::vector<ZoneRecord> &records) {
+    LoadState state;
+    Wire origin;
+    try {
+        if (!zone.empty()) {
+            DNS::RData::appendName(origin, zone + ".", {});
+        } else {
+            origin.push_back(0);
+        }
+    } catch (const ParseError &e) {
+        std::cerr << "Bad zone name " << zone << ": " << e.what() << std::endl;
+        return false;
+    }
+    state.zone = DNS::RData::nameText(origin);
+
+    parseFile(path, origin, std::nullopt, 0, state);
+
+    if (state.errorCount > 0 || state.zone.empty()) {
+        for (const auto &message: state.errors) {
+            std::cerr << message << '\n';
+        }
+        std::cerr << "Zone file " << path << " rejected with " << state.errorCount << " errors" << std::endl;
+        return false;
+    }
+    if (state.outOfZone > 0) {
+        std::cerr << "Ignored " << state.outOfZone << " records outside " << state.zone << " in " << path << '\n';
+    }
+    zone = state.zone;
+    records = std::move(state.records);
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef ZONEFILE_H
+#define ZONEFILE_H
+
+#include <string>
+#include <vector>
+
+#include "recordStore.h"
+
+namespace DNS {
+
+    // Loader for RFC 1035 master files: $ORIGIN, $TTL, $INCLUDE, parentheses,
+    // comments, quoted strings and escapes. The file is memory-mapped and walked
+    // once to handle the directives and cut the rest into chunks that start on
+    // an entry boundary; the chunks are then parsed on all cores. Rdata is
+    // encoded to wire format while loading, so serving a record never parses
+    // text again.
+    class ZoneFile {
+    public:
+        // Parses the master file at path into records of zone. An empty zone is
+        // taken from the file's first $ORIGIN or absolute owner name. Owners are
+        // returned relative to the zone ("@" for the apex) and lowercased;
+        // records outside the zone are skipped. Returns false, after printing the
+        // first errors with their line numbers, if any entry is invalid.
+        static bool load(const std::string &path, std::string &zone, std::vector<ZoneRecord> &records);
+    };
+
+}
+
+#endif // ZONEFILE_H
@@ -0,0 +1,384 @@
+#include "zoneImage.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../header/rdata.h"
+
+
+namespace {
+
+    using namespace DNS::ImageFormat;
+
+    std::string lowercase(std::string_view text) {
+        std::string out(text);
+        std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+        return out;
+    }
+
+    bool tableFits(uint64_t offset, uint64_t count, size_t entrySize, size_t imageSize) {
+        return offset % 8 == 0 && offset <= imageSize && count <= (imageSize - offset) / entrySize;
+    }
+
+    uint64_t align8(uint64_t value) {
+        return (value + 7) & ~uint64_t(7);
+    }
+
+    bool writeAll(int fd, const void *data, size_t length) {
+        const char *bytes = static_cast<const char *>(data);
+        while (length > 0) {
+            ssize_t n = ::write(fd, bytes, length);
+            if (n <= 0) {
+                return false;
+            }
+            bytes += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    // Zone being compiled: owner trie with the records of each RRset
+    struct BuildNode {
+        std::string label;
+        std::map<std::string, std::unique_ptr<BuildNode>> children;
+        std::map<uint16_t, std::vector<std::pair<const DNS::ZoneRecord *, std::vector<uint8_t>>>> rrsets; // with wire rdata
+    };
+
+}
+
+std::shared_ptr<const DNS::ZoneImage> DNS::ZoneImage::open(const std::string &path, std::string &error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = std::string("cannot open: ") + strerror(errno);
+        return nullptr;
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+        close(fd);
+        error = "file too small";
+        return nullptr;
+    }
+    void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        error = std::string("mmap failed: ") + strerror(errno);
+        return nullptr;
+    }
+
+    std::shared_ptr<ZoneImage> image(new ZoneImage());
+    image->base = static_cast<const char *>(mapped);
+    image->size = info.st_size;
+    image->header = reinterpret_cast<const Header *>(image->base);
+
+    const Header &header = *image->header;
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = "not a zone image";
+    } else if (header.version != VERSION) {
+        error = "image version " + std::to_string(header.version) + ", expected " + std::to_string(VERSION);
+    } else if (header.byteOrder != ENDIAN_MARK) {
+        error = "image written with a different byte order";
+    } else if (header.imageSize != image->size) {
+        error = "truncated image";
+    } else if (!tableFits(header.zonesOffset, header.zoneCount, sizeof(Zone), image->size) ||
+               !tableFits(header.nodesOffset, header.nodeCount, sizeof(Node), image->size) ||
+               !tableFits(header.rrsetsOffset, header.rrsetCount, sizeof(RRset), image->size) ||
+               !tableFits(header.rdatasOffset, header.rdataCount, sizeof(Rdata), image->size) ||
+               !tableFits(header.bytesOffset, header.bytesSize, 1, image->size)) {
+        error = "corrupt section table";
+    }
+    if (!error.empty()) {
+        return nullptr;
+    }
+    image->zones = reinterpret_cast<const Zone *>(image->base + header.zonesOffset);
+    image->nodes = reinterpret_cast<const Node *>(image->base + header.nodesOffset);
+    image->rrsets = reinterpret_cast<const RRset *>(image->base + header.rrsetsOffset);
+    image->rdatas = reinterpret_cast<const Rdata *>(image->base + header.rdatasOffset);
+    image->pool = image->base + header.bytesOffset;
+    return image;
+}
+
+DNS::ZoneImage::~ZoneImage() {
+    if (base != nullptr) {
+        munmap(const_cast<char *>(base), size);
+    }
+}
+
+const DNS::ImageFormat::Zone *DNS::ZoneImage::findZone(std::string_view name) const {
+    const Zone *end = zones + header->zoneCount;
+    const Zone *zone = std::lower_bound(zones, end, name, [this](const Zone &entry, std::string_view key) {
+        return bytes(entry.name, entry.nameLength) < key;
+    });
+    if (zone == end || bytes(zone->name, zone->nameLength) != name) {
+        return nullptr;
+    }
+    return zone;
+}
+
+std::vector<std::string> DNS::ZoneImage::zoneNames() const {
+    std::vector<std::string> names;
+    names.reserve(header->zoneCount);
+    for (const Zone *zone = zones; zone != zones + header->zoneCount; zone++) {
+        names.emplace_back(bytes(zone->name, zone->nameLength));
+    }
+    return names;
+}
+
+const DNS::ImageFormat::Node *DNS::ZoneImage::findOwner(const Zone &zone, std::string_view owner) const {
+    const Node *node = &nodes[zone.root];
+    if (owner == "@") {
+        return node;
+    }
+    // Walk the labels from the one closest to the apex
+    size_t end = owner.size();
+    while (true) {
+        size_t dot = end == 0 ? std::string_view::npos : owner.rfind('.', end - 1);
+        size_t start = dot == std::string_view::npos ? 0 : dot + 1;
+        std::string_view label = owner.substr(start, end - start);
+        if (node->firstChild > header->nodeCount || node->childCount > header->nodeCount - node->firstChild) {
+            return nullptr;
+        }
+        const Node *first = nodes + node->firstChild;
+        const Node *last = first + node->childCount;
+        const Node *child = std::lower_bound(first, last, label, [this](const Node &entry, std::string_view key) {
+            return bytes(entry.label, entry.labelLength) < key;
+        });
+        if (child == last || bytes(child->label, child->labelLength) != label) {
+            return nullptr;
+        }
+        node = child;
+        if (start == 0) {
+            return node;
+        }
+        end = start - 1;
+    }
+}
+
+void DNS::ZoneImage::appendRecords(const Node &node, const std::string &name, std::vector<ZoneRecord> &out) const {
+    for (uint32_t i = 0; i < node.rrsetCount && node.firstRRset + i < header->rrsetCount; i++) {
+        const RRset &rrset = rrsets[node.firstRRset + i];
+        for (uint32_t j = 0; j < rrset.rdataCount && rrset.firstRdata + j < header->rdataCount; j++) {
+            const Rdata &rdata = rdatas[rrset.firstRdata + j];
+            std::string_view data = bytes(rdata.offset, rdata.length);
+            ZoneRecord record{name, static_cast<DnsEnum::QueryType>(rrset.type), {}, rrset.ttl, {}};
+            if (rdata.flags & RDATA_TEXT) {
+                // Encoded here like every other store's rows
+                record.value.assign(data);
+                try {
+                    record.rdata = RData::encode(record.type, record.value);
+                } catch (const RData::Error &) {
+                    // kept as text; createResponse answers SERVFAIL for it
+                }
+            } else {
+                record.rdata.assign(data.begin(), data.end());
+            }
+            out.push_back(std::move(record));
+        }
+    }
+}
+
+DNS::OwnerLookup DNS::ZoneImage::lookup(const std::string &zoneName, const std::string &owner) const {
+    OwnerLookup result;
+    const Zone *zone = findZone(lowercase(zoneName));
+    if (zone == nullptr || zone->root >= header->nodeCount) {
+        return result;
+    }
+    result.zoneFound = true;
+
+    auto records = std::make_shared<std::vector<ZoneRecord>>();
+    auto apex = std::make_shared<std::vector<ZoneRecord>>();
+    if (const Node *node = findOwner(*zone, lowercase(owner))) {
+        appendRecords(*node, owner, *records);
+    }
+    appendRecords(nodes[zone->root], "@", *apex);
+    result.records = {records, records->data(), records->size()};
+    result.apex = {apex, apex->data(), apex->size()};
+    return result;
+}
+
+DNS::ZoneRecords DNS::ZoneImage::zoneRecords(const std::string &zoneName) const {
+    auto records = std::make_shared<std::vector<ZoneRecord>>();
+    const Zone *zone = findZone(lowercase(zoneName));
+    if (zone == nullptr || zone->root >= header->nodeCount) {
+        return records;
+    }
+    std::vector<std::pair<uint32_t, std::string>> pending{{zone->root, "@"}};
+    while (!pending.empty()) {
+        auto [index, name] = std::move(pending.back());
+        pending.pop_back();
+        const Node &node = nodes[index];
+        appendRecords(node, name, *records);
+        // As in findOwner; children also come after their parent (breadth first),
+        // so a damaged image cannot send the walk round in a loop
+        if (node.firstChild > header->nodeCount || node.childCount > header->nodeCount - node.firstChild ||
+            (node.childCount != 0 && node.firstChild <= index)) {
+            continue;
+        }
+        for (uint32_t i = 0; i < node.childCount; i++) {
+            const Node &child = nodes[node.firstChild + i];
+            std::string label(bytes(child.label, child.labelLength));
+            pending.emplace_back(node.firstChild + i, name == "@" ? label : label + "." + name);
+        }
+    }
+    return records;
+}
+
+bool DNS::ZoneImage::write(const std::string &path, const std::map<std::string, std::vector<ZoneRecord>> &input,
+                           std::vector<std::string> &skipped, std::string &error) {
+    std::vector<Zone> zoneTable;
+    std::vector<Node> nodeTable;
+    std::vector<RRset> rrsetTable;
+    std::vector<Rdata> rdataTable;
+    std::string pool;
+
+    auto addBytes = [&pool](std::string_view data) {
+        if (pool.size() + data.size() > UINT32_MAX) {
+            throw std::length_error("image byte pool exceeds 4 GiB");
+        }
+        uint32_t offset = pool.size();
+        pool.append(data);
+        return offset;
+    };
+
+    // Zones sorted by lowercase name, which is the lookup order
+    std::map<std::string, const std::vector<ZoneRecord> *> sortedZones;
+    for (const auto &[name, records]: input) {
+        sortedZones.emplace(lowercase(name), &records);
+    }
+
+    try {
+        for (const auto &[zoneName, records]: sortedZones) {
+            BuildNode root;
+            for (const auto &record: *records) {
+                std::vector<uint8_t> wire = record.rdata;
+                if (wire.empty()) {
+                    try {
+                        wire = RData::encode(record.type, record.value);
+                    } catch (const RData::Error &e) {
+                        skipped.push_back(record.name + "." + zoneName + ": " + e.what());
+                        continue;
+                    }
+                }
+                BuildNode *node = &root;
+                std::string owner = lowercase(record.name);
+                if (owner != "@" && !owner.empty()) {
+                    size_t end = owner.size();
+                    while (true) {
+                        size_t dot = owner.rfind('.', end - 1);
+                        size_t start = (dot == std::string::npos) ? 0 : dot + 1;
+                        std::string label = owner.substr(start, end - start);
+                        auto &child = node->children[label];
+                        if (child == nullptr) {
+                            child = std::make_unique<BuildNode>();
+                            child->label = label;
+                        }
+                        node = child.get();
+                        if (start == 0) {
+                            break;
+                        }
+                        end = start - 1;
+                    }
+                }
+                node->rrsets[static_cast<uint16_t>(record.type)].emplace_back(&record, std::move(wire));
+            }
+
+            Zone zone{};
+            zone.name = addBytes(zoneName);
+            zone.nameLength = zoneName.size();
+            zone.root = nodeTable.size();
+
+            // Breadth first, so every node's children get consecutive indexes
+            std::vector<const BuildNode *> order{&root};
+            for (size_t i = 0; i < order.size(); i++) {
+                const BuildNode *node = order[i];
+                Node entry{};
+                entry.label = addBytes(node->label);
+                entry.labelLength = node->label.size();
+                entry.firstChild = zone.root + order.size();
+                entry.childCount = node->children.size();
+                for (const auto &[label, child]: node->children) {
+                    order.push_back(child.get());
+                }
+                entry.firstRRset = rrsetTable.size();
+                entry.rrsetCount = node->rrsets.size();
+                for (const auto &[type, members]: node->rrsets) {
+                    RRset rrset{};
+                    rrset.type = type;
+                    rrset.ttl = UINT32_MAX;
+                    rrset.firstRdata = rdataTable.size();
+                    rrset.rdataCount = members.size();
+                    for (const auto &[record, wire]: members) {
+                        // One TTL per RRset (RFC 2181 section 5.2)
+                        rrset.ttl = std::min(rrset.ttl, record->ttl);
+                        Rdata rdata{};
+                        std::string_view data(reinterpret_cast<const char *>(wire.data()), wire.size());
+                        if (data.size() > UINT16_MAX) {
+                            throw std::length_error("rdata longer than 65535 bytes at " + record->name + "." + zoneName);
+                        }
+                        rdata.offset = addBytes(data);
+                        rdata.length = data.size();
+                        rdataTable.push_back(rdata);
+                    }
+                    rrsetTable.push_back(rrset);
+                }
+                nodeTable.push_back(entry);
+            }
+            zone.nodeCount = order.size();
+            zoneTable.push_back(zone);
+        }
+    } catch (const std::exception &e) {
+        error = e.what();
+        return false;
+    }
+
+    Header header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = ENDIAN_MARK;
+    header.createdAt = static_cast<uint64_t>(time(nullptr));
+    header.zoneCount = zoneTable.size();
+    header.nodeCount = nodeTable.size();
+    header.rrsetCount = rrsetTable.size();
+    header.rdataCount = rdataTable.size();
+    header.zonesOffset = align8(sizeof(Header));
+    header.nodesOffset = align8(header.zonesOffset + zoneTable.size() * sizeof(Zone));
+    header.rrsetsOffset = align8(header.nodesOffset + nodeTable.size() * sizeof(Node));
+    header.rdatasOffset = align8(header.rrsetsOffset + rrsetTable.size() * sizeof(RRset));
+    header.bytesOffset = align8(header.rdatasOffset + rdataTable.size() * sizeof(Rdata));
+    header.bytesSize = pool.size();
+    header.imageSize = header.bytesOffset + pool.size();
+
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = "cannot create " + temporary + ": " + strerror(errno);
+        return false;
+    }
+    static const char padding[8] = {};
+    uint64_t written = 0;
+    auto section = [&](uint64_t offset, const void *data, size_t length) {
+        bool ok = writeAll(fd, padding, offset - written) && writeAll(fd, data, length);
+        written = offset + length;
+        return ok;
+    };
+    bool ok = section(0, &header, sizeof(header)) &&
+              section(header.zonesOffset, zoneTable.data(), zoneTable.size() * sizeof(Zone)) &&
+              section(header.nodesOffset, nodeTable.data(), nodeTable.size() * sizeof(Node)) &&
+              section(header.rrsetsOffset, rrsetTable.data(), rrsetTable.size() * sizeof(RRset)) &&
+              section(header.rdatasOffset, rdataTable.data(), rdataTable.size() * sizeof(Rdata)) &&
+              section(header.bytesOffset, pool.data(), pool.size()) &&
+              fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+        error = "cannot write " + path + ": " + strerror(errno);
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,152 @@
+#ifndef ZONEIMAGE_H
+#define ZONEIMAGE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "recordStore.h"
+
+namespace DNS {
+
+    // Compiled zone snapshot: every zone's owner names as a label trie, their
+    // RRsets and pre-encoded rdata, in one file that is mapped read-only and
+    // served from in place. All references inside are offsets or indexes from
+    // the start of the image, so it is position independent and the kernel
+    // shares its pages between every process that maps it.
+    //
+    // Layout: Header, then the zone, node, RRset and rdata tables, then a
+    // byte pool holding labels, zone names and rdata. The nodes of a zone are
+    // stored breadth first, so each node's children are adjacent and sorted by
+    // label for binary search.
+    namespace ImageFormat {
+
+        constexpr char MAGIC[8] = {'D', 'N', 'S', 'Z', 'I', 'M', 'G', 0};
+        constexpr uint32_t VERSION = 1;
+        constexpr uint32_t ENDIAN_MARK = 0x01020304;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t byteOrder;
+            uint64_t imageSize;
+            uint64_t createdAt;         // seconds since the epoch, identifies the build
+            uint32_t zoneCount;
+            uint32_t nodeCount;
+            uint32_t rrsetCount;
+            uint32_t rdataCount;
+            uint64_t zonesOffset;
+            uint64_t nodesOffset;
+            uint64_t rrsetsOffset;
+            uint64_t rdatasOffset;
+            uint64_t bytesOffset;
+            uint64_t bytesSize;
+        };
+
+        struct Zone {
+            uint32_t name;              // pool offset, lowercase, no trailing dot
+            uint32_t nameLength;
+            uint32_t root;              // node of the apex
+            uint32_t nodeCount;         // nodes of this zone, starting at root
+        };
+
+        struct Node {
+            uint32_t label;             // pool offset
+            uint32_t labelLength;
+            uint32_t firstChild;
+            uint32_t childCount;
+            uint32_t firstRRset;
+            uint32_t rrsetCount;
+        };
+
+        struct RRset {
+            uint16_t type;
+            uint16_t reserved;
+            uint32_t ttl;
+            uint32_t firstRdata;
+            uint32_t rdataCount;
+        };
+
+        // Rdata kept as presentation text and encoded when served. Only images
+        // from older compilers have it; rows that cannot be encoded are now
+        // left out of the image
+        enum RdataFlags : uint16_t { RDATA_TEXT = 1 };
+
+        struct Rdata {
+            uint32_t offset;            // pool offset
+            uint16_t length;
+            uint16_t flags;
+        };
+
+        static_assert(sizeof(Header) == 96);
+        static_assert(sizeof(Zone) == 16);
+        static_assert(sizeof(Node) == 24);
+        static_assert(sizeof(RRset) == 16);
+        static_assert(sizeof(Rdata) == 8);
+    }
+
+    // A mapped image. Lookups copy the few records they return, so an image
+    // can be replaced while answers built from it are still in flight.
+    class ZoneImage {
+    public:
+        // Maps path and validates it; nullptr, with the reason in error, if it is
+        // not an image of this version
+        static std::shared_ptr<const ZoneImage> open(const std::string &path, std::string &error);
+
+        ~ZoneImage();
+
+        OwnerLookup lookup(const std::string &zone, const std::string &owner) const;
+
+        ZoneRecords zoneRecords(const std::string &zone) const;
+
+        std::vector<std::string> zoneNames() const;
+
+        uint32_t zoneCount() const { return header->zoneCount; }
+
+        uint32_t rrsetCount() const { return header->rrsetCount; }
+
+        uint64_t createdAt() const { return header->createdAt; }
+
+        // Compiles zones into an image at path. The file is written next to it
+        // and renamed into place, so servers watching path never see a partial
+        // image. Rows whose rdata cannot be encoded are left out and listed in
+        // skipped. Returns false with the reason in error.
+        static bool write(const std::string &path, const std::map<std::string, std::vector<ZoneRecord>> &zones,
+                          std::vector<std::string> &skipped, std::string &error);
+
+        ZoneImage(const ZoneImage &) = delete;
+        ZoneImage &operator=(const ZoneImage &) = delete;
+
+    private:
+        ZoneImage() = default;
+
+        const ImageFormat::Zone *findZone(std::string_view name) const;
+
+        const ImageFormat::Node *findOwner(const ImageFormat::Zone &zone, std::string_view owner) const;
+
+        void appendRecords(const ImageFormat::Node &node, const std::string &name, std::vector<ZoneRecord> &out) const;
+
+        // Pool bytes; empty if the reference points outside the pool
+        std::string_view bytes(uint32_t offset, uint32_t length) const {
+            if (static_cast<uint64_t>(offset) + length > header->bytesSize) {
+                return {};
+            }
+            return {pool + offset, length};
+        }
+
+        const char *base = nullptr;
+        size_t size = 0;
+        const ImageFormat::Header *header = nullptr;
+        const ImageFormat::Zone *zones = nullptr;
+        const ImageFormat::Node *nodes = nullptr;
+        const ImageFormat::RRset *rrsets = nullptr;
+        const ImageFormat::Rdata *rdatas = nullptr;
+        const char *pool = nullptr;
+    };
+
+}
+
+#endif // ZONEIMAGE_H
@@ -0,0 +1,238 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <cstdlib>
+#include <string>
+
+namespace DNS {
+
+    // Runtime settings, read once from the environment so the same binary can
+    // be started with different listeners without recompiling.
+    class Config {
+    public:
+
+        static Config& getInstance() {
+            static Config instance;
+            return instance;
+        }
+
+        // UDP and TCP port for queries
+        int port;
+
+        // Record backend: "postgres", "memory" (loaded from recordsFile and
+        // zoneFiles), "image" (a compiled zone image, see dns-zonec) or
+        // "secondary" (secondaryZones transferred from primary)
+        std::string backend;
+        std::string dbConnection;
+        std::string recordsFile;
+
+        // TTL of records that do not set their own (no ttl column, or no TTL
+        // in the records file)
+        int defaultTtl;
+
+        // RFC 1035 master files for the memory backend: "[zone=]path,..."
+        std::string zoneFiles;
+
+        // Compiled zone image for the image backend; checked for replacement
+        // every imageReloadSeconds (0 = never)
+        std::string imageFile;
+        int imageReloadSeconds;
+
+        // Cache in front of the postgres backend, with serve-stale (RFC 8767):
+        // answers are kept for at most recordCacheTtl seconds (0 = no cache),
+        // and after that served with staleTtl for staleWindowSeconds whenever
+        // the database fails or takes longer than backendDeadlineMs. After
+        // breakerFailures failures in a row lookups stop for breakerCooldownSeconds.
+        // Entries hit prefetchHits times are refreshed before they expire (0 = never).
+        int recordCacheTtl;
+        int recordCacheSize;
+        int prefetchHits;
+        int staleWindowSeconds;
+        int staleTtl;
+        int backendDeadlineMs;
+        int breakerFailures;
+        int breakerCooldownSeconds;
+
+        // Slows down or fails record lookups on purpose, for testing
+        int faultLatencyMs;
+        int faultJitterMs;
+        int faultErrorPercent;
+
+        // DNS-over-TLS (RFC 7858). The listener is only started when both a
+        // certificate and a private key are configured.
+        std::string tlsCertFile;
+        std::string tlsKeyFile;
+        int tlsPort;
+        int tlsMaxConnections;
+        int tlsIdleTimeoutSeconds;
+        bool tlsKtls;
+
+        // DNS over TCP on the UDP port (RFC 7766), which also carries zone transfers
+        int tcpMaxConnections;
+        int tcpIdleTimeoutSeconds;
+
+        // Outgoing AXFR/IXFR: allowed clients ("ip[/prefix],...", none if empty),
+        // transfers at once, IXFR journal entries per zone, and how often zones
+        // that have been transferred are checked for a new serial (0 = only when
+        // a transfer asks)
+        std::string xfrAllow;
+        int xfrMaxTransfers;
+        int ixfrJournalSize;
+        int ixfrPollSeconds;
+
+        // Secondaries ("ip[:port],...") sent a NOTIFY when a zone they
+        // transferred gets a new serial
+        std::string notifyTargets;
+
+        // Secondary backend: the primary ("ip[:port]") and the zones taken from
+        // it; with a state directory the zones and their journals are saved, so
+        // a restart resumes with an incremental transfer
+        std::string primary;
+        std::string secondaryZones;
+        std::string secondaryStateDirectory;
+
+        // Largest UDP reply we send to EDNS0 clients (RFC 6891)
+        int ednsMaxUdpPayload;
+
+        // Upstream resolvers ("ip[:port],...") for names we are not authoritative for
+        std::string forwarders;
+        int forwardTimeoutMs;
+        int forwardRetries;
+        int forwardSockets;
+        int forwardCacheSize;
+
+        // Response rate limiting; a rate of 0 disables that response class
+        int rrlRate;
+        int rrlNxdomainRate;
+        int rrlErrorRate;
+        int rrlBurst;
+        int rrlSlip;
+        int rrlLeak;
+        int rrlIpv4Prefix;
+        int rrlIpv6Prefix;
+        int rrlTableSize;
+
+        // DNS Cookies: "off", "on" or "required"
+        std::string cookieMode;
+        std::string cookieSecret;
+        int cookieRotationSeconds;
+
+        // Online DNSSEC signing; zones with a key in the directory are signed
+        std::string dnssecKeyDirectory;
+        std::string dnssecAlgorithm;
+        bool dnssecGenerateKeys;
+        int dnssecValidity;
+
+        // Prometheus scrape endpoint: "host:port", a Unix socket path, or empty for none
+        std::string metricsAddress;
+
+        // "debug", "info", "warn" or "error"; debug needs a DNS_DEBUG_LOG build
+        std::string logLevel;
+
+        // dnstap query log: file path or "unix:<socket>", 1-in-N sampling, server identity
+        std::string dnstapOutput;
+        int dnstapSampleRate;
+        std::string dnstapIdentity;
+
+        bool tlsEnabled() const {
+            return !tlsCertFile.empty() && !tlsKeyFile.empty();
+        }
+
+        static std::string envString(const char* name, const std::string& fallback) {
+            const char* value = std::getenv(name);
+            return value != nullptr ? std::string(value) : fallback;
+        }
+
+        static long envInt(const char* name, long fallback) {
+            const char* value = std::getenv(name);
+            if (value == nullptr || *value == '\0') {
+                return fallback;
+            }
+            char* end = nullptr;
+            long parsed = std::strtol(value, &end, 10);
+            return (end != nullptr && *end == '\0') ? parsed : fallback;
+        }
+
+        static bool envBool(const char* name, bool fallback) {
+            const char* value = std::getenv(name);
+            if (value == nullptr || *value == '\0') {
+                return fallback;
+            }
+            std::string v(value);
+            return v == "1" || v == "true" || v == "yes" || v == "on";
+        }
+
+    private:
+
+        Config() {
+            port = static_cast<int>(envInt("DNS_PORT", 53));
+            backend = envString("DNS_BACKEND", "postgres");
+            dbConnection = envString("DNS_DB_CONNECTION", "");
+            recordsFile = envString("DNS_RECORDS_FILE", "");
+            defaultTtl = static_cast<int>(envInt("DNS_DEFAULT_TTL", 3600));
+            zoneFiles = envString("DNS_ZONE_FILES", "");
+            imageFile = envString("DNS_IMAGE_FILE", "");
+            imageReloadSeconds = static_cast<int>(envInt("DNS_IMAGE_RELOAD", 5));
+            recordCacheTtl = static_cast<int>(envInt("DNS_RECORD_CACHE_TTL", 30));
+            recordCacheSize = static_cast<int>(envInt("DNS_RECORD_CACHE_SIZE", 100000));
+            prefetchHits = static_cast<int>(envInt("DNS_PREFETCH_HITS", 3));
+            staleWindowSeconds = static_cast<int>(envInt("DNS_STALE_WINDOW", 86400));
+            staleTtl = static_cast<int>(envInt("DNS_STALE_TTL", 30));
+            backendDeadlineMs = static_cast<int>(envInt("DNS_BACKEND_DEADLINE_MS", 1800));
+            breakerFailures = static_cast<int>(envInt("DNS_BREAKER_FAILURES", 5));
+            breakerCooldownSeconds = static_cast<int>(envInt("DNS_BREAKER_COOLDOWN", 10));
+            faultLatencyMs = static_cast<int>(envInt("DNS_FAULT_LATENCY_MS", 0));
+            faultJitterMs = static_cast<int>(envInt("DNS_FAULT_JITTER_MS", 0));
+            faultErrorPercent = static_cast<int>(envInt("DNS_FAULT_ERROR_PERCENT", 0));
+            tlsCertFile = envString("DNS_TLS_CERT", "");
+            tlsKeyFile = envString("DNS_TLS_KEY", "");
+            tlsPort = static_cast<int>(envInt("DNS_TLS_PORT", 853));
+            tlsMaxConnections = static_cast<int>(envInt("DNS_TLS_MAX_CONNECTIONS", 256));
+            tlsIdleTimeoutSeconds = static_cast<int>(envInt("DNS_TLS_IDLE_TIMEOUT", 10));
+            tlsKtls = envBool("DNS_TLS_KTLS", false);
+            tcpMaxConnections = static_cast<int>(envInt("DNS_TCP_MAX_CONNECTIONS", 256));
+            tcpIdleTimeoutSeconds = static_cast<int>(envInt("DNS_TCP_IDLE_TIMEOUT", 10));
+            xfrAllow = envString("DNS_XFR_ALLOW", "");
+            xfrMaxTransfers = static_cast<int>(envInt("DNS_XFR_MAX_TRANSFERS", 4));
+            ixfrJournalSize = static_cast<int>(envInt("DNS_IXFR_JOURNAL_SIZE", 100));
+            ixfrPollSeconds = static_cast<int>(envInt("DNS_IXFR_POLL", 30));
+            notifyTargets = envString("DNS_NOTIFY", "");
+            primary = envString("DNS_PRIMARY", "");
+            secondaryZones = envString("DNS_SECONDARY_ZONES", "");
+            secondaryStateDirectory = envString("DNS_SECONDARY_DIR", "");
+            ednsMaxUdpPayload = static_cast<int>(envInt("DNS_EDNS_MAX_PAYLOAD", 1232));
+            forwarders = envString("DNS_FORWARDERS", "");
+            forwardTimeoutMs = static_cast<int>(envInt("DNS_FORWARD_TIMEOUT_MS", 800));
+            forwardRetries = static_cast<int>(envInt("DNS_FORWARD_RETRIES", 2));
+            forwardSockets = static_cast<int>(envInt("DNS_FORWARD_SOCKETS", 16));
+            forwardCacheSize = static_cast<int>(envInt("DNS_FORWARD_CACHE_SIZE", 100000));
+            rrlRate = static_cast<int>(envInt("DNS_RRL_RATE", 0));
+            rrlNxdomainRate = static_cast<int>(envInt("DNS_RRL_NXDOMAIN_RATE", rrlRate));
+            rrlErrorRate = static_cast<int>(envInt("DNS_RRL_ERROR_RATE", rrlRate));
+            rrlBurst = static_cast<int>(envInt("DNS_RRL_BURST", 2));
+            rrlSlip = static_cast<int>(envInt("DNS_RRL_SLIP", 2));
+            rrlLeak = static_cast<int>(envInt("DNS_RRL_LEAK", 0));
+            rrlIpv4Prefix = static_cast<int>(envInt("DNS_RRL_IPV4_PREFIX", 24));
+            rrlIpv6Prefix = static_cast<int>(envInt("DNS_RRL_IPV6_PREFIX", 56));
+            rrlTableSize = static_cast<int>(envInt("DNS_RRL_TABLE_SIZE", 65536));
+            cookieMode = envString("DNS_COOKIES", "on");
+            cookieSecret = envString("DNS_COOKIE_SECRET", "");
+            cookieRotationSeconds = static_cast<int>(envInt("DNS_COOKIE_ROTATION", 3600));
+            dnssecKeyDirectory = envString("DNS_DNSSEC_KEY_DIR", "");
+            dnssecAlgorithm = envString("DNS_DNSSEC_ALGORITHM", "ECDSAP256SHA256");
+            dnssecGenerateKeys = envBool("DNS_DNSSEC_GENERATE_KEYS", false);
+            dnssecValidity = static_cast<int>(envInt("DNS_DNSSEC_VALIDITY", 14 * 86400));
+            metricsAddress = envString("DNS_METRICS_ADDRESS", "127.0.0.1:9153");
+            logLevel = envString("DNS_LOG_LEVEL", "info");
+            dnstapOutput = envString("DNS_DNSTAP_OUTPUT", "");
+            dnstapSampleRate = static_cast<int>(envInt("DNS_DNSTAP_SAMPLE", 1));
+            dnstapIdentity = envString("DNS_DNSTAP_IDENTITY", "");
+        }
+
+        Config(const Config&) = delete;
+        Config& operator=(const Config&) = delete;
+    };
+
+}
+
+#endif // CONFIG_H
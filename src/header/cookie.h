@@ -0,0 +1,282 @@
+#ifndef COOKIE_H
+#define COOKIE_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+
+namespace DNS {
+
+    // DNS Cookies (RFC 7873) with interoperable server cookies (RFC 9018):
+    //
+    //   server cookie = version(1) | reserved(3) | timestamp(4) | hash(8)
+    //   hash = SipHash-2-4(client cookie | version | reserved | timestamp | client IP)
+    //
+    // Nothing is stored per client. A configured DNS_COOKIE_SECRET is itself
+    // the SipHash key (RFC 9018 section 4.4), so any server given the same
+    // secret accepts our cookies, whatever software it runs; while servers roll
+    // over to a new secret the previous one is accepted too (section 5).
+    // Without a configured secret the key is derived from a random one and the
+    // rotation epoch the timestamp falls in, so it rotates with no coordination.
+    // Each thread caches the derived keys of the current and previous epoch,
+    // which keeps verification at one SipHash per packet.
+    class Cookies {
+    public:
+
+        static constexpr uint16_t OPTION_CODE = 10;
+        static constexpr size_t CLIENT_COOKIE_SIZE = 8;
+        static constexpr size_t SERVER_COOKIE_SIZE = 16;
+
+        static Cookies& getInstance() {
+            static Cookies instance;
+            return instance;
+        }
+
+        void setEnabled(bool on) {
+            enabledFlag = on;
+        }
+
+        // Answer BADCOOKIE, without any lookup, to UDP queries carrying a client
+        // cookie but no valid server cookie
+        void setRequired(bool on) {
+            requiredFlag = on;
+        }
+
+        // "secret[,previous]", 32 hex digits each; keeps a random secret when
+        // empty or malformed
+        void setSecret(const std::string &list) {
+            size_t comma = list.find(',');
+            uint8_t current[16], previous[16];
+            bool withPrevious = comma != std::string::npos;
+            if (!parseSecret(list.substr(0, comma), current) ||
+                (withPrevious && !parseSecret(list.substr(comma + 1), previous))) {
+                return;
+            }
+            std::memcpy(sharedKey, current, sizeof(sharedKey));
+            std::memcpy(previousKey, previous, sizeof(previousKey));
+            sharedSecret = true;
+            hasPrevious = withPrevious;
+            generation++;
+        }
+
+        void setRotationInterval(uint32_t seconds) {
+            rotationSeconds = seconds == 0 ? 3600 : seconds;
+            generation++;
+        }
+
+        bool enabled() const { return enabledFlag; }
+        bool required() const { return requiredFlag; }
+
+        // True when serverCookie was issued by us to this client and is still fresh.
+        bool verify(const std::vector<uint8_t> &clientCookie, const std::vector<uint8_t> &serverCookie,
+                    const sockaddr_in &client) {
+            if (clientCookie.size() != CLIENT_COOKIE_SIZE || serverCookie.size() != SERVER_COOKIE_SIZE ||
+                serverCookie[0] != 1) {
+                return false;
+            }
+            uint32_t timestamp = (static_cast<uint32_t>(serverCookie[4]) << 24) | (serverCookie[5] << 16) |
+                                 (serverCookie[6] << 8) | serverCookie[7];
+            uint32_t current = now();
+            // Valid for an hour, and up to five minutes in the future for clock skew
+            if (static_cast<int32_t>(current - timestamp) > 3600 || static_cast<int32_t>(timestamp - current) > 300) {
+                return false;
+            }
+            if (!sharedSecret) {
+                return matches(clientCookie.data(), serverCookie.data(), client, keyFor(timestamp / rotationSeconds));
+            }
+            return matches(clientCookie.data(), serverCookie.data(), client, sharedKey) ||
+                   (hasPrevious && matches(clientCookie.data(), serverCookie.data(), client, previousKey));
+        }
+
+        // COOKIE option for the reply. A valid server cookie younger than half an
+        // hour, and not made with the previous secret, is echoed as is; otherwise
+        // a fresh one is minted.
+        std::vector<uint8_t> replyOption(const std::vector<uint8_t> &clientCookie, const std::vector<uint8_t> &serverCookie,
+                                         bool serverCookieValid, const sockaddr_in &client) {
+            std::vector<uint8_t> option;
+            option.reserve(4 + CLIENT_COOKIE_SIZE + SERVER_COOKIE_SIZE);
+            option.push_back(OPTION_CODE >> 8);
+            option.push_back(OPTION_CODE & 0xFF);
+            option.push_back(0);
+            option.push_back(CLIENT_COOKIE_SIZE + SERVER_COOKIE_SIZE);
+            option.insert(option.end(), clientCookie.begin(), clientCookie.end());
+
+            uint32_t current = now();
+            if (serverCookieValid) {
+                uint32_t timestamp = (static_cast<uint32_t>(serverCookie[4]) << 24) | (serverCookie[5] << 16) |
+                                     (serverCookie[6] << 8) | serverCookie[7];
+                if (static_cast<int32_t>(current - timestamp) < 1800 &&
+                    (!hasPrevious || matches(clientCookie.data(), serverCookie.data(), client, sharedKey))) {
+                    option.insert(option.end(), serverCookie.begin(), serverCookie.end());
+                    return option;
+                }
+            }
+
+            uint8_t fresh[SERVER_COOKIE_SIZE] = {1, 0, 0, 0,
+                                                 static_cast<uint8_t>(current >> 24), static_cast<uint8_t>(current >> 16),
+                                                 static_cast<uint8_t>(current >> 8), static_cast<uint8_t>(current)};
+            computeHash(clientCookie.data(), fresh, client, sharedSecret ? sharedKey : keyFor(current / rotationSeconds),
+                        fresh + 8);
+            option.insert(option.end(), fresh, fresh + SERVER_COOKIE_SIZE);
+            return option;
+        }
+
+        // The 8-byte hash of a server cookie whose first 8 bytes are serverHeader
+        static void computeHash(const uint8_t *clientCookie, const uint8_t *serverHeader, const sockaddr_in &client,
+                                const uint8_t *key, uint8_t *out) {
+            uint8_t input[CLIENT_COOKIE_SIZE + 8 + 4];
+            std::memcpy(input, clientCookie, CLIENT_COOKIE_SIZE);
+            std::memcpy(input + CLIENT_COOKIE_SIZE, serverHeader, 8);
+            std::memcpy(input + CLIENT_COOKIE_SIZE + 8, &client.sin_addr.s_addr, 4);
+            // Serialised little-endian, like the reference SipHash (RFC 9018 appendix A)
+            writeLittle64(out, siphash24(key, input, sizeof(input)));
+        }
+
+        // SipHash-2-4 with a 128-bit key, 64-bit output.
+        static uint64_t siphash24(const uint8_t key[16], const uint8_t *data, size_t length) {
+            uint64_t k0 = readLittle64(key);
+            uint64_t k1 = readLittle64(key + 8);
+            uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+            uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+            uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+            uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+            size_t blocks = length / 8;
+            for (size_t i = 0; i < blocks; i++) {
+                uint64_t m = readLittle64(data + i * 8);
+                v3 ^= m;
+                sipRound(v0, v1, v2, v3);
+                sipRound(v0, v1, v2, v3);
+                v0 ^= m;
+            }
+
+            uint64_t last = static_cast<uint64_t>(length) << 56;
+            const uint8_t *tail = data + blocks * 8;
+            for (size_t i = 0; i < (length & 7); i++) {
+                last |= static_cast<uint64_t>(tail[i]) << (8 * i);
+            }
+            v3 ^= last;
+            sipRound(v0, v1, v2, v3);
+            sipRound(v0, v1, v2, v3);
+            v0 ^= last;
+
+            v2 ^= 0xff;
+            for (int i = 0; i < 4; i++) {
+                sipRound(v0, v1, v2, v3);
+            }
+            return v0 ^ v1 ^ v2 ^ v3;
+        }
+
+    private:
+
+        Cookies() : enabledFlag(false), requiredFlag(false), rotationSeconds(3600), generation(1),
+                    sharedSecret(false), hasPrevious(false) {
+            std::random_device random;
+            for (auto &byte: masterKey) {
+                byte = static_cast<uint8_t>(random());
+            }
+        }
+
+        struct EpochKey {
+            uint64_t generation = 0;
+            uint32_t epoch = 0;
+            uint8_t key[16];
+        };
+
+        static bool parseSecret(const std::string &hex, uint8_t out[16]) {
+            if (hex.size() != 32) {
+                return false;
+            }
+            for (int i = 0; i < 16; i++) {
+                char *end = nullptr;
+                std::string byte = hex.substr(i * 2, 2);
+                out[i] = static_cast<uint8_t>(std::strtoul(byte.c_str(), &end, 16));
+                if (end == nullptr || *end != '\0') {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Per-thread cache of the last two keys derived from masterKey
+        const uint8_t *keyFor(uint32_t epoch) {
+            thread_local EpochKey cached[2];
+            for (auto &entry: cached) {
+                if (entry.generation == generation && entry.epoch == epoch) {
+                    return entry.key;
+                }
+            }
+            EpochKey &slot = cached[epoch & 1];
+            uint8_t input[5] = {static_cast<uint8_t>(epoch >> 24), static_cast<uint8_t>(epoch >> 16),
+                                static_cast<uint8_t>(epoch >> 8), static_cast<uint8_t>(epoch), 0};
+            writeLittle64(slot.key, siphash24(masterKey, input, sizeof(input)));
+            input[4] = 1;
+            writeLittle64(slot.key + 8, siphash24(masterKey, input, sizeof(input)));
+            slot.epoch = epoch;
+            slot.generation = generation;
+            return slot.key;
+        }
+
+        // Compares the hash in serverCookie with ours in constant time
+        static bool matches(const uint8_t *clientCookie, const uint8_t *serverCookie, const sockaddr_in &client,
+                            const uint8_t *key) {
+            uint8_t expected[8];
+            computeHash(clientCookie, serverCookie, client, key, expected);
+            uint8_t diff = 0;
+            for (int i = 0; i < 8; i++) {
+                diff |= expected[i] ^ serverCookie[8 + i];
+            }
+            return diff == 0;
+        }
+
+        static uint32_t now() {
+            return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+        }
+
+        static inline void sipRound(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3) {
+            v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+            v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+            v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+            v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+        }
+
+        static inline uint64_t rotl(uint64_t x, int b) {
+            return (x << b) | (x >> (64 - b));
+        }
+
+        static uint64_t readLittle64(const uint8_t *p) {
+            uint64_t value = 0;
+            for (int i = 7; i >= 0; i--) {
+                value = (value << 8) | p[i];
+            }
+            return value;
+        }
+
+        static void writeLittle64(uint8_t *p, uint64_t value) {
+            for (int i = 0; i < 8; i++) {
+                p[i] = value & 0xFF;
+                value >>= 8;
+            }
+        }
+
+        bool enabledFlag;
+        bool requiredFlag;
+        uint32_t rotationSeconds;
+        uint64_t generation;
+        uint8_t masterKey[16];          // random; per-epoch keys are derived from it
+        bool sharedSecret;              // configured, used as the key itself
+        bool hasPrevious;
+        uint8_t sharedKey[16];
+        uint8_t previousKey[16];
+        Cookies(const Cookies&) = delete;
+        Cookies& operator=(const Cookies&) = delete;
+    };
+
+}
+
+#endif // COOKIE_H
@@ -1,79 +1,195 @@
 #include "dns.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iomanip>
-#include <iostream>
 #include <sstream>
 #include <vector>
 
 #include "dnsEnum.h"
 #include "dnsRequestBody.h"
+#include "logger.h"
+#include "rdata.h"
 
 
+namespace {
+    // DNS Flag Day 2020 default, small enough to avoid IP fragmentation
+    uint16_t maxUdpPayload = 1232;
+}
+
 std::vector<uint8_t> DNS::CreateResponse::createResponse(
     uint16_t flags,
     const std::pmr::list<AnswerSection> &answerSection,
     const std::pmr::list<QuestionSection> &questions_section,
-    const DnsRequestBody &requestBody
+    const DnsRequestBody &requestBody,
+    size_t maxSize,
+    const std::pmr::list<AnswerSection> &authoritySection,
+    const std::pmr::list<AnswerSection> &additionalSection
 ) {
-    uint16_t answerCount = answerSection.size();
-    std::vector<uint8_t> responsePacket = createBody(requestBody, questions_section, flags, answerCount);
+    std::vector<uint8_t> responsePacket = createBody(requestBody, questions_section, flags, 0);
+
+    // Unknown EDNS versions get BADVERS and no answers (RFC 6891 6.1.3)
+    bool badVersion = requestBody.hasEdns && requestBody.ednsVersion != 0;
+    size_t reserved = requestBody.hasEdns ? OPT_RECORD_SIZE + requestBody.replyEdnsOptions.size() : 0;
+
+    bool truncated = false;
+    uint16_t additionalCount = 0;
+    if (!badVersion) {
+        try {
+            setUint16(responsePacket, 6, addSection(responsePacket, answerSection, maxSize, reserved, truncated));
+            if (!truncated) {
+                setUint16(responsePacket, 8, addSection(responsePacket, authoritySection, maxSize, reserved, truncated));
+            }
+            if (!truncated) {
+                bool omitted = false;
+                additionalCount = addSection(responsePacket, additionalSection, maxSize, reserved, omitted);
+            }
+        } catch (const RData::Error &e) {
+            // A stored record whose text cannot be encoded; the rest of the answer is not enough
+            Logger::warn("cannot encode record", {{"error", e.what()}});
+            return createResponse(static_cast<uint16_t>(DnsEnum::ResponseFlags::RESPONSE_SERVER_FAILURE), {},
+                                  questions_section, requestBody, maxSize);
+        }
+    }
 
-    // Answer Section
-    for (const auto &section: answerSection) {
-        addDomainName(responsePacket, section.query);
-        addUint16(responsePacket, static_cast<int>(section.queryType));
-        addUint16(responsePacket, static_cast<int>(section.queryClass));
-        addUint32(responsePacket, section.ttl);
-
-        std::vector<uint8_t> rDataBytes;
-        switch (static_cast<int>(section.queryType)) {
-            case static_cast<int>(DnsEnum::QueryType::A):
-                rDataBytes = ipToBytes(section.rData);
-                break;
-            case static_cast<int>(DnsEnum::QueryType::CNAME):
-                rDataBytes = domainToDnsFormat(section.rData);
-                break;
-            case static_cast<int>(DnsEnum::QueryType::AAAA):
-                rDataBytes = parseIPv6Address(section.rData);
-                break;
-            case static_cast<int>(DnsEnum::QueryType::MX):
-                rDataBytes = domainToDnsFormat(section.rData);
-                break;
-        }
-        addUint16(responsePacket, rDataBytes.size());
-        responsePacket.insert(responsePacket.end(), rDataBytes.begin(), rDataBytes.end());
-    }
-
-    // MX Specific Answer Section
+    if (truncated) {
+        setUint16(responsePacket, 2, flags | static_cast<uint16_t>(DnsEnum::ResponseFlags::TRUNCATED));
+    }
+
+    if (requestBody.hasEdns) {
+        addOptRecord(responsePacket, requestBody, badVersion ? 1 : requestBody.replyExtendedRcode);
+        additionalCount++;
+    }
+    setUint16(responsePacket, 10, additionalCount);
 
     return responsePacket;
 }
 
-std::vector<uint8_t> DNS::CreateResponse::createMxResponse(
-    uint16_t flags,
-    const std::pmr::list<AnswerSectionWithPriority> &answerWithPriority,
-    const std::pmr::list<QuestionSection> &questions_section, const DnsRequestBody &requestBody) {
+uint16_t DNS::CreateResponse::addSection(
+    std::vector<uint8_t> &packet,
+    const std::pmr::list<AnswerSection> &section,
+    size_t maxSize,
+    size_t reserved,
+    bool &truncated
+) {
+    // Written one RRset at a time in order of first appearance
+    uint16_t count = 0;
+    std::vector<const AnswerSection *> pending;
+    pending.reserve(section.size());
+    for (const auto &record: section) {
+        pending.push_back(&record);
+    }
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i] == nullptr) {
+            continue;
+        }
+        const AnswerSection &head = *pending[i];
+        size_t rrsetStart = packet.size();
+        uint16_t rrsetCount = 0;
+        for (size_t j = i; j < pending.size(); j++) {
+            if (pending[j] != nullptr && pending[j]->queryType == head.queryType &&
+                pending[j]->queryClass == head.queryClass && pending[j]->query == head.query) {
+                addAnswer(packet, *pending[j]);
+                pending[j] = nullptr;
+                rrsetCount++;
+            }
+        }
+        if (packet.size() + reserved > maxSize) {
+            packet.resize(rrsetStart);
+            truncated = true;
+            break;
+        }
+        count += rrsetCount;
+    }
+    return count;
+}
+
+void DNS::CreateResponse::addAnswer(std::vector<uint8_t> &packet, const AnswerSection &section) {
+    addDomainName(packet, section.query);
+    addUint16(packet, static_cast<uint16_t>(section.queryType));
+    addUint16(packet, static_cast<uint16_t>(section.queryClass));
+    addUint32(packet, section.ttl);
+
+    if (!section.wireData.empty()) {
+        addUint16(packet, section.wireData.size());
+        packet.insert(packet.end(), section.wireData.begin(), section.wireData.end());
+        return;
+    }
+    std::vector<uint8_t> rDataBytes = RData::encode(section.queryType, section.rData);
+    addUint16(packet, rDataBytes.size());
+    packet.insert(packet.end(), rDataBytes.begin(), rDataBytes.end());
+}
+
+void DNS::CreateResponse::addOptRecord(std::vector<uint8_t> &packet, const DnsRequestBody &requestBody, uint8_t extendedRcode) {
+    packet.push_back(0x00); // Root owner name
+    addUint16(packet, static_cast<uint16_t>(DnsEnum::QueryType::OPT));
+    addUint16(packet, maxUdpPayload); // Our receive buffer size
+    packet.push_back(extendedRcode);
+    packet.push_back(0); // EDNS version
+    addUint16(packet, requestBody.dnssecOk ? 0x8000 : 0); // DO bit is copied from the query
+    addUint16(packet, requestBody.replyEdnsOptions.size());
+    packet.insert(packet.end(), requestBody.replyEdnsOptions.begin(), requestBody.replyEdnsOptions.end());
+}
 
-    uint16_t answerCount = answerWithPriority.size();
-    std::vector<uint8_t> responsePacket = createBody(requestBody, questions_section, flags, answerCount);
+uint8_t DNS::CreateResponse::screenQuery(const uint8_t *query, size_t length) {
+    if (length < 12) {
+        return 0;
+    }
+    if ((query[2] >> 3 & 0x0F) != static_cast<uint8_t>(DnsEnum::Opcode::QUERY)) {
+        return static_cast<uint8_t>(DnsEnum::ResponseCode::NOT_IMPLEMENTED);
+    }
+    size_t end = ParseResponse::questionEnd(query, length);
+    if (end == 0) {
+        return 0; // left to the parser
+    }
+    uint16_t type = query[end - 4] << 8 | query[end - 3];
+    uint16_t queryClass = query[end - 2] << 8 | query[end - 1];
+    if (queryClass != static_cast<uint16_t>(DnsEnum::QueryClass::IN)) {
+        return static_cast<uint8_t>(DnsEnum::ResponseCode::REFUSED);
+    }
+    // 128-254 are meta qtypes (RFC 6895); of those only ANY is answered here
+    if (type >= 128 && type < 255) {
+        return static_cast<uint8_t>(DnsEnum::ResponseCode::NOT_IMPLEMENTED);
+    }
+    return 0;
+}
 
-    for (const auto &section: answerWithPriority) {
-        addDomainName(responsePacket, section.query); // Domain name of the mail exchanger
-        addUint16(responsePacket, static_cast<int>(DnsEnum::QueryType::MX)); // MX type
-        addUint16(responsePacket, static_cast<int>(DnsEnum::QueryClass::IN)); // Class IN
-        addUint32(responsePacket, section.ttl); // TTL
+void DNS::CreateResponse::errorFromQuery(const uint8_t *query, size_t length, uint8_t rcode, std::vector<uint8_t> &out) {
+    if (length < 12) {
+        out.clear();
+        return;
+    }
+    size_t end = ParseResponse::questionEnd(query, length);
+    out.assign(query, query + (end != 0 ? end : 12));
+    out[2] = 0x80 | (query[2] & 0x79); // QR, with the opcode and RD echoed
+    out[3] = rcode & 0x0F;
+    setUint16(out, 4, end != 0 ? 1 : 0);
+    setUint16(out, 6, 0);
+    setUint16(out, 8, 0);
+    setUint16(out, 10, 0);
+}
 
-        std::vector<uint8_t> rDataBytes;
-        addUint16(rDataBytes, section.priority); // Priority
+void DNS::CreateResponse::setMaxUdpPayload(uint16_t size) {
+    maxUdpPayload = std::max<uint16_t>(size, 512);
+}
 
-        std::vector<uint8_t> domainBytes = domainToDnsFormat(section.rData); // Mail exchanger domain
-        rDataBytes.insert(rDataBytes.end(), domainBytes.begin(), domainBytes.end());
+uint16_t DNS::CreateResponse::getMaxUdpPayload() {
+    return maxUdpPayload;
+}
 
-        addUint16(responsePacket, rDataBytes.size()); // Length field for MX record
-        responsePacket.insert(responsePacket.end(), rDataBytes.begin(), rDataBytes.end());
+size_t DNS::CreateResponse::responseSizeLimit(const DnsRequestBody &requestBody, bool streamTransport) {
+    if (streamTransport) {
+        return 0xFFFF;
     }
-    return responsePacket;
+    if (!requestBody.hasEdns) {
+        return 512;
+    }
+    return std::clamp<size_t>(requestBody.udpPayloadSize, 512, maxUdpPayload);
+}
+
+void DNS::CreateResponse::setUint16(std::vector<uint8_t> &packet, size_t offset, uint16_t value) {
+    packet[offset] = value >> 8;
+    packet[offset + 1] = value & 0xFF;
 }
 
 void DNS::CreateResponse::addDomainName(std::vector<uint8_t> &packet, const std::string &domain) {
@@ -84,6 +200,9 @@ void DNS::CreateResponse::addDomainName(std::vector<uint8_t> &packet, const std:
             end = domain.size();
         }
         size_t labelLength = end - pos;
+        if (labelLength == 0) {
+            break; // root "." or a trailing dot
+        }
         if (labelLength > 63) {
             throw std::runtime_error("Label length exceeds 63 bytes");
         }
@@ -96,21 +215,7 @@ void DNS::CreateResponse::addDomainName(std::vector<uint8_t> &packet, const std:
 
 std::vector<uint8_t> DNS::CreateResponse::domainToDnsFormat(const std::string &domain) {
     std::vector<uint8_t> dnsFormat;
-    size_t pos = 0;
-    size_t nextPos;
-
-    while ((nextPos = domain.find('.', pos)) != std::string::npos) {
-        std::string label = domain.substr(pos, nextPos - pos);
-        dnsFormat.push_back(static_cast<uint8_t>(label.size()));
-        dnsFormat.insert(dnsFormat.end(), label.begin(), label.end());
-        pos = nextPos + 1;
-    }
-
-    std::string lastLabel = domain.substr(pos);
-    dnsFormat.push_back(static_cast<uint8_t>(lastLabel.size()));
-    dnsFormat.insert(dnsFormat.end(), lastLabel.begin(), lastLabel.end());
-    dnsFormat.push_back(0x00); // End of domain name
-
+    addDomainName(dnsFormat, domain);
     return dnsFormat;
 }
 
@@ -142,40 +247,6 @@ std::string DNS::Log::bytesToHex(const std::vector<uint16_t> &bytes) {
     return ss.str();
 }
 
-std::vector<uint8_t> DNS::CreateResponse::ipToBytes(const std::string &ipAddress) {
-    std::vector<uint8_t> bytes;
-    std::istringstream stream(ipAddress);
-    std::string segment;
-    while (std::getline(stream, segment, '.')) {
-        int byte = std::stoi(segment);
-        if (byte < 0 || byte > 255) {
-            throw std::out_of_range("Byte value out of range");
-        }
-        bytes.push_back(static_cast<uint8_t>(byte));
-    }
-    if (bytes.size() != 4) {
-        throw std::invalid_argument("Invalid IP address format");
-    }
-    return bytes;
-}
-
-std::vector<uint8_t> DNS::CreateResponse::parseIPv6Address(const std::string &ipv6Address) {
-    std::vector<uint8_t> rDataBytes;
-    std::stringstream ss(ipv6Address);
-    std::string byte;
-
-    while (std::getline(ss, byte, ':')) {
-        auto word = static_cast<uint16_t>(std::stoi(byte, nullptr, 16));
-        addUint16(rDataBytes, word);
-    }
-
-    if (rDataBytes.size() != 16) {
-        throw std::invalid_argument("Invalid IPv6 address format");
-    }
-
-    return rDataBytes;
-}
-
 std::vector<uint8_t> DNS::CreateResponse::createBody(
     const DnsRequestBody &requestBody,
     const std::pmr::list<QuestionSection> &questions_section,
@@ -187,8 +258,8 @@ std::vector<uint8_t> DNS::CreateResponse::createBody(
     addUint16(responsePacket, flags); // Flags
     addUint16(responsePacket, questions_section.size()); // Number of Questions
     addUint16(responsePacket, answerCount); // Number of Answer RRs
-    addUint16(responsePacket, requestBody.authorityRRs); // Number of Authority RRs
-    addUint16(responsePacket, requestBody.additionalRRs); // Number of Additional RRs
+    addUint16(responsePacket, 0); // Number of Authority RRs
+    addUint16(responsePacket, 0); // Number of Additional RRs, set once OPT is appended
 
     // Questions Section
     for (const auto &section: questions_section) {
@@ -204,7 +275,7 @@ DnsRequestBody DNS::ParseResponse::parseDnsRequest(const std::vector<uint8_t> &d
     DnsRequestBody body;
 
     if (data.size() < 12) {
-        std::cerr << "Error: Data size too small." << std::endl;
+        Logger::debug("malformed query", {{"reason", "shorter than a header"}});
         return body;
     }
 
@@ -219,24 +290,117 @@ DnsRequestBody DNS::ParseResponse::parseDnsRequest(const std::vector<uint8_t> &d
     size_t queryStartIndex = 12;
     while (questionCount > 0) {
         std::string query;
-        while (data[queryStartIndex] != 0) {
+        while (queryStartIndex < data.size() && data[queryStartIndex] != 0) {
             uint8_t length = data[queryStartIndex];
+            if ((length & 0xC0) != 0 || queryStartIndex + 1 + length >= data.size()) {
+                Logger::debug("malformed query", {{"reason", "bad question name"}});
+                return DnsRequestBody();
+            }
             queryStartIndex++;
             query += std::string(data.begin() + queryStartIndex, data.begin() + queryStartIndex + length);
             queryStartIndex = queryStartIndex + length;
             if (data[queryStartIndex] != 0) query += ".";
         }
+        if (queryStartIndex + 5 > data.size()) {
+            Logger::debug("malformed query", {{"reason", "question truncated"}});
+            return DnsRequestBody();
+        }
         queryStartIndex++;
         uint16_t queryType = (data[queryStartIndex] << 8) | data[queryStartIndex + 1];
         queryStartIndex += 2;
         uint16_t queryClass = (data[queryStartIndex] << 8) | data[queryStartIndex + 1];
+        queryStartIndex += 2;
         body.questionsSection.push_back(QuestionSection(query, queryType, queryClass));
         questionCount--;
     }
+    body.valid = true;
+
+    // Skip answer and authority records, then look for OPT among the additional ones
+    size_t pos = queryStartIndex;
+    uint32_t recordCount = body.answerRRs + body.authorityRRs + body.additionalRRs;
+    for (uint32_t i = 0; i < recordCount; i++) {
+        size_t ownerStart = pos;
+        if (!skipName(data, pos) || pos + 10 > data.size()) {
+            break;
+        }
+        uint16_t type = readUint16(data, pos);
+        uint16_t rrClass = readUint16(data, pos + 2);
+        uint16_t rdLength = readUint16(data, pos + 8);
+        size_t rdStart = pos + 10;
+        if (rdStart + rdLength > data.size()) {
+            break;
+        }
+        bool additional = i >= static_cast<uint32_t>(body.answerRRs) + body.authorityRRs;
+        if (additional && type == static_cast<uint16_t>(DnsEnum::QueryType::OPT) && data[ownerStart] == 0 && !body.hasEdns) {
+            body.hasEdns = true;
+            body.udpPayloadSize = std::max<uint16_t>(rrClass, 512);
+            body.ednsVersion = data[pos + 5];
+            body.dnssecOk = (data[pos + 6] & 0x80) != 0;
+            body.ednsOptions.assign(data.begin() + rdStart, data.begin() + rdStart + rdLength);
+            parseEdnsOptions(body);
+        }
+        pos = rdStart + rdLength;
+    }
 
     return body;
 }
 
+void DNS::ParseResponse::parseEdnsOptions(DnsRequestBody &body) {
+    const std::vector<uint8_t> &options = body.ednsOptions;
+    size_t pos = 0;
+    while (pos + 4 <= options.size()) {
+        uint16_t code = readUint16(options, pos);
+        uint16_t length = readUint16(options, pos + 2);
+        pos += 4;
+        if (pos + length > options.size()) {
+            break;
+        }
+        if (code == 10) { // COOKIE: 8 byte client cookie, optionally an 8-32 byte server cookie
+            if (length < 8 || (length > 8 && length < 16) || length > 40) {
+                body.cookieMalformed = true;
+            } else {
+                body.clientCookie.assign(options.begin() + pos, options.begin() + pos + 8);
+                body.serverCookie.assign(options.begin() + pos + 8, options.begin() + pos + length);
+            }
+        }
+        pos += length;
+    }
+}
+
+bool DNS::ParseResponse::skipName(const std::vector<uint8_t> &data, size_t &pos) {
+    while (pos < data.size()) {
+        uint8_t length = data[pos];
+        if (length == 0) {
+            pos++;
+            return true;
+        }
+        if ((length & 0xC0) == 0xC0) {
+            pos += 2;
+            return pos <= data.size();
+        }
+        pos += length + 1;
+    }
+    return false;
+}
+
+uint16_t DNS::ParseResponse::readUint16(const std::vector<uint8_t> &data, size_t pos) {
+    return (data[pos] << 8) | data[pos + 1];
+}
+
+size_t DNS::ParseResponse::questionEnd(const uint8_t *message, size_t length) {
+    if (length < 12 || (message[4] == 0 && message[5] == 0)) {
+        return 0;
+    }
+    size_t pos = 12;
+    while (pos < length && message[pos] != 0) {
+        if ((message[pos] & 0xC0) != 0) {
+            return 0;
+        }
+        pos += message[pos] + 1;
+    }
+    return pos + 5 <= length ? pos + 5 : 0;
+}
+
 void DNS::ParseResponse::splitDomain(const std::string &domain, std::string &subdomain, std::string &mainDomain) {
     size_t pos = domain.rfind('.');
     if (pos != std::string::npos) {
@@ -14,34 +14,63 @@ namespace DNS {
 
 
 
+        // Answers, then authority records, are written whole RRset by whole RRset;
+        // once the next RRset would push the packet past maxSize the rest is dropped
+        // and TC is set. Additional records are extras: those that do not fit are
+        // left out without setting TC (RFC 2181 section 9). A record whose rdata
+        // cannot be encoded turns the whole reply into SERVFAIL.
         static std::vector<uint8_t> createResponse(
             uint16_t flags,
             const std::pmr::list<AnswerSection> &answerSection,
             const std::pmr::list<QuestionSection> &questions_section,
-            const DnsRequestBody &requestBody
+            const DnsRequestBody &requestBody,
+            size_t maxSize = 0xFFFF,
+            const std::pmr::list<AnswerSection> &authoritySection = {},
+            const std::pmr::list<AnswerSection> &additionalSection = {}
         );
 
-        static std::vector<uint8_t> createMxResponse(
-            uint16_t flags,
-            const std::pmr::list<AnswerSectionWithPriority> &answerWithPriority,
-            const std::pmr::list<QuestionSection> &questions_section,
-            const DnsRequestBody &requestBody
-        );
+        // Rcode for queries turned away before they are parsed, 0 for the rest:
+        // opcodes other than QUERY and meta qtypes other than ANY (AXFR over
+        // UDP, say) are NOTIMP, classes other than IN are REFUSED
+        static uint8_t screenQuery(const uint8_t *query, size_t length);
 
-    private:
-        // Helper function to add a domain name to the response
-        static void addDomainName(std::vector<uint8_t> &packet, const std::string &domainName);
+        // Error reply built straight from the raw query: its header and first
+        // question echoed with rcode set and no records. Written into out, whose
+        // capacity is reused, so it allocates nothing once the buffer has grown.
+        static void errorFromQuery(const uint8_t *query, size_t length, uint8_t rcode, std::vector<uint8_t> &out);
+
+        // Upper bound for UDP replies, whatever payload size the client advertises
+        static void setMaxUdpPayload(uint16_t size);
+
+        static uint16_t getMaxUdpPayload();
+
+        // 512 bytes without EDNS0, otherwise the advertised size capped by the
+        // configured maximum; stream transports may use the full 64 KiB
+        static size_t responseSizeLimit(const DnsRequestBody &requestBody, bool streamTransport);
 
         // Helper function to convert domain name to DNS format
         static std::vector<uint8_t> domainToDnsFormat(const std::string &domain);
 
+        // Big-endian fields of a message being built
+        static void setUint16(std::vector<uint8_t> &packet, size_t offset, uint16_t value);
+
         static void addUint16(std::vector<uint8_t> &packet, uint16_t value);
 
         static void addUint32(std::vector<uint8_t> &packet, uint32_t value);
 
-        static std::vector<uint8_t> ipToBytes(const std::string &ipAddress);
+    private:
+        // Size of the OPT pseudo-RR we echo back, not counting its options
+        static constexpr size_t OPT_RECORD_SIZE = 11;
+
+        static uint16_t addSection(std::vector<uint8_t> &packet, const std::pmr::list<AnswerSection> &section,
+                                   size_t maxSize, size_t reserved, bool &truncated);
+
+        static void addAnswer(std::vector<uint8_t> &packet, const AnswerSection &section);
+
+        static void addOptRecord(std::vector<uint8_t> &packet, const DnsRequestBody &requestBody, uint8_t extendedRcode);
 
-        static std::vector<uint8_t> parseIPv6Address(const std::string &ipv6Address);
+        // Helper function to add a domain name to the response
+        static void addDomainName(std::vector<uint8_t> &packet, const std::string &domainName);
 
         //static void addRPacket(std::vector<uint8_t> &responsePacket,const AnswerSection &answerSection, const QuestionSection &questions_section);
 
@@ -57,7 +86,17 @@ namespace DNS {
         static DnsRequestBody parseDnsRequest(const std::vector<uint8_t> &data);
 
         static void splitDomain(const std::string& domain, std::string& subdomain, std::string& mainDomain);
+
+        // Offset just past the first question's class in a raw message, 0 if it
+        // has no complete (uncompressed) question
+        static size_t questionEnd(const uint8_t *message, size_t length);
+
+        // Moves pos past a possibly compressed name; false if it runs off the packet
+        static bool skipName(const std::vector<uint8_t> &data, size_t &pos);
+
+        static uint16_t readUint16(const std::vector<uint8_t> &data, size_t pos);
     private:
+        static void parseEdnsOptions(DnsRequestBody &body);
     };
 
     class Log {
@@ -4,7 +4,7 @@
 
 #ifndef DNSENUM_H
 #define DNSENUM_H
-#include <iostream>
+#include <cstdint>
 
 
 namespace DNS {
@@ -23,6 +23,12 @@ namespace DNS {
             NAPTR = 35, // Naming Authority Pointer
             CERT = 37, // CERT
             DNAME = 39, // DNAME
+            OPT = 41, // EDNS0 pseudo-RR
+            DS = 43, // Delegation Signer
+            RRSIG = 46, // DNSSEC signature
+            NSEC = 47, // Next Secure (authenticated denial)
+            DNSKEY = 48, // DNSSEC public key
+            CAA = 257, // Certification Authority Authorization
             ANY = 255 // Any Record
         };
 
@@ -43,6 +49,24 @@ namespace DNS {
         };
 
 
+        // Header opcodes the server understands
+        enum class Opcode : uint8_t {
+            QUERY = 0, // Standard query
+            NOTIFY = 4 // Zone change notification (RFC 1996)
+        };
+
+        // Header rcodes, for replies built without the flag presets above
+        enum class ResponseCode : uint8_t {
+            NO_ERROR = 0,
+            FORMAT_ERROR = 1,
+            SERVER_FAILURE = 2,
+            NAME_ERROR = 3,
+            NOT_IMPLEMENTED = 4,
+            REFUSED = 5,
+            NOT_AUTHORITATIVE = 9
+        };
+
+
         enum class QueryClass : uint16_t {
             IN = 1, // Internet
             CS = 2, // CSNET (Archaic)
@@ -51,40 +75,6 @@ namespace DNS {
             NONE = 254, // QCLASS NONE
             ANY = 255 // QCLASS ANY
         };
-
-
-        static QueryType get_query_type(const std::string &type_str) {
-            if (type_str == "A") {
-                return QueryType::A;
-            } else if (type_str == "AAAA") {
-                return QueryType::AAAA;
-            } else if (type_str == "CNAME") {
-                return QueryType::CNAME;
-            } else if (type_str == "MX") {
-                return QueryType::MX;
-            } else if (type_str == "NS") {
-                return QueryType::NS;
-            } else if (type_str == "SOA") {
-                return QueryType::SOA;
-            } else if (type_str == "PTR") {
-                return QueryType::PTR;
-            } else if (type_str == "TXT") {
-                return QueryType::TXT;
-            } else if (type_str == "SRV") {
-                return QueryType::SRV;
-            } else if (type_str == "NAPTR") {
-                return QueryType::NAPTR;
-            } else if (type_str == "CERT") {
-                return QueryType::CERT;
-            } else if (type_str == "DNAME") {
-                return QueryType::DNAME;
-            } else if (type_str == "ANY") {
-                return QueryType::ANY;
-            } else {
-                std::cerr << "Unknown type: " << type_str << std::endl;
-                return QueryType::ANY; // Or set a default value
-            }
-        }
     };
 }
 
@@ -6,8 +6,10 @@
 #define DNSREQUESTBODY_H
 #include <cstdint>
 #include <list>
+#include <memory_resource>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "dnsEnum.h"
 
@@ -27,38 +29,44 @@ public:
     DNS::DnsEnum::QueryClass queryClass;
     uint32_t ttl;
     std::string rData;
+    std::vector<uint8_t> wireData; // pre-encoded rdata; takes precedence over rData when set
 
     AnswerSection(std::string q, DNS::DnsEnum::QueryType qType, DNS::DnsEnum::QueryClass qClass, uint32_t timeToLive, std::string data)
        : query(std::move(q)), queryType(qType), queryClass(qClass), ttl(timeToLive), rData(std::move(data)) {}
 
-};
-
-class AnswerSectionWithPriority {
-public:
-
-    std::string query;
-    DNS::DnsEnum::QueryType queryType;
-    DNS::DnsEnum::QueryClass queryClass;
-    uint16_t priority;
-    uint32_t ttl;
-    std::string rData;
-
-    AnswerSectionWithPriority(std::string q, DNS::DnsEnum::QueryType qType, DNS::DnsEnum::QueryClass qClass, uint16_t priority, uint32_t timeToLive, std::string data)
-        : query(std::move(q)), queryType(qType), queryClass(qClass), priority(priority), ttl(timeToLive), rData(std::move(data)) {}
-
+    AnswerSection(std::string q, DNS::DnsEnum::QueryType qType, DNS::DnsEnum::QueryClass qClass, uint32_t timeToLive, std::vector<uint8_t> wire)
+       : query(std::move(q)), queryType(qType), queryClass(qClass), ttl(timeToLive), wireData(std::move(wire)) {}
 
 };
 
-
 class DnsRequestBody {
     public:
-    uint16_t transactionID;
-    uint16_t flags;
-    uint16_t questions;
-    uint16_t answerRRs;
-    uint16_t authorityRRs;
-    uint16_t additionalRRs;
+    uint16_t transactionID = 0;
+    uint16_t flags = 0;
+    uint16_t questions = 0;
+    uint16_t answerRRs = 0;
+    uint16_t authorityRRs = 0;
+    uint16_t additionalRRs = 0;
     std::pmr::list<QuestionSection> questionsSection;
+
+    // Header and questions parsed; transaction ID 0 is a legal ID, not an error marker
+    bool valid = false;
+
+    // EDNS0 (RFC 6891), filled from the OPT pseudo-RR in the additional section
+    bool hasEdns = false;
+    uint16_t udpPayloadSize = 512;
+    uint8_t ednsVersion = 0;
+    bool dnssecOk = false;
+    std::vector<uint8_t> ednsOptions;
+
+    // DNS Cookies (RFC 7873) from the COOKIE option
+    std::vector<uint8_t> clientCookie;
+    std::vector<uint8_t> serverCookie;
+    bool cookieMalformed = false;
+
+    // What we put in our own OPT record when replying
+    std::vector<uint8_t> replyEdnsOptions;
+    uint8_t replyExtendedRcode = 0;
 };
 
 
@@ -0,0 +1,665 @@
+#include "dnssec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <sys/stat.h>
+
+#include <openssl/core_names.h>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+
+#include "dns.h"
+#include "dnsEnum.h"
+#include "logger.h"
+#include "metrics.h"
+#include "rdata.h"
+
+
+void DNS::Dnssec::setKeyDirectory(const std::string &directory) {
+    keyDirectory = directory;
+}
+
+void DNS::Dnssec::setAlgorithm(const std::string &name) {
+    std::string upper = name;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    algorithm = (upper == "ED25519" || upper == "15") ? ED25519 : ECDSAP256SHA256;
+}
+
+void DNS::Dnssec::setGenerateKeys(bool generate) {
+    generateKeys = generate;
+}
+
+void DNS::Dnssec::setValidity(uint32_t seconds) {
+    validity = std::max<uint32_t>(seconds, 3600);
+}
+
+void DNS::Dnssec::setMaxCachedSignatures(size_t entries) {
+    maxCachedSignatures = entries;
+}
+
+void DNS::Dnssec::setZoneSource(std::function<std::vector<std::string>()> source) {
+    zoneSource = std::move(source);
+}
+
+void DNS::Dnssec::setRecordSource(std::function<ZoneRecords(const std::string &zone)> source) {
+    recordSource = std::move(source);
+}
+
+void DNS::Dnssec::start() {
+    refreshKeys();
+    if (recordSource) {
+        std::vector<std::string> zones;
+        {
+            std::shared_lock<std::shared_mutex> lock(keyMutex);
+            for (const auto &[zone, key]: keys) {
+                zones.push_back(zone);
+            }
+        }
+        for (const auto &zone: zones) {
+            signZone(zone);
+        }
+    }
+    std::thread([this] { resignLoop(); }).detach();
+    std::thread([this] { signLoop(); }).detach();
+}
+
+void DNS::Dnssec::zoneChanged(const std::string &zone) {
+    if (!enabled() || !recordSource) {
+        return;
+    }
+    std::string name = lowercase(zone);
+    if (keyFor(name) == nullptr) {
+        auto key = loadOrGenerateKey(name);
+        if (key == nullptr) {
+            return;
+        }
+        std::unique_lock<std::shared_mutex> lock(keyMutex);
+        keys.emplace(name, std::move(key));
+    }
+    signZone(name);
+}
+
+bool DNS::Dnssec::isSigned(const std::string &zone) {
+    return enabled() && keyFor(zone) != nullptr;
+}
+
+void DNS::Dnssec::signSection(const std::string &zone, std::pmr::list<AnswerSection> &section) {
+    auto key = keyFor(zone);
+    if (key == nullptr) {
+        return;
+    }
+
+    std::vector<AnswerSection *> records;
+    for (auto &record: section) {
+        if (record.queryType != DnsEnum::QueryType::RRSIG && record.queryType != DnsEnum::QueryType::OPT) {
+            records.push_back(&record);
+        }
+    }
+
+    std::pmr::list<AnswerSection> signatures;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records[i] == nullptr) {
+            continue;
+        }
+        AnswerSection &head = *records[i];
+        std::string owner = lowercase(head.query);
+
+        // Every member of the RRset is served in canonical form with one TTL, the
+        // RRset's smallest, never more than the signature's Original TTL.
+        std::vector<AnswerSection *> rrset;
+        uint32_t ttl = head.ttl;
+        for (size_t j = i; j < records.size(); j++) {
+            if (records[j] != nullptr && records[j]->queryType == head.queryType && lowercase(records[j]->query) == owner) {
+                rrset.push_back(records[j]);
+                ttl = std::min(ttl, records[j]->ttl);
+                records[j] = nullptr;
+            }
+        }
+
+        std::vector<std::vector<uint8_t>> rdatas;
+        try {
+            for (auto *record: rrset) {
+                record->wireData = canonicalRData(*record);
+                record->ttl = ttl;
+                rdatas.push_back(record->wireData);
+            }
+        } catch (const RData::Error &) {
+            continue; // left unsigned; createResponse answers SERVFAIL for it
+        }
+        std::sort(rdatas.begin(), rdatas.end());
+        rdatas.erase(std::unique(rdatas.begin(), rdatas.end()), rdatas.end());
+
+        std::vector<uint8_t> rrsig;
+        uint32_t originalTtl = ttl;
+        if (!findSignature(lowercase(zone), owner, static_cast<uint16_t>(head.queryType), ttl, rdatas, rrsig, originalTtl)) {
+            continue;
+        }
+        ttl = std::min(ttl, originalTtl);
+        for (auto *record: rrset) {
+            record->ttl = ttl;
+        }
+        signatures.push_back(AnswerSection(head.query, DnsEnum::QueryType::RRSIG, head.queryClass, ttl, rrsig));
+    }
+    section.splice(section.end(), signatures);
+}
+
+void DNS::Dnssec::addDnskey(const std::string &zone, uint32_t ttl, std::pmr::list<AnswerSection> &answers) {
+    auto key = keyFor(zone);
+    if (key != nullptr) {
+        answers.push_back(AnswerSection(zone, DnsEnum::QueryType::DNSKEY, DnsEnum::QueryClass::IN, ttl, key->dnskey));
+    }
+}
+
+void DNS::Dnssec::addDenial(const std::string &owner, std::vector<uint16_t> typesAtOwner, uint32_t ttl,
+                            std::pmr::list<AnswerSection> &authority) {
+    if (typesAtOwner.empty()) {
+        typesAtOwner.push_back(NXNAME);
+    }
+    typesAtOwner.push_back(static_cast<uint16_t>(DnsEnum::QueryType::RRSIG));
+    typesAtOwner.push_back(static_cast<uint16_t>(DnsEnum::QueryType::NSEC));
+    std::sort(typesAtOwner.begin(), typesAtOwner.end());
+    typesAtOwner.erase(std::unique(typesAtOwner.begin(), typesAtOwner.end()), typesAtOwner.end());
+
+    // Next owner is the immediate successor "\000.<owner>", so the NSEC covers
+    // exactly one name and can be signed once and cached like any other RRset.
+    std::vector<uint8_t> rdata = {1, 0};
+    std::vector<uint8_t> ownerWire = CreateResponse::domainToDnsFormat(lowercase(owner));
+    rdata.insert(rdata.end(), ownerWire.begin(), ownerWire.end());
+
+    // Type bitmap, one window block per high byte
+    size_t i = 0;
+    while (i < typesAtOwner.size()) {
+        uint8_t window = typesAtOwner[i] >> 8;
+        uint8_t bitmap[32] = {};
+        uint8_t length = 0;
+        for (; i < typesAtOwner.size() && (typesAtOwner[i] >> 8) == window; i++) {
+            uint8_t low = typesAtOwner[i] & 0xFF;
+            bitmap[low / 8] |= 0x80 >> (low % 8);
+            length = low / 8 + 1;
+        }
+        rdata.push_back(window);
+        rdata.push_back(length);
+        rdata.insert(rdata.end(), bitmap, bitmap + length);
+    }
+
+    authority.push_back(AnswerSection(owner, DnsEnum::QueryType::NSEC, DnsEnum::QueryClass::IN, ttl, rdata));
+}
+
+size_t DNS::Dnssec::cachedSignatures() {
+    std::shared_lock<std::shared_mutex> lock(cacheMutex);
+    return zoneSignatures.size() + cache.size();
+}
+
+std::shared_ptr<DNS::Dnssec::ZoneKey> DNS::Dnssec::keyFor(const std::string &zone) {
+    std::string name = lowercase(zone);
+    std::shared_lock<std::shared_mutex> lock(keyMutex);
+    auto it = keys.find(name);
+    return it != keys.end() ? it->second : nullptr;
+}
+
+void DNS::Dnssec::refreshKeys() {
+    if (!enabled() || !zoneSource) {
+        return;
+    }
+    std::vector<std::string> zones;
+    try {
+        zones = zoneSource();
+    } catch (const std::exception &e) {
+        Logger::warn("cannot list zones for DNSSEC keys", {{"error", e.what()}});
+        return;
+    }
+    std::unordered_map<std::string, std::shared_ptr<ZoneKey>> loaded;
+    {
+        std::shared_lock<std::shared_mutex> lock(keyMutex);
+        loaded = keys;
+    }
+    // Disk access happens here only, for zones the store holds
+    std::unordered_map<std::string, std::shared_ptr<ZoneKey>> next;
+    for (const auto &zone: zones) {
+        std::string name = lowercase(zone);
+        auto it = loaded.find(name);
+        auto key = it != loaded.end() ? it->second : loadOrGenerateKey(name);
+        if (key != nullptr) {
+            next.emplace(name, std::move(key));
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(keyMutex);
+    keys.swap(next);
+}
+
+std::shared_ptr<DNS::Dnssec::ZoneKey> DNS::Dnssec::loadOrGenerateKey(const std::string &zone) {
+    if (zone.empty() || zone.find('/') != std::string::npos) {
+        return nullptr;
+    }
+    std::string path = keyDirectory + "/" + zone + ".pem";
+    auto key = std::make_shared<ZoneKey>();
+
+    FILE *file = fopen(path.c_str(), "r");
+    if (file != nullptr) {
+        key->key = PEM_read_PrivateKey(file, nullptr, nullptr, nullptr);
+        fclose(file);
+    } else if (generateKeys) {
+        key->key = algorithm == ED25519 ? EVP_PKEY_Q_keygen(nullptr, nullptr, "ED25519")
+                                        : EVP_PKEY_Q_keygen(nullptr, nullptr, "EC", "P-256");
+        FILE *out = key->key != nullptr ? fopen(path.c_str(), "w") : nullptr;
+        if (out != nullptr) {
+            chmod(path.c_str(), S_IRUSR | S_IWUSR);
+            PEM_write_PrivateKey(out, key->key, nullptr, nullptr, 0, nullptr, nullptr);
+            fclose(out);
+            std::cout << "Generated DNSSEC key " << path << '\n';
+        }
+    }
+    if (key->key == nullptr) {
+        return nullptr;
+    }
+
+    std::vector<uint8_t> publicKey;
+    if (EVP_PKEY_get_base_id(key->key) == EVP_PKEY_ED25519) {
+        key->algorithm = ED25519;
+        size_t length = 32;
+        publicKey.resize(length);
+        EVP_PKEY_get_raw_public_key(key->key, publicKey.data(), &length);
+    } else if (EVP_PKEY_get_base_id(key->key) == EVP_PKEY_EC) {
+        key->algorithm = ECDSAP256SHA256;
+        uint8_t encoded[65];
+        size_t length = 0;
+        // Uncompressed point 0x04 | X | Y; DNSKEY carries X | Y
+        if (EVP_PKEY_get_octet_string_param(key->key, OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY, encoded, sizeof(encoded), &length) != 1 ||
+            length != 65) {
+            std::cerr << "DNSSEC key " << path << " is not a P-256 key" << '\n';
+            return nullptr;
+        }
+        publicKey.assign(encoded + 1, encoded + 65);
+    } else {
+        std::cerr << "Unsupported DNSSEC key type in " << path << '\n';
+        return nullptr;
+    }
+
+    // Combined signing key: flags 257 (zone key + SEP), protocol 3
+    key->dnskey = {0x01, 0x01, 3, key->algorithm};
+    key->dnskey.insert(key->dnskey.end(), publicKey.begin(), publicKey.end());
+    key->keyTag = computeKeyTag(key->dnskey);
+    return key;
+}
+
+void DNS::Dnssec::signZone(const std::string &zone) {
+    auto key = keyFor(zone);
+    if (key == nullptr) {
+        return;
+    }
+    ZoneRecords records;
+    try {
+        records = recordSource(zone);
+    } catch (const std::exception &e) {
+        Logger::warn("cannot read zone to sign", {{"zone", zone}, {"error", e.what()}});
+        return;
+    }
+
+    // RRsets by owner and type, each with its smallest TTL
+    struct RRset {
+        uint32_t ttl = UINT32_MAX;
+        std::vector<std::vector<uint8_t>> rdatas;
+    };
+    std::map<std::pair<std::string, uint16_t>, RRset> rrsets;
+    uint32_t soaTtl = 0;
+    for (const auto &record: *records) {
+        std::vector<uint8_t> rdata = record.rdata;
+        if (rdata.empty()) {
+            try {
+                rdata = RData::encode(record.type, record.value);
+            } catch (const RData::Error &) {
+                continue; // never served either
+            }
+        }
+        std::string owner = record.name == "@" ? zone : lowercase(record.name) + "." + zone;
+        RRset &rrset = rrsets[{owner, static_cast<uint16_t>(record.type)}];
+        rrset.ttl = std::min(rrset.ttl, record.ttl);
+        rrset.rdatas.push_back(std::move(rdata));
+        if (record.type == DnsEnum::QueryType::SOA && record.name == "@") {
+            soaTtl = record.ttl;
+        }
+    }
+    // The DNSKEY RRset is served with the SOA's TTL (see zoneTtl in main.cpp)
+    if (soaTtl != 0) {
+        rrsets[{zone, static_cast<uint16_t>(DnsEnum::QueryType::DNSKEY)}] = RRset{soaTtl, {key->dnskey}};
+    }
+
+    std::unordered_map<std::string, std::shared_ptr<CachedSignature>> previous;
+    {
+        std::shared_lock<std::shared_mutex> lock(cacheMutex);
+        auto keysOfZone = zoneSignatureKeys.find(zone);
+        if (keysOfZone != zoneSignatureKeys.end()) {
+            for (const auto &cacheKey: keysOfZone->second) {
+                previous.emplace(cacheKey, zoneSignatures.at(cacheKey));
+            }
+        }
+    }
+
+    uint32_t current = now();
+    std::vector<std::shared_ptr<CachedSignature>> signatures;
+    size_t reused = 0;
+    for (auto &[name, rrset]: rrsets) {
+        const auto &[owner, type] = name;
+        if (type == static_cast<uint16_t>(DnsEnum::QueryType::RRSIG)) {
+            continue;
+        }
+        std::sort(rrset.rdatas.begin(), rrset.rdatas.end());
+        rrset.rdatas.erase(std::unique(rrset.rdatas.begin(), rrset.rdatas.end()), rrset.rdatas.end());
+        std::string cacheKey = signatureKey(zone, owner, type, rrset.rdatas);
+
+        auto old = previous.find(cacheKey);
+        if (old != previous.end() && old->second->ttl == rrset.ttl && old->second->expiration > current + validity / 4) {
+            signatures.push_back(old->second);
+            reused++;
+            continue;
+        }
+        auto entry = std::make_shared<CachedSignature>();
+        entry->cacheKey = std::move(cacheKey);
+        entry->zone = zone;
+        entry->owner = owner;
+        entry->type = type;
+        entry->ttl = rrset.ttl;
+        entry->rdatas = std::move(rrset.rdatas);
+        entry->expiration = current + validity;
+        entry->rrsig = sign(*key, zone, owner, type, entry->ttl, entry->rdatas, current - 3600, entry->expiration);
+        if (!entry->rrsig.empty()) {
+            signatures.push_back(std::move(entry));
+        }
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(cacheMutex);
+        for (const auto &[cacheKey, entry]: previous) {
+            zoneSignatures.erase(cacheKey);
+        }
+        auto &keysOfZone = zoneSignatureKeys[zone];
+        keysOfZone.clear();
+        for (auto &entry: signatures) {
+            keysOfZone.push_back(entry->cacheKey);
+            zoneSignatures[entry->cacheKey] = std::move(entry);
+        }
+    }
+    Logger::info("zone signed", {{"zone", zone}, {"rrsets", signatures.size()}, {"new", signatures.size() - reused}});
+}
+
+bool DNS::Dnssec::findSignature(const std::string &zone, const std::string &owner, uint16_t type, uint32_t ttl,
+                                const std::vector<std::vector<uint8_t>> &rdatas, std::vector<uint8_t> &rrsig,
+                                uint32_t &originalTtl) {
+    std::string cacheKey = signatureKey(zone, owner, type, rdatas);
+    uint32_t current = now();
+    {
+        std::shared_lock<std::shared_mutex> lock(cacheMutex);
+        std::shared_ptr<CachedSignature> entry;
+        auto it = zoneSignatures.find(cacheKey);
+        bool whole = it != zoneSignatures.end();
+        if (whole) {
+            entry = it->second;
+        } else if (auto cached = cache.find(cacheKey); cached != cache.end()) {
+            entry = cached->second;
+        }
+        if (entry != nullptr && entry->expiration > current) {
+            entry->lastUsed.store(current, std::memory_order_relaxed);
+            rrsig = entry->rrsig;
+            originalTtl = entry->ttl;
+            Metrics::add(Metrics::RRSIG_CACHE_HITS);
+            if (whole || ttl <= entry->ttl) {
+                return true;
+            }
+            // The stored TTL went up; served capped until the signer catches up
+        }
+    }
+    if (rrsig.empty()) {
+        Metrics::add(Metrics::RRSIG_CACHE_MISSES);
+    }
+
+    auto entry = std::make_shared<CachedSignature>();
+    entry->cacheKey = std::move(cacheKey);
+    entry->zone = zone;
+    entry->owner = owner;
+    entry->type = type;
+    entry->ttl = ttl;
+    entry->rdatas = rdatas;
+    entry->lastUsed.store(current, std::memory_order_relaxed);
+
+    // A compact denial NSEC is named after the query, so it cannot exist before it
+    auto key = keyFor(zone);
+    if (rrsig.empty() && type == static_cast<uint16_t>(DnsEnum::QueryType::NSEC) && key != nullptr) {
+        entry->expiration = current + validity;
+        entry->rrsig = sign(*key, zone, owner, type, ttl, rdatas, current - 3600, entry->expiration);
+        rrsig = entry->rrsig;
+        originalTtl = ttl;
+        std::unique_lock<std::shared_mutex> lock(cacheMutex);
+        addToCache(std::move(entry));
+        return !rrsig.empty();
+    }
+    queueSigning(std::move(entry));
+    return !rrsig.empty();
+}
+
+void DNS::Dnssec::addToCache(std::shared_ptr<CachedSignature> entry) {
+    if (maxCachedSignatures == 0) {
+        return;
+    }
+    if (cache.size() >= maxCachedSignatures && cache.count(entry->cacheKey) == 0) {
+        cache.erase(cache.begin());
+    }
+    std::string cacheKey = entry->cacheKey;
+    cache[cacheKey] = std::move(entry);
+}
+
+void DNS::Dnssec::queueSigning(std::shared_ptr<CachedSignature> entry) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (queued.size() >= MAX_QUEUED_SIGNATURES || !queued.insert(entry->cacheKey).second) {
+        return;
+    }
+    queue.push_back(std::move(entry));
+    queueReady.notify_one();
+}
+
+void DNS::Dnssec::signLoop() {
+    while (true) {
+        std::shared_ptr<CachedSignature> entry;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [this] { return !queue.empty(); });
+            entry = std::move(queue.front());
+            queue.pop_front();
+        }
+        auto key = keyFor(entry->zone);
+        if (key != nullptr) {
+            uint32_t current = now();
+            entry->expiration = current + validity;
+            entry->rrsig = sign(*key, entry->zone, entry->owner, entry->type, entry->ttl, entry->rdatas, current - 3600,
+                                entry->expiration);
+            if (!entry->rrsig.empty()) {
+                std::unique_lock<std::shared_mutex> lock(cacheMutex);
+                addToCache(entry);
+            }
+        }
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queued.erase(entry->cacheKey);
+    }
+}
+
+std::string DNS::Dnssec::signatureKey(const std::string &zone, const std::string &owner, uint16_t type,
+                                      const std::vector<std::vector<uint8_t>> &rdatas) {
+    std::string cacheKey = zone + '\0' + owner + '\0' + std::to_string(type) + '\0';
+    for (const auto &rdata: rdatas) {
+        cacheKey.push_back(static_cast<char>(rdata.size() >> 8));
+        cacheKey.push_back(static_cast<char>(rdata.size() & 0xFF));
+        cacheKey.append(rdata.begin(), rdata.end());
+    }
+    return cacheKey;
+}
+
+std::vector<uint8_t> DNS::Dnssec::sign(const ZoneKey &key, const std::string &zone, const std::string &owner, uint16_t type,
+                                       uint32_t ttl, const std::vector<std::vector<uint8_t>> &rdatas, uint32_t inception,
+                                       uint32_t expiration) {
+    // RRSIG rdata without the signature (RFC 4034 3.1)
+    std::vector<uint8_t> rrsig;
+    auto add16 = [](std::vector<uint8_t> &out, uint16_t value) {
+        out.push_back(value >> 8);
+        out.push_back(value & 0xFF);
+    };
+    auto add32 = [](std::vector<uint8_t> &out, uint32_t value) {
+        out.push_back(value >> 24);
+        out.push_back((value >> 16) & 0xFF);
+        out.push_back((value >> 8) & 0xFF);
+        out.push_back(value & 0xFF);
+    };
+    add16(rrsig, type);
+    rrsig.push_back(key.algorithm);
+    rrsig.push_back(labelCount(owner));
+    add32(rrsig, ttl);
+    add32(rrsig, expiration);
+    add32(rrsig, inception);
+    add16(rrsig, key.keyTag);
+    std::vector<uint8_t> signer = CreateResponse::domainToDnsFormat(lowercase(zone));
+    rrsig.insert(rrsig.end(), signer.begin(), signer.end());
+
+    // Signed data: RRSIG fields followed by the RRset in canonical order (RFC 4034 3.1.8.1)
+    std::vector<uint8_t> data = rrsig;
+    std::vector<uint8_t> ownerWire = CreateResponse::domainToDnsFormat(owner);
+    for (const auto &rdata: rdatas) {
+        data.insert(data.end(), ownerWire.begin(), ownerWire.end());
+        add16(data, type);
+        add16(data, static_cast<uint16_t>(DnsEnum::QueryClass::IN));
+        add32(data, ttl);
+        add16(data, rdata.size());
+        data.insert(data.end(), rdata.begin(), rdata.end());
+    }
+
+    std::vector<uint8_t> signature;
+    if (!signData(key, data, signature)) {
+        return {};
+    }
+    signCount.fetch_add(1, std::memory_order_relaxed);
+    rrsig.insert(rrsig.end(), signature.begin(), signature.end());
+    return rrsig;
+}
+
+bool DNS::Dnssec::signData(const ZoneKey &key, const std::vector<uint8_t> &data, std::vector<uint8_t> &signature) {
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    const EVP_MD *digest = key.algorithm == ED25519 ? nullptr : EVP_sha256();
+    size_t length = 0;
+    bool ok = EVP_DigestSignInit(ctx, nullptr, digest, nullptr, key.key) == 1 &&
+              EVP_DigestSign(ctx, nullptr, &length, data.data(), data.size()) == 1;
+    std::vector<uint8_t> raw(length);
+    ok = ok && EVP_DigestSign(ctx, raw.data(), &length, data.data(), data.size()) == 1;
+    EVP_MD_CTX_free(ctx);
+    if (!ok) {
+        return false;
+    }
+    raw.resize(length);
+
+    if (key.algorithm == ED25519) {
+        signature = std::move(raw);
+        return true;
+    }
+
+    // ECDSA comes back DER encoded; DNSSEC wants r | s, 32 bytes each (RFC 6605)
+    const unsigned char *der = raw.data();
+    ECDSA_SIG *ecdsa = d2i_ECDSA_SIG(nullptr, &der, static_cast<long>(raw.size()));
+    if (ecdsa == nullptr) {
+        return false;
+    }
+    const BIGNUM *r = nullptr;
+    const BIGNUM *s = nullptr;
+    ECDSA_SIG_get0(ecdsa, &r, &s);
+    signature.assign(64, 0);
+    BN_bn2binpad(r, signature.data(), 32);
+    BN_bn2binpad(s, signature.data() + 32, 32);
+    ECDSA_SIG_free(ecdsa);
+    return true;
+}
+
+void DNS::Dnssec::resignLoop() {
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(60));
+        refreshKeys();
+        uint32_t current = now();
+
+        std::vector<std::shared_ptr<CachedSignature>> due;
+        {
+            std::unique_lock<std::shared_mutex> lock(cacheMutex);
+            for (const auto &[cacheKey, entry]: zoneSignatures) {
+                if (entry->expiration <= current + validity / 4 + 120) {
+                    due.push_back(entry);
+                }
+            }
+            for (auto it = cache.begin(); it != cache.end();) {
+                auto &entry = it->second;
+                // RRsets nobody asked for in half a validity period are dropped, not renewed
+                if (current - entry->lastUsed.load(std::memory_order_relaxed) > validity / 2) {
+                    it = cache.erase(it);
+                    continue;
+                }
+                if (entry->expiration <= current + validity / 4 + 120) {
+                    due.push_back(entry);
+                }
+                ++it;
+            }
+        }
+
+        for (auto &entry: due) {
+            auto key = keyFor(entry->zone);
+            if (key == nullptr) {
+                continue;
+            }
+            uint32_t expiration = now() + validity;
+            auto rrsig = sign(*key, entry->zone, entry->owner, entry->type, entry->ttl, entry->rdatas, now() - 3600, expiration);
+            if (rrsig.empty()) {
+                continue;
+            }
+            std::unique_lock<std::shared_mutex> lock(cacheMutex);
+            entry->rrsig = std::move(rrsig);
+            entry->expiration = expiration;
+        }
+    }
+}
+
+std::vector<uint8_t> DNS::Dnssec::canonicalRData(const AnswerSection &record) {
+    if (!record.wireData.empty()) {
+        return record.wireData;
+    }
+    // The encoder writes names in lower case, as the canonical form wants (RFC 4034 6.2)
+    return RData::encode(record.queryType, record.rData);
+}
+
+std::string DNS::Dnssec::lowercase(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    if (!value.empty() && value.back() == '.') {
+        value.pop_back();
+    }
+    return value;
+}
+
+uint8_t DNS::Dnssec::labelCount(const std::string &owner) {
+    if (owner.empty()) {
+        return 0;
+    }
+    uint8_t labels = static_cast<uint8_t>(std::count(owner.begin(), owner.end(), '.') + 1);
+    if (owner.rfind("*.", 0) == 0) {
+        labels--; // wildcard label is not counted
+    }
+    return labels;
+}
+
+uint16_t DNS::Dnssec::computeKeyTag(const std::vector<uint8_t> &dnskey) {
+    // RFC 4034 Appendix B
+    uint32_t accumulator = 0;
+    for (size_t i = 0; i < dnskey.size(); i++) {
+        accumulator += (i & 1) ? dnskey[i] : dnskey[i] << 8;
+    }
+    accumulator += (accumulator >> 16) & 0xFFFF;
+    return accumulator & 0xFFFF;
+}
+
+uint32_t DNS::Dnssec::now() {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
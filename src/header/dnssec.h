@@ -0,0 +1,207 @@
+#ifndef DNSSEC_H
+#define DNSSEC_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <openssl/evp.h>
+
+#include "dnsRequestBody.h"
+#include "../database/recordStore.h"
+
+namespace DNS {
+
+    // Online DNSSEC signing. Each zone has one combined signing key (ECDSA P-256
+    // or Ed25519) kept as <keyDirectory>/<zone>.pem. Keys are loaded, or
+    // generated, for the zones the record store holds, at startup and then
+    // once a minute; queries only look them up.
+    //
+    // Zones held in memory are signed whole when they are loaded or replaced,
+    // so their answers only look signatures up. RRsets of other backends
+    // (PostgreSQL) are queued for a background signer the first time they are
+    // served and go out unsigned until it is done. Each RRSIG carries the
+    // RRset's stored TTL as its Original TTL, so served TTLs may count down
+    // without touching the signature. A background thread renews signatures
+    // before they expire. Negative answers use compact denial of existence
+    // (RFC 9824): an NSEC record that covers only the queried name, which can
+    // only be signed once that name is asked for.
+    class Dnssec {
+    public:
+
+        static constexpr uint8_t ECDSAP256SHA256 = 13;
+        static constexpr uint8_t ED25519 = 15;
+        static constexpr uint16_t NXNAME = 128;
+
+        static Dnssec& getInstance() {
+            static Dnssec instance;
+            return instance;
+        }
+
+        void setKeyDirectory(const std::string &directory);
+
+        // Algorithm used when a zone has no key yet and key generation is on
+        void setAlgorithm(const std::string &name);
+
+        void setGenerateKeys(bool generate);
+
+        // Lifetime of a signature; it is renewed once a quarter of it is left
+        void setValidity(uint32_t seconds);
+
+        void setMaxCachedSignatures(size_t entries);
+
+        bool enabled() const { return !keyDirectory.empty(); }
+
+        // Lists the zones that get keys; called at startup and once a minute
+        void setZoneSource(std::function<std::vector<std::string>()> source);
+
+        // Records of a zone, for backends that hold whole zones; without it
+        // every RRset is signed in the background when first served
+        void setRecordSource(std::function<ZoneRecords(const std::string &zone)> source);
+
+        // Loads the keys of the current zones and signs the zones of the record
+        // source, then starts the background threads that sign, re-sign and pick
+        // up keys of new zones.
+        void start();
+
+        // Re-signs a zone the record source has loaded or replaced; unchanged
+        // RRsets keep their signatures
+        void zoneChanged(const std::string &zone);
+
+        bool isSigned(const std::string &zone);
+
+        // Rewrites every RRset in section into canonical wire form and appends
+        // its RRSIG. Only NSEC records made by addDenial are signed here.
+        void signSection(const std::string &zone, std::pmr::list<AnswerSection> &section);
+
+        void addDnskey(const std::string &zone, uint32_t ttl, std::pmr::list<AnswerSection> &answers);
+
+        // NSEC for a name that does not exist or lacks the queried type; an empty
+        // typesAtOwner marks the name as nonexistent with the NXNAME pseudo-type.
+        void addDenial(const std::string &owner, std::vector<uint16_t> typesAtOwner, uint32_t ttl,
+                       std::pmr::list<AnswerSection> &authority);
+
+        size_t cachedSignatures();
+
+        uint64_t signaturesCreated() const { return signCount.load(std::memory_order_relaxed); }
+
+    private:
+
+        struct ZoneKey {
+            EVP_PKEY *key = nullptr;
+            uint8_t algorithm = 0;
+            uint16_t keyTag = 0;
+            std::vector<uint8_t> dnskey;
+
+            ~ZoneKey() {
+                if (key != nullptr) {
+                    EVP_PKEY_free(key);
+                }
+            }
+        };
+
+        struct CachedSignature {
+            std::string cacheKey;
+            std::string zone;
+            std::string owner;
+            uint16_t type = 0;
+            uint32_t ttl = 0;                   // stored TTL, the RRSIG's Original TTL
+            std::vector<std::vector<uint8_t>> rdatas;
+            std::vector<uint8_t> rrsig;
+            uint32_t expiration = 0;
+            std::atomic<uint32_t> lastUsed{0};
+        };
+
+        // Signing jobs waiting for the background signer, at most
+        static constexpr size_t MAX_QUEUED_SIGNATURES = 10000;
+
+        Dnssec() : generateKeys(false), algorithm(ECDSAP256SHA256), validity(14 * 86400),
+                   maxCachedSignatures(1000000), signCount(0) {}
+
+        std::shared_ptr<ZoneKey> keyFor(const std::string &zone);
+
+        std::shared_ptr<ZoneKey> loadOrGenerateKey(const std::string &zone);
+
+        // Keys for exactly the zones zoneSource lists; keys already loaded are kept
+        void refreshKeys();
+
+        // Signs every RRset of the zone and swaps the result in for the zone's
+        // previous signatures
+        void signZone(const std::string &zone);
+
+        // RRSIG of an RRset served with ttl, and its Original TTL; false if
+        // there is none yet, in which case it has been queued for signing
+        bool findSignature(const std::string &zone, const std::string &owner, uint16_t type, uint32_t ttl,
+                           const std::vector<std::vector<uint8_t>> &rdatas, std::vector<uint8_t> &rrsig,
+                           uint32_t &originalTtl);
+
+        // Caller holds cacheMutex
+        void addToCache(std::shared_ptr<CachedSignature> entry);
+
+        void queueSigning(std::shared_ptr<CachedSignature> entry);
+
+        void signLoop();
+
+        static std::string signatureKey(const std::string &zone, const std::string &owner, uint16_t type,
+                                        const std::vector<std::vector<uint8_t>> &rdatas);
+
+        std::vector<uint8_t> sign(const ZoneKey &key, const std::string &zone, const std::string &owner, uint16_t type,
+                                  uint32_t ttl, const std::vector<std::vector<uint8_t>> &rdatas, uint32_t inception,
+                                  uint32_t expiration);
+
+        bool signData(const ZoneKey &key, const std::vector<uint8_t> &data, std::vector<uint8_t> &signature);
+
+        void resignLoop();
+
+        static std::vector<uint8_t> canonicalRData(const AnswerSection &record);
+
+        static std::string lowercase(std::string value);
+
+        static uint8_t labelCount(const std::string &owner);
+
+        static uint16_t computeKeyTag(const std::vector<uint8_t> &dnskey);
+
+        static uint32_t now();
+
+        std::string keyDirectory;
+        bool generateKeys;
+        uint8_t algorithm;
+        uint32_t validity;
+        size_t maxCachedSignatures;
+        std::atomic<uint64_t> signCount;
+
+        std::function<std::vector<std::string>()> zoneSource;
+        std::function<ZoneRecords(const std::string &)> recordSource;
+
+        // Replaced whole by refreshKeys; zones without a key have no entry
+        std::shared_mutex keyMutex;
+        std::unordered_map<std::string, std::shared_ptr<ZoneKey>> keys;
+
+        std::shared_mutex cacheMutex;
+        // Signatures of whole zones, replaced with the zone; zone -> its keys
+        std::unordered_map<std::string, std::shared_ptr<CachedSignature>> zoneSignatures;
+        std::unordered_map<std::string, std::vector<std::string>> zoneSignatureKeys;
+        // Signatures made as RRsets were served, at most maxCachedSignatures
+        std::unordered_map<std::string, std::shared_ptr<CachedSignature>> cache;
+
+        std::mutex queueMutex;
+        std::condition_variable queueReady;
+        std::deque<std::shared_ptr<CachedSignature>> queue;
+        std::unordered_set<std::string> queued;     // keys in queue or being signed
+
+        Dnssec(const Dnssec&) = delete;
+        Dnssec& operator=(const Dnssec&) = delete;
+    };
+
+}
+
+#endif // DNSSEC_H
@@ -0,0 +1,344 @@
+#ifndef DNSTAP_H
+#define DNSTAP_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+namespace DNS {
+
+    // dnstap query/response log: protobuf dnstap.Dnstap messages in a Frame
+    // Streams container, written to a file or a Unix socket (fstrm_capture,
+    // dnstap-read, ...). Each thread encodes frames into its own buffer; a
+    // writer thread collects all buffers and writes them in one call every
+    // FLUSH_INTERVAL_MS. A buffer that has grown past MAX_BUFFER_BYTES because the
+    // writer cannot keep up drops new frames, which are counted.
+    class Dnstap {
+    public:
+
+        enum MessageType : uint8_t { AUTH_QUERY = 1, AUTH_RESPONSE = 2 };
+
+        enum Protocol : uint8_t { UDP = 1, TCP = 2, DOT = 3 };
+
+        static constexpr size_t MAX_BUFFER_BYTES = 1 << 20;
+        static constexpr int FLUSH_INTERVAL_MS = 100;
+
+        static Dnstap& getInstance() {
+            static Dnstap instance;
+            return instance;
+        }
+
+        // Log one query in every rate (1 logs everything)
+        void setSampleRate(uint32_t rate) {
+            sampleRate = rate == 0 ? 1 : rate;
+        }
+
+        void setIdentity(const std::string &name) {
+            identity = name;
+        }
+
+        bool enabled() const { return running.load(std::memory_order_relaxed); }
+
+        // A file path, or "unix:<path>" for a Frame Streams socket reader
+        void start(const std::string &output) {
+            destination = output;
+            if (!openOutput()) {
+                std::cerr << "dnstap output " << output << " unavailable, retrying in the background" << std::endl;
+            }
+            running.store(true, std::memory_order_relaxed);
+            std::thread([this] { writeLoop(); }).detach();
+        }
+
+        // Decides once per transaction whether it is logged
+        bool sample() {
+            if (!enabled()) {
+                return false;
+            }
+            if (sampleRate == 1) {
+                return true;
+            }
+            thread_local uint32_t counter = 0;
+            return ++counter % sampleRate == 0;
+        }
+
+        static timespec now() {
+            timespec time{};
+            clock_gettime(CLOCK_REALTIME, &time);
+            return time;
+        }
+
+        void logQuery(Protocol protocol, const sockaddr_in &client, const timespec &queryTime,
+                      const uint8_t *query, size_t length) {
+            append(AUTH_QUERY, protocol, client, queryTime, query, length, nullptr);
+        }
+
+        void logResponse(Protocol protocol, const sockaddr_in &client, const timespec &queryTime,
+                         const uint8_t *response, size_t length) {
+            timespec responseTime = now();
+            append(AUTH_RESPONSE, protocol, client, queryTime, response, length, &responseTime);
+        }
+
+    private:
+
+        struct alignas(64) Buffer {
+            std::mutex mutex;
+            std::string frames;
+            uint64_t frameCount = 0;
+        };
+
+        // Lends the calling thread a buffer for its lifetime
+        struct BufferLease {
+            Buffer *buffer;
+
+            BufferLease() : buffer(getInstance().acquire()) {}
+
+            ~BufferLease() {
+                getInstance().release(buffer);
+            }
+        };
+
+        Dnstap() : sampleRate(1), running(false), fd(-1) {}
+
+        static Buffer &local() {
+            thread_local BufferLease lease;
+            return *lease.buffer;
+        }
+
+        Buffer *acquire() {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            if (!freeBuffers.empty()) {
+                Buffer *buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+                return buffer;
+            }
+            Buffer *buffer = new Buffer();
+            buffers.push_back(buffer);
+            return buffer;
+        }
+
+        void release(Buffer *buffer) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            freeBuffers.push_back(buffer);
+        }
+
+        static void addVarint(std::string &out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        static void addKey(std::string &out, uint32_t field, uint8_t wireType) {
+            addVarint(out, (field << 3) | wireType);
+        }
+
+        static void addVarintField(std::string &out, uint32_t field, uint64_t value) {
+            addKey(out, field, 0);
+            addVarint(out, value);
+        }
+
+        static void addBytesField(std::string &out, uint32_t field, const void *data, size_t length) {
+            addKey(out, field, 2);
+            addVarint(out, length);
+            out.append(static_cast<const char *>(data), length);
+        }
+
+        static void addFixed32Field(std::string &out, uint32_t field, uint32_t value) {
+            addKey(out, field, 5);
+            for (int i = 0; i < 4; i++) {
+                out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+            }
+        }
+
+        static void addFrameLength(std::string &out, uint32_t length) {
+            out.push_back(static_cast<char>(length >> 24));
+            out.push_back(static_cast<char>((length >> 16) & 0xFF));
+            out.push_back(static_cast<char>((length >> 8) & 0xFF));
+            out.push_back(static_cast<char>(length & 0xFF));
+        }
+
+        void append(MessageType type, Protocol protocol, const sockaddr_in &client, const timespec &queryTime,
+                    const uint8_t *wire, size_t length, const timespec *responseTime) {
+            // dnstap.Message
+            thread_local std::string message;
+            message.clear();
+            addVarintField(message, 1, type);
+            addVarintField(message, 2, 1); // INET
+            addVarintField(message, 3, protocol);
+            addBytesField(message, 4, &client.sin_addr, sizeof(client.sin_addr));
+            addVarintField(message, 6, ntohs(client.sin_port));
+            addVarintField(message, 8, queryTime.tv_sec);
+            addFixed32Field(message, 9, queryTime.tv_nsec);
+            if (responseTime == nullptr) {
+                addBytesField(message, 10, wire, length);
+            } else {
+                addVarintField(message, 12, responseTime->tv_sec);
+                addFixed32Field(message, 13, responseTime->tv_nsec);
+                addBytesField(message, 14, wire, length);
+            }
+
+            // dnstap.Dnstap
+            thread_local std::string frame;
+            frame.clear();
+            addBytesField(frame, 1, identity.data(), identity.size());
+            addBytesField(frame, 2, "dns-server", 10);
+            addBytesField(frame, 14, message.data(), message.size());
+            addVarintField(frame, 15, 1); // MESSAGE
+
+            Buffer &buffer = local();
+            std::lock_guard<std::mutex> lock(buffer.mutex);
+            if (buffer.frames.size() + frame.size() + 4 > MAX_BUFFER_BYTES) {
+                Metrics::add(Metrics::DNSTAP_DROPPED);
+                return;
+            }
+            addFrameLength(buffer.frames, frame.size());
+            buffer.frames += frame;
+            buffer.frameCount++;
+        }
+
+        // Control frames: escape, length, type, then fields (content type only)
+        static std::string controlFrame(uint32_t controlType, bool withContentType) {
+            static const std::string contentType = "protobuf:dnstap.Dnstap";
+            std::string body;
+            addFrameLength(body, controlType);
+            if (withContentType) {
+                addFrameLength(body, 1);
+                addFrameLength(body, contentType.size());
+                body += contentType;
+            }
+            std::string out;
+            addFrameLength(out, 0);
+            addFrameLength(out, body.size());
+            return out + body;
+        }
+
+        bool writeAll(const std::string &data) {
+            size_t written = 0;
+            while (written < data.size()) {
+                ssize_t n = write(fd, data.data() + written, data.size() - written);
+                if (n <= 0) {
+                    return false;
+                }
+                written += n;
+            }
+            return true;
+        }
+
+        bool openOutput() {
+            static constexpr uint32_t CONTROL_ACCEPT = 1, CONTROL_START = 2, CONTROL_READY = 4;
+            if (destination.rfind("unix:", 0) == 0) {
+                fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                sockaddr_un remote{};
+                remote.sun_family = AF_UNIX;
+                strncpy(remote.sun_path, destination.c_str() + 5, sizeof(remote.sun_path) - 1);
+                if (fd < 0 || connect(fd, (const struct sockaddr *)&remote, sizeof(remote)) < 0) {
+                    closeOutput();
+                    return false;
+                }
+                // Bidirectional handshake: READY, wait for ACCEPT, then START
+                char reply[256];
+                timeval timeout{2, 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                if (!writeAll(controlFrame(CONTROL_READY, true)) || recv(fd, reply, sizeof(reply), 0) < 12 ||
+                    reply[11] != CONTROL_ACCEPT) {
+                    closeOutput();
+                    return false;
+                }
+            } else {
+                // Appended to, so neither a restart nor reopening after a failed
+                // write loses what is logged; only a new file gets the START frame
+                fd = open(destination.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+                struct stat existing{};
+                if (fd < 0 || fstat(fd, &existing) < 0) {
+                    closeOutput();
+                    return false;
+                }
+                if (existing.st_size > 0) {
+                    return true;
+                }
+            }
+            if (!writeAll(controlFrame(CONTROL_START, true))) {
+                closeOutput();
+                return false;
+            }
+            return true;
+        }
+
+        void closeOutput() {
+            if (fd >= 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+
+        void writeLoop() {
+            std::string batch, spare;
+            std::vector<Buffer *> snapshot;
+            auto lastAttempt = std::chrono::steady_clock::now();
+            while (true) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+                {
+                    std::lock_guard<std::mutex> lock(registryMutex);
+                    snapshot = buffers;
+                }
+                batch.clear();
+                uint64_t frames = 0;
+                for (Buffer *buffer: snapshot) {
+                    {
+                        std::lock_guard<std::mutex> lock(buffer->mutex);
+                        spare.swap(buffer->frames);
+                        frames += buffer->frameCount;
+                        buffer->frameCount = 0;
+                    }
+                    batch += spare;
+                    spare.clear();
+                }
+
+                if (fd < 0 && std::chrono::steady_clock::now() - lastAttempt > std::chrono::seconds(5)) {
+                    lastAttempt = std::chrono::steady_clock::now();
+                    openOutput();
+                }
+                if (batch.empty()) {
+                    continue;
+                }
+                if (fd >= 0 && writeAll(batch)) {
+                    Metrics::add(Metrics::DNSTAP_FRAMES, frames);
+                } else {
+                    Metrics::add(Metrics::DNSTAP_DROPPED, frames);
+                    closeOutput();
+                }
+            }
+        }
+
+        uint32_t sampleRate;
+        std::string identity;
+        std::string destination;
+        std::atomic<bool> running;
+        int fd;
+
+        std::mutex registryMutex;
+        std::vector<Buffer *> buffers;
+        std::vector<Buffer *> freeBuffers;
+        Dnstap(const Dnstap&) = delete;
+        Dnstap& operator=(const Dnstap&) = delete;
+    };
+
+}
+
+#endif // DNSTAP_H
@@ -0,0 +1,720 @@
+#ifndef FORWARDER_H
+#define FORWARDER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <openssl/rand.h>
+#include "dns.h"
+#include "metrics.h"
+#include <unistd.h>
+
+namespace DNS {
+
+    // Relays queries for names we are not authoritative for to upstream
+    // resolvers. Queries leave through a pool of pre-opened UDP sockets on
+    // kernel-randomised ports, with a fresh ID and 0x20 case randomisation of
+    // the question name; a reply is only accepted when socket, upstream, ID and
+    // exact name spelling all match. One background thread receives replies,
+    // enforces per-upstream timeouts and retries, and completes the callers.
+    // Upstreams never see the client's EDNS options and clients never see the
+    // upstream's: each side gets an OPT record of ours, so cookies stay between
+    // the parties that made them. A truncated upstream reply to a TCP or TLS
+    // client is asked for again over TCP, since the client has no transport
+    // left to retry on.
+    class Forwarder {
+    public:
+
+        using Completion = std::function<void(const std::vector<uint8_t>&)>;
+
+        static Forwarder& getInstance() {
+            static Forwarder instance;
+            return instance;
+        }
+
+        // "ip[:port]" entries separated by commas
+        void setUpstreams(const std::string &list) {
+            std::stringstream ss(list);
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                item.erase(std::remove(item.begin(), item.end(), ' '), item.end());
+                if (item.empty()) {
+                    continue;
+                }
+                int upstreamPort = 53;
+                size_t colon = item.find(':');
+                if (colon != std::string::npos) {
+                    upstreamPort = std::stoi(item.substr(colon + 1));
+                    item = item.substr(0, colon);
+                }
+                Upstream upstream{};
+                upstream.addr.sin_family = AF_INET;
+                upstream.addr.sin_port = htons(upstreamPort);
+                if (inet_pton(AF_INET, item.c_str(), &upstream.addr.sin_addr) != 1) {
+                    std::cerr << "Invalid upstream address: " << item << '\n';
+                    continue;
+                }
+                upstreams.push_back(upstream);
+            }
+        }
+
+        void setTimeout(int milliseconds) {
+            maxTimeoutMs = milliseconds;
+        }
+
+        void setRetries(int count) {
+            retries = count;
+        }
+
+        void setCacheSize(size_t entries) {
+            maxCacheEntries = entries;
+        }
+
+        bool enabled() const {
+            return !upstreams.empty();
+        }
+
+        // Opens the socket pool and starts the receive thread.
+        void start(int socketCount) {
+            for (int i = 0; i < socketCount; i++) {
+                int fd = socket(AF_INET, SOCK_DGRAM, 0);
+                if (fd < 0) {
+                    perror("forwarder socket creation failed");
+                    exit(EXIT_FAILURE);
+                }
+                sockaddr_in local{};
+                local.sin_family = AF_INET;
+                local.sin_addr.s_addr = INADDR_ANY;
+                local.sin_port = 0; // the kernel picks a random ephemeral port
+                if (bind(fd, (const struct sockaddr *)&local, sizeof(local)) < 0) {
+                    perror("forwarder bind failed");
+                    exit(EXIT_FAILURE);
+                }
+                sockets.push_back(fd);
+            }
+            std::thread([this] { receiveLoop(); }).detach();
+        }
+
+        // Answers from the cache or relays the query; done is called exactly once,
+        // possibly on the forwarder thread, with the reply for the client. Replies
+        // to an EDNS query carry ednsOptions (our own cookie) in their OPT record.
+        // stream is set for clients on TCP or TLS, which must never get TC=1.
+        void forward(const std::vector<uint8_t> &query, size_t maxSize, std::vector<uint8_t> ednsOptions, bool stream,
+                     Completion done) {
+            size_t questionEnd = 0;
+            std::string key;
+            if (query.size() < 12 || !questionBounds(query, questionEnd, key)) {
+                done({});
+                return;
+            }
+
+            Pending pending;
+            pending.clientQuery = query;
+            pending.questionEnd = questionEnd;
+            pending.edns = readOpt(query, questionEnd);
+            pending.ednsOptions = std::move(ednsOptions);
+            pending.maxSize = maxSize;
+            pending.stream = stream;
+            pending.done = std::move(done);
+
+            // Answers differ with EDNS, DO and CD (RFC 6891, 4035), so they are part of the key
+            bool checkingDisabled = (query[3] & 0x10) != 0;
+            key.push_back(static_cast<char>((pending.edns.present ? 1 : 0) | (pending.edns.dnssecOk ? 2 : 0) |
+                                            (checkingDisabled ? 4 : 0)));
+
+            std::vector<uint8_t> cached;
+            if (lookupCache(key, cached)) {
+                complete(pending, std::move(cached), 0);
+                return;
+            }
+            pending.cacheKey = std::move(key);
+
+            pending.upstreamQuery = query;
+            removeOpt(pending.upstreamQuery, questionEnd);
+            if (pending.edns.present) {
+                appendOpt(pending.upstreamQuery, Edns{true, pending.edns.payloadSize, 0, pending.edns.dnssecOk}, {});
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            send(std::move(pending), -1);
+        }
+
+        ~Forwarder() {
+            for (int fd: sockets) {
+                close(fd);
+            }
+        }
+
+    private:
+
+        using Clock = std::chrono::steady_clock;
+
+        struct Upstream {
+            sockaddr_in addr;
+            double srttMs;
+        };
+
+        // What an OPT record (RFC 6891) says, apart from its options
+        struct Edns {
+            bool present = false;
+            uint16_t payloadSize = 0;
+            uint8_t extendedRcode = 0;
+            bool dnssecOk = false;
+        };
+
+        struct Pending {
+            std::vector<uint8_t> clientQuery;
+            std::vector<uint8_t> upstreamQuery;
+            size_t questionEnd = 0;
+            Edns edns;
+            std::vector<uint8_t> ednsOptions;
+            std::string cacheKey;
+            size_t maxSize = 512;
+            bool stream = false;
+            int upstream = -1;
+            int attempts = 0;
+            Clock::time_point sentAt;
+            Clock::time_point deadline;
+            Completion done;
+        };
+
+        struct CacheEntry {
+            std::vector<uint8_t> response;
+            Clock::time_point storedAt;
+            Clock::time_point expires;
+            std::list<std::string>::iterator recent; // place in the LRU order
+        };
+
+        Forwarder() : maxTimeoutMs(800), retries(2), maxCacheEntries(100000), tcpRetries(0) {}
+
+        static constexpr int MIN_TIMEOUT_MS = 50;
+        static constexpr int MAX_TCP_RETRIES = 64; // at once, each on its own thread
+        static constexpr uint32_t NEGATIVE_TTL = 60;
+        static constexpr size_t OPT_RECORD_SIZE = 11; // without options
+
+        // Caller holds mutex. Picks an upstream (skipping the one that just
+        // failed when there is a choice) and sends a freshly randomised copy.
+        void send(Pending pending, int previous) {
+            int chosen = selectUpstream(previous);
+            int socketIndex = static_cast<int>(randomValue<uint32_t>() % sockets.size());
+            uint16_t id;
+            uint32_t key;
+            do {
+                id = randomValue<uint16_t>();
+                key = (static_cast<uint32_t>(socketIndex) << 16) | id;
+            } while (inFlight.count(key) != 0);
+
+            pending.upstreamQuery[0] = id >> 8;
+            pending.upstreamQuery[1] = id & 0xFF;
+            randomizeCase(pending.upstreamQuery, pending.questionEnd);
+
+            pending.upstream = chosen;
+            pending.attempts++;
+            pending.sentAt = Clock::now();
+            pending.deadline = pending.sentAt + std::chrono::milliseconds(timeoutFor(chosen));
+
+            const Upstream &upstream = upstreams[chosen];
+            if (sendto(sockets[socketIndex], pending.upstreamQuery.data(), pending.upstreamQuery.size(), 0,
+                       (const struct sockaddr *)&upstream.addr, sizeof(upstream.addr)) < 0) {
+                perror("forwarder sendto failed");
+            }
+            inFlight.emplace(key, std::move(pending));
+        }
+
+        // Lowest smoothed RTT wins. Servers not chosen slowly decay towards zero
+        // so a server that was penalised once gets probed again later.
+        int selectUpstream(int exclude) {
+            int best = -1;
+            for (int i = 0; i < static_cast<int>(upstreams.size()); i++) {
+                if (i == exclude && upstreams.size() > 1) {
+                    continue;
+                }
+                if (best == -1 || upstreams[i].srttMs < upstreams[best].srttMs) {
+                    best = i;
+                }
+            }
+            for (int i = 0; i < static_cast<int>(upstreams.size()); i++) {
+                if (i != best) {
+                    upstreams[i].srttMs *= 0.98;
+                }
+            }
+            return best;
+        }
+
+        int timeoutFor(int upstream) const {
+            if (upstreams[upstream].srttMs == 0) {
+                return maxTimeoutMs; // nothing measured yet
+            }
+            double estimate = upstreams[upstream].srttMs * 4;
+            return std::clamp(static_cast<int>(estimate), MIN_TIMEOUT_MS, maxTimeoutMs);
+        }
+
+        void receiveLoop() {
+            std::vector<pollfd> fds;
+            for (int fd: sockets) {
+                fds.push_back(pollfd{fd, POLLIN, 0});
+            }
+            uint8_t buffer[65535];
+            while (true) {
+                int ready = poll(fds.data(), fds.size(), 20);
+                if (ready > 0) {
+                    for (size_t i = 0; i < fds.size(); i++) {
+                        if ((fds[i].revents & POLLIN) == 0) {
+                            continue;
+                        }
+                        sockaddr_in from{};
+                        socklen_t fromLen = sizeof(from);
+                        ssize_t n = recvfrom(fds[i].fd, buffer, sizeof(buffer), MSG_DONTWAIT, (struct sockaddr*)&from, &fromLen);
+                        if (n >= 12) {
+                            handleReply(static_cast<int>(i), from, std::vector<uint8_t>(buffer, buffer + n));
+                        }
+                    }
+                }
+                expireTimeouts();
+            }
+        }
+
+        void handleReply(int socketIndex, const sockaddr_in &from, std::vector<uint8_t> reply) {
+            uint16_t id = (reply[0] << 8) | reply[1];
+            uint32_t key = (static_cast<uint32_t>(socketIndex) << 16) | id;
+
+            Pending pending;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = inFlight.find(key);
+                if (it == inFlight.end()) {
+                    return;
+                }
+                const Pending &candidate = it->second;
+                const Upstream &upstream = upstreams[candidate.upstream];
+                // Source, QR bit and the exact 0x20 spelling of the question must all match
+                if (from.sin_addr.s_addr != upstream.addr.sin_addr.s_addr || from.sin_port != upstream.addr.sin_port ||
+                    (reply[2] & 0x80) == 0 || reply.size() < candidate.questionEnd ||
+                    !std::equal(candidate.upstreamQuery.begin() + 12, candidate.upstreamQuery.begin() + candidate.questionEnd, reply.begin() + 12)) {
+                    return;
+                }
+                pending = std::move(it->second);
+                inFlight.erase(it);
+
+                double sample = std::chrono::duration<double, std::milli>(Clock::now() - pending.sentAt).count();
+                Upstream &answered = upstreams[pending.upstream];
+                answered.srttMs = answered.srttMs == 0 ? sample : answered.srttMs * 0.875 + sample * 0.125;
+            }
+
+            if ((reply[2] & 0x02) != 0 && pending.stream) {
+                retryOverTcp(std::move(pending));
+                return;
+            }
+
+            // The upstream's OPT record, cookie included, is never passed on or cached
+            uint8_t extendedRcode = removeOpt(reply, pending.questionEnd).extendedRcode;
+            if (extendedRcode == 0) {
+                storeCache(pending.cacheKey, reply, pending.questionEnd);
+            }
+            complete(pending, std::move(reply), extendedRcode);
+        }
+
+        // Hands the client back its own ID and spelling of the name, with an OPT
+        // record of ours if it sent one, truncated to what it can receive. A
+        // stream client cannot retry a truncated reply and gets SERVFAIL.
+        static void complete(Pending &pending, std::vector<uint8_t> reply, uint8_t extendedRcode) {
+            reply[0] = pending.clientQuery[0];
+            reply[1] = pending.clientQuery[1];
+            std::copy(pending.clientQuery.begin() + 12, pending.clientQuery.begin() + pending.questionEnd, reply.begin() + 12);
+
+            size_t optSize = pending.edns.present ? OPT_RECORD_SIZE + pending.ednsOptions.size() : 0;
+            if (reply.size() + optSize > pending.maxSize || (pending.stream && (reply[2] & 0x02) != 0)) {
+                reply = pending.stream ? serverFailure(pending.clientQuery, pending.questionEnd)
+                                       : truncatedReply(pending.clientQuery, pending.questionEnd, reply);
+                extendedRcode = 0;
+            }
+            if (pending.edns.present) {
+                appendOpt(reply, Edns{true, CreateResponse::getMaxUdpPayload(), extendedRcode, pending.edns.dnssecOk},
+                          pending.ednsOptions);
+            }
+            pending.done(reply);
+        }
+
+        // Asks the upstream that sent a truncated reply again over TCP, on a thread
+        // of its own so the receive loop keeps going; SERVFAIL when that fails
+        void retryOverTcp(Pending pending) {
+            if (tcpRetries.fetch_add(1) >= MAX_TCP_RETRIES) {
+                tcpRetries.fetch_sub(1);
+                complete(pending, serverFailure(pending.clientQuery, pending.questionEnd), 0);
+                return;
+            }
+            sockaddr_in upstream = upstreams[pending.upstream].addr;
+            std::thread([this, upstream, pending = std::move(pending)]() mutable {
+                std::vector<uint8_t> reply = tcpQuery(upstream, pending.upstreamQuery, maxTimeoutMs);
+                // Same ID and question, a response, and whole this time
+                if (reply.size() < pending.questionEnd || (reply[2] & 0x80) == 0 || (reply[2] & 0x02) != 0 ||
+                    !std::equal(pending.upstreamQuery.begin(), pending.upstreamQuery.begin() + 2, reply.begin()) ||
+                    !std::equal(pending.upstreamQuery.begin() + 12, pending.upstreamQuery.begin() + pending.questionEnd, reply.begin() + 12)) {
+                    complete(pending, serverFailure(pending.clientQuery, pending.questionEnd), 0);
+                } else {
+                    uint8_t extendedRcode = removeOpt(reply, pending.questionEnd).extendedRcode;
+                    if (extendedRcode == 0) {
+                        storeCache(pending.cacheKey, reply, pending.questionEnd);
+                    }
+                    complete(pending, std::move(reply), extendedRcode);
+                }
+                tcpRetries.fetch_sub(1);
+            }).detach();
+        }
+
+        // One query over TCP (RFC 7766): two-byte length, then the message; an
+        // empty reply when the upstream cannot be reached in time
+        static std::vector<uint8_t> tcpQuery(const sockaddr_in &upstream, const std::vector<uint8_t> &query, int timeoutMs) {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (fd < 0) {
+                return {};
+            }
+            timeval timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+            std::vector<uint8_t> message{static_cast<uint8_t>(query.size() >> 8), static_cast<uint8_t>(query.size() & 0xFF)};
+            message.insert(message.end(), query.begin(), query.end());
+            uint8_t length[2];
+            std::vector<uint8_t> reply;
+            if (connect(fd, (const struct sockaddr *)&upstream, sizeof(upstream)) == 0 &&
+                transfer(fd, message.data(), message.size(), false) && transfer(fd, length, sizeof(length), true)) {
+                reply.resize((length[0] << 8) | length[1]);
+                if (!transfer(fd, reply.data(), reply.size(), true)) {
+                    reply.clear();
+                }
+            }
+            close(fd);
+            return reply;
+        }
+
+        // Sends or receives exactly size bytes
+        static bool transfer(int fd, uint8_t *data, size_t size, bool receiving) {
+            size_t done = 0;
+            while (done < size) {
+                ssize_t n = receiving ? recv(fd, data + done, size - done, 0) : ::send(fd, data + done, size - done, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    return false;
+                }
+                done += static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        void expireTimeouts() {
+            std::vector<Pending> failed;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto now = Clock::now();
+                for (auto it = inFlight.begin(); it != inFlight.end();) {
+                    if (it->second.deadline > now) {
+                        ++it;
+                        continue;
+                    }
+                    Pending pending = std::move(it->second);
+                    it = inFlight.erase(it);
+
+                    Upstream &upstream = upstreams[pending.upstream];
+                    upstream.srttMs = std::min<double>(std::max(upstream.srttMs, 1.0) * 2, maxTimeoutMs);
+
+                    if (pending.attempts <= retries) {
+                        int previous = pending.upstream;
+                        send(std::move(pending), previous);
+                    } else {
+                        failed.push_back(std::move(pending));
+                    }
+                }
+            }
+            for (auto &pending: failed) {
+                complete(pending, serverFailure(pending.clientQuery, pending.questionEnd), 0);
+            }
+        }
+
+        bool lookupCache(const std::string &key, std::vector<uint8_t> &response) {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            auto it = cache.find(key);
+            if (it == cache.end()) {
+                Metrics::add(Metrics::FORWARD_CACHE_MISSES);
+                return false;
+            }
+            auto now = Clock::now();
+            if (it->second.expires <= now) {
+                recent.erase(it->second.recent);
+                cache.erase(it);
+                Metrics::add(Metrics::FORWARD_CACHE_MISSES);
+                return false;
+            }
+            Metrics::add(Metrics::FORWARD_CACHE_HITS);
+            recent.splice(recent.begin(), recent, it->second.recent);
+            response = it->second.response;
+            auto age = std::chrono::duration_cast<std::chrono::seconds>(now - it->second.storedAt).count();
+            adjustTtls(response, static_cast<uint32_t>(age));
+            return true;
+        }
+
+        // Positive answers live for their smallest TTL, negative ones for the SOA
+        // minimum (RFC 2308) or a short default. Truncated and failed replies are
+        // not cached. A full cache drops its least recently used entry.
+        void storeCache(const std::string &key, const std::vector<uint8_t> &reply, size_t questionEnd) {
+            uint8_t rcode = reply[3] & 0x0F;
+            bool truncated = (reply[2] & 0x02) != 0;
+            if (truncated || (rcode != 0 && rcode != 3) || maxCacheEntries == 0) {
+                return;
+            }
+            uint32_t ttl = minimumTtl(reply, questionEnd);
+            if (ttl == 0) {
+                return;
+            }
+            auto now = Clock::now();
+            CacheEntry entry{reply, now, now + std::chrono::seconds(ttl), {}};
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            auto existing = cache.find(key);
+            if (existing != cache.end()) {
+                entry.recent = existing->second.recent;
+                recent.splice(recent.begin(), recent, entry.recent);
+                existing->second = std::move(entry);
+                return;
+            }
+            if (cache.size() >= maxCacheEntries) {
+                cache.erase(recent.back());
+                recent.pop_back();
+            }
+            recent.push_front(key);
+            entry.recent = recent.begin();
+            cache.emplace(key, std::move(entry));
+        }
+
+        // Visits every resource record after the question; stops on malformed data.
+        template<typename Visitor>
+        static void forEachRecord(const std::vector<uint8_t> &packet, size_t pos, Visitor visit) {
+            uint32_t count = ((packet[6] << 8) | packet[7]) + ((packet[8] << 8) | packet[9]) + ((packet[10] << 8) | packet[11]);
+            uint16_t answers = (packet[6] << 8) | packet[7];
+            for (uint32_t i = 0; i < count; i++) {
+                if (!skipName(packet, pos) || pos + 10 > packet.size()) {
+                    return;
+                }
+                uint16_t type = (packet[pos] << 8) | packet[pos + 1];
+                uint16_t rdLength = (packet[pos + 8] << 8) | packet[pos + 9];
+                if (pos + 10 + rdLength > packet.size()) {
+                    return;
+                }
+                visit(i < answers, type, pos + 4, pos + 10, rdLength);
+                pos += 10 + rdLength;
+            }
+        }
+
+        static uint32_t minimumTtl(const std::vector<uint8_t> &reply, size_t questionEnd) {
+            const std::vector<uint8_t> &packet = reply;
+            uint32_t ttl = UINT32_MAX;
+            bool negative = (reply[3] & 0x0F) == 3 || ((reply[6] << 8) | reply[7]) == 0;
+            forEachRecord(packet, questionEnd, [&](bool answer, uint16_t type, size_t ttlPos, size_t rdStart, uint16_t rdLength) {
+                if (type == 41) {
+                    return;
+                }
+                uint32_t recordTtl = readUint32(packet, ttlPos);
+                if (answer) {
+                    ttl = std::min(ttl, recordTtl);
+                } else if (negative && type == 6 && rdLength >= 4) {
+                    ttl = std::min({ttl, recordTtl, readUint32(packet, rdStart + rdLength - 4)});
+                }
+            });
+            if (ttl == UINT32_MAX) {
+                return negative ? NEGATIVE_TTL : 0;
+            }
+            return ttl;
+        }
+
+        static void adjustTtls(std::vector<uint8_t> &packet, uint32_t age) {
+            if (age == 0) {
+                return;
+            }
+            size_t questionEnd;
+            std::string unused;
+            if (!questionBounds(packet, questionEnd, unused)) {
+                return;
+            }
+            forEachRecord(packet, questionEnd, [&](bool, uint16_t type, size_t ttlPos, size_t, uint16_t) {
+                if (type == 41) {
+                    return;
+                }
+                uint32_t ttl = readUint32(packet, ttlPos);
+                ttl = ttl > age ? ttl - age : 0;
+                packet[ttlPos] = ttl >> 24;
+                packet[ttlPos + 1] = (ttl >> 16) & 0xFF;
+                packet[ttlPos + 2] = (ttl >> 8) & 0xFF;
+                packet[ttlPos + 3] = ttl & 0xFF;
+            });
+        }
+
+        // Finds the end of the single question and builds a case-insensitive cache key.
+        static bool questionBounds(const std::vector<uint8_t> &packet, size_t &questionEnd, std::string &key) {
+            if (((packet[4] << 8) | packet[5]) != 1) {
+                return false;
+            }
+            size_t pos = 12;
+            key.clear();
+            while (pos < packet.size() && packet[pos] != 0) {
+                uint8_t length = packet[pos];
+                if ((length & 0xC0) != 0 || pos + 1 + length >= packet.size()) {
+                    return false;
+                }
+                for (size_t i = pos + 1; i <= pos + length; i++) {
+                    key.push_back(static_cast<char>(std::tolower(packet[i])));
+                }
+                key.push_back('.');
+                pos += length + 1;
+            }
+            if (pos + 5 > packet.size()) {
+                return false;
+            }
+            key.append(reinterpret_cast<const char*>(&packet[pos + 1]), 4); // qtype and qclass
+            questionEnd = pos + 5;
+            return true;
+        }
+
+        // The OPT record in packet, if there is one
+        static Edns readOpt(const std::vector<uint8_t> &packet, size_t questionEnd) {
+            size_t start, end;
+            return findOpt(packet, questionEnd, start, end);
+        }
+
+        // Takes the OPT record out of packet and says what it held
+        static Edns removeOpt(std::vector<uint8_t> &packet, size_t questionEnd) {
+            size_t start = 0, end = 0;
+            Edns edns = findOpt(packet, questionEnd, start, end);
+            if (edns.present) {
+                packet.erase(packet.begin() + start, packet.begin() + end);
+                uint16_t additional = ((packet[10] << 8) | packet[11]) - 1;
+                packet[10] = additional >> 8;
+                packet[11] = additional & 0xFF;
+            }
+            return edns;
+        }
+
+        static Edns findOpt(const std::vector<uint8_t> &packet, size_t questionEnd, size_t &start, size_t &end) {
+            Edns edns;
+            forEachRecord(packet, questionEnd, [&](bool, uint16_t type, size_t ttlPos, size_t rdStart, uint16_t rdLength) {
+                // The owner of an OPT record is the root, one byte before type and class
+                if (type != 41 || edns.present || packet[ttlPos - 5] != 0) {
+                    return;
+                }
+                edns.present = true;
+                edns.payloadSize = (packet[ttlPos - 2] << 8) | packet[ttlPos - 1];
+                edns.extendedRcode = packet[ttlPos];
+                edns.dnssecOk = (packet[ttlPos + 2] & 0x80) != 0;
+                start = ttlPos - 5;
+                end = rdStart + rdLength;
+            });
+            return edns;
+        }
+
+        static void appendOpt(std::vector<uint8_t> &packet, const Edns &edns, const std::vector<uint8_t> &options) {
+            uint8_t record[OPT_RECORD_SIZE] = {0, 0, 41, static_cast<uint8_t>(edns.payloadSize >> 8),
+                                               static_cast<uint8_t>(edns.payloadSize & 0xFF), edns.extendedRcode, 0,
+                                               static_cast<uint8_t>(edns.dnssecOk ? 0x80 : 0), 0,
+                                               static_cast<uint8_t>(options.size() >> 8),
+                                               static_cast<uint8_t>(options.size() & 0xFF)};
+            packet.insert(packet.end(), record, record + OPT_RECORD_SIZE);
+            packet.insert(packet.end(), options.begin(), options.end());
+            uint16_t additional = ((packet[10] << 8) | packet[11]) + 1;
+            packet[10] = additional >> 8;
+            packet[11] = additional & 0xFF;
+        }
+
+        // IDs, socket choice and 0x20 bits are what stops spoofed replies (RFC
+        // 5452), so they come from the OpenSSL generator, not a seeded PRNG.
+        template<typename T>
+        static T randomValue() {
+            T value;
+            if (RAND_bytes(reinterpret_cast<unsigned char *>(&value), sizeof(value)) != 1) {
+                std::cerr << "forwarder RAND_bytes failed" << '\n';
+                exit(EXIT_FAILURE);
+            }
+            return value;
+        }
+
+        static void randomizeCase(std::vector<uint8_t> &packet, size_t questionEnd) {
+            uint64_t bits = randomValue<uint64_t>();
+            int used = 0;
+            for (size_t i = 12; i + 4 < questionEnd; i++) {
+                uint8_t c = packet[i];
+                if (std::isalpha(c)) {
+                    if (used == 64) {
+                        bits = randomValue<uint64_t>();
+                        used = 0;
+                    }
+                    packet[i] = (bits >> used++) & 1 ? std::toupper(c) : std::tolower(c);
+                }
+            }
+        }
+
+        // Header and question only, with TC set, so the client retries over a stream transport.
+        static std::vector<uint8_t> truncatedReply(const std::vector<uint8_t> &query, size_t questionEnd, const std::vector<uint8_t> &reply) {
+            std::vector<uint8_t> packet(query.begin(), query.begin() + questionEnd);
+            packet[2] = reply[2] | 0x02;
+            packet[3] = reply[3];
+            std::fill(packet.begin() + 6, packet.begin() + 12, 0);
+            return packet;
+        }
+
+        static std::vector<uint8_t> serverFailure(const std::vector<uint8_t> &query, size_t questionEnd) {
+            std::vector<uint8_t> packet(query.begin(), query.begin() + questionEnd);
+            packet[2] = 0x80 | (query[2] & 0x01); // QR, keep RD
+            packet[3] = 0x80 | 0x02; // RA, SERVFAIL
+            std::fill(packet.begin() + 6, packet.begin() + 12, 0);
+            return packet;
+        }
+
+        static bool skipName(const std::vector<uint8_t> &data, size_t &pos) {
+            while (pos < data.size()) {
+                uint8_t length = data[pos];
+                if (length == 0) {
+                    pos++;
+                    return true;
+                }
+                if ((length & 0xC0) == 0xC0) {
+                    pos += 2;
+                    return pos <= data.size();
+                }
+                pos += length + 1;
+            }
+            return false;
+        }
+
+        static uint32_t readUint32(const std::vector<uint8_t> &data, size_t pos) {
+            return (static_cast<uint32_t>(data[pos]) << 24) | (data[pos + 1] << 16) | (data[pos + 2] << 8) | data[pos + 3];
+        }
+
+        std::vector<Upstream> upstreams;
+        std::vector<int> sockets;
+        int maxTimeoutMs;
+        int retries;
+        size_t maxCacheEntries;
+        std::atomic<int> tcpRetries;
+        std::mutex mutex;
+        std::unordered_map<uint32_t, Pending> inFlight;
+        std::mutex cacheMutex;
+        std::unordered_map<std::string, CacheEntry> cache;
+        std::list<std::string> recent; // cache keys, most recently used first
+        Forwarder(const Forwarder&) = delete;
+        Forwarder& operator=(const Forwarder&) = delete;
+    };
+
+}
+
+#endif // FORWARDER_H
@@ -0,0 +1,263 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <unistd.h>
+
+#include "metrics.h"
+
+namespace DNS {
+
+    // Structured, leveled logging that never blocks the caller. A log call copies
+    // its message pointer and fields into the calling thread's ring buffer; a
+    // background thread drains the rings, formats the lines and writes them in
+    // batches. A full ring drops the record and counts it. Debug records only
+    // exist in builds with DNS_DEBUG_LOG defined and are also gated at runtime.
+    class Logger {
+    public:
+
+        enum class Level : uint8_t { DEBUG, INFO, WARN, ERROR };
+
+#ifdef DNS_DEBUG_LOG
+        static constexpr bool DEBUG_COMPILED = true;
+#else
+        static constexpr bool DEBUG_COMPILED = false;
+#endif
+
+        static constexpr int MAX_FIELDS = 4;
+        static constexpr int FIELD_TEXT_SIZE = 46;
+        static constexpr uint32_t RING_SIZE = 256;
+
+        // key=value pair; only references the caller's data until it is recorded
+        struct Field {
+            const char *key;
+            std::string_view text;
+            int64_t number = 0;
+            bool isNumber = false;
+
+            Field(const char *key, std::string_view text) : key(key), text(text) {}
+
+            Field(const char *key, const std::string &text) : key(key), text(text) {}
+
+            Field(const char *key, const char *text) : key(key), text(text) {}
+
+            template<typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+            Field(const char *key, T number) : key(key), number(static_cast<int64_t>(number)), isNumber(true) {}
+        };
+
+        static Logger& getInstance() {
+            static Logger instance;
+            return instance;
+        }
+
+        // "debug", "info", "warn" or "error"
+        void setLevel(const std::string &name) {
+            Level parsed = Level::INFO;
+            if (name == "debug") parsed = Level::DEBUG;
+            else if (name == "warn") parsed = Level::WARN;
+            else if (name == "error") parsed = Level::ERROR;
+            level.store(parsed, std::memory_order_relaxed);
+        }
+
+        // Logger::debug("lookup", {{"zone", mainDomain}, {"rows", rows.size()}});
+        static void debug(const char *message, std::initializer_list<Field> fields = {}) {
+            if constexpr (DEBUG_COMPILED) {
+                log(Level::DEBUG, message, fields);
+            }
+        }
+
+        static void info(const char *message, std::initializer_list<Field> fields = {}) {
+            log(Level::INFO, message, fields);
+        }
+
+        static void warn(const char *message, std::initializer_list<Field> fields = {}) {
+            log(Level::WARN, message, fields);
+        }
+
+        static void error(const char *message, std::initializer_list<Field> fields = {}) {
+            log(Level::ERROR, message, fields);
+        }
+
+        // message must be a string literal (or otherwise outlive the process)
+        static void log(Level recordLevel, const char *message, std::initializer_list<Field> fields) {
+            Logger &logger = getInstance();
+            if (recordLevel < logger.level.load(std::memory_order_relaxed)) {
+                return;
+            }
+            Ring &ring = local();
+            uint32_t head = ring.head.load(std::memory_order_relaxed);
+            if (head - ring.tail.load(std::memory_order_acquire) == RING_SIZE) {
+                Metrics::add(Metrics::LOG_DROPPED);
+                return;
+            }
+
+            Record &record = ring.records[head % RING_SIZE];
+            record.time = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+            record.level = recordLevel;
+            record.message = message;
+            record.fieldCount = 0;
+            for (const Field &field: fields) {
+                if (record.fieldCount == MAX_FIELDS) {
+                    break;
+                }
+                StoredField &stored = record.fields[record.fieldCount++];
+                stored.key = field.key;
+                stored.isNumber = field.isNumber;
+                stored.number = field.number;
+                stored.length = static_cast<uint8_t>(std::min<size_t>(field.text.size(), FIELD_TEXT_SIZE));
+                memcpy(stored.text, field.text.data(), stored.length);
+            }
+            ring.head.store(head + 1, std::memory_order_release);
+        }
+
+    private:
+
+        struct StoredField {
+            const char *key;
+            int64_t number;
+            bool isNumber;
+            uint8_t length;
+            char text[FIELD_TEXT_SIZE];
+        };
+
+        struct Record {
+            int64_t time;
+            const char *message;
+            Level level;
+            uint8_t fieldCount;
+            StoredField fields[MAX_FIELDS];
+        };
+
+        // Single producer (the owning thread), single consumer (the writer thread)
+        struct Ring {
+            alignas(64) std::atomic<uint32_t> head{0};
+            alignas(64) std::atomic<uint32_t> tail{0};
+            Record records[RING_SIZE];
+        };
+
+        // Lends the calling thread a ring for its lifetime
+        struct RingLease {
+            Ring *ring;
+
+            RingLease() : ring(getInstance().acquire()) {}
+
+            ~RingLease() {
+                getInstance().release(ring);
+            }
+        };
+
+        Logger() : level(Level::INFO) {
+            std::thread([this] { writeLoop(); }).detach();
+        }
+
+        static Ring &local() {
+            thread_local RingLease lease;
+            return *lease.ring;
+        }
+
+        Ring *acquire() {
+            std::lock_guard<std::mutex> lock(ringMutex);
+            if (!freeRings.empty()) {
+                Ring *ring = freeRings.back();
+                freeRings.pop_back();
+                return ring;
+            }
+            Ring *ring = new Ring();
+            rings.push_back(ring);
+            return ring;
+        }
+
+        void release(Ring *ring) {
+            std::lock_guard<std::mutex> lock(ringMutex);
+            freeRings.push_back(ring);
+        }
+
+        void writeLoop() {
+            std::string out, err;
+            std::vector<Ring *> snapshot;
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> lock(ringMutex);
+                    snapshot = rings;
+                }
+                for (Ring *ring: snapshot) {
+                    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+                    uint32_t head = ring->head.load(std::memory_order_acquire);
+                    for (; tail != head; tail++) {
+                        const Record &record = ring->records[tail % RING_SIZE];
+                        format(record, record.level >= Level::WARN ? err : out);
+                    }
+                    ring->tail.store(tail, std::memory_order_release);
+                }
+                writeAll(STDOUT_FILENO, out);
+                writeAll(STDERR_FILENO, err);
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+
+        static void format(const Record &record, std::string &line) {
+            static const char *levelNames[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+            time_t seconds = static_cast<time_t>(record.time / 1000000);
+            tm utc{};
+            gmtime_r(&seconds, &utc);
+            char stamp[64];
+            snprintf(stamp, sizeof(stamp), "%04d-%02d-%02dT%02d:%02d:%02d.%06dZ ", utc.tm_year + 1900, utc.tm_mon + 1,
+                     utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec, static_cast<int>(record.time % 1000000));
+            line += stamp;
+            line += levelNames[static_cast<int>(record.level)];
+            line += ' ';
+            line += record.message;
+            for (int i = 0; i < record.fieldCount; i++) {
+                const StoredField &field = record.fields[i];
+                line += ' ';
+                line += field.key;
+                line += '=';
+                if (field.isNumber) {
+                    line += std::to_string(field.number);
+                    continue;
+                }
+                std::string_view text(field.text, field.length);
+                bool quote = text.empty() || text.find_first_of(" \"=") != std::string_view::npos;
+                if (quote) line += '"';
+                line += text;
+                if (quote) line += '"';
+            }
+            line += '\n';
+        }
+
+        static void writeAll(int fd, std::string &data) {
+            size_t written = 0;
+            while (written < data.size()) {
+                ssize_t n = write(fd, data.data() + written, data.size() - written);
+                if (n <= 0) {
+                    break;
+                }
+                written += n;
+            }
+            data.clear();
+        }
+
+        std::atomic<Level> level;
+        std::mutex ringMutex;
+        std::vector<Ring *> rings;
+        std::vector<Ring *> freeRings;
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+    };
+
+}
+
+#endif // LOGGER_H
@@ -0,0 +1,499 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+namespace DNS {
+
+    // Server counters. Every thread writes to its own cache-line aligned block
+    // with a plain relaxed load and store (no locked instruction, no sharing),
+    // and a scrape sums the blocks. Blocks of finished threads are handed to the
+    // next new thread, so totals never go backwards. The sums are exposed in
+    // Prometheus text format over HTTP on a local TCP port or a Unix socket.
+    //
+    // Stage latencies go into log-linear (HDR style) histograms in the same
+    // blocks: 32 sub-buckets per power of two, so any value is within about 3%
+    // of its bucket. A background thread merges them every few seconds and the
+    // quantiles describe that most recent window.
+    class Metrics {
+    public:
+
+        enum Counter : uint8_t {
+            QUERIES_UDP,
+            QUERIES_TLS,
+            QUERIES_TCP,
+            BYTES_IN,
+            BYTES_OUT,
+            RESPONSES_TRUNCATED,
+            DROPS_MALFORMED,
+            DROPS_RATE_LIMITED,
+            FORWARD_CACHE_HITS,
+            FORWARD_CACHE_MISSES,
+            RRSIG_CACHE_HITS,
+            RRSIG_CACHE_MISSES,
+            RECORD_CACHE_HITS,
+            RECORD_CACHE_MISSES,
+            PREFETCHES,
+            PREFETCH_SAVED_MISSES,
+            STALE_ANSWERS,
+            BACKEND_TIMEOUTS,
+            BREAKER_TRIPS,
+            BREAKER_REJECTIONS,
+            DB_QUERIES,
+            DB_ERRORS,
+            DB_LATENCY_MICROSECONDS,
+            LOG_DROPPED,
+            DNSTAP_FRAMES,
+            DNSTAP_DROPPED,
+            AXFR_TRANSFERS,
+            IXFR_TRANSFERS,
+            TRANSFERS_REFUSED,
+            NOTIFY_SENT,
+            NOTIFY_RECEIVED,
+            SECONDARY_INCREMENTAL,
+            SECONDARY_FULL,
+            SECONDARY_FAILURES,
+            COUNTER_COUNT
+        };
+
+        enum Stage : uint8_t {
+            STAGE_RECEIVE,  // kernel receive timestamp to handing the packet over
+            STAGE_PARSE,
+            STAGE_LOOKUP,
+            STAGE_ENCODE,
+            STAGE_SEND,
+            STAGE_COUNT
+        };
+
+        static constexpr int HISTOGRAM_SUB_BITS = 5;
+        static constexpr int HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+        static constexpr int HISTOGRAM_MAX_EXPONENT = 34; // ~17 s in nanoseconds
+        static constexpr int HISTOGRAM_BUCKETS = (HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BITS + 2) * HISTOGRAM_SUB_BUCKETS;
+        static constexpr int MERGE_INTERVAL_SECONDS = 10;
+
+        // Times a scope and records it against a stage
+        class StageTimer {
+        public:
+            explicit StageTimer(Stage stage) : stage(stage), start(std::chrono::steady_clock::now()) {}
+
+            ~StageTimer() {
+                record(stage, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count());
+            }
+
+        private:
+            Stage stage;
+            std::chrono::steady_clock::time_point start;
+        };
+
+        // qtypes 0..255 have their own slot, anything larger shares the last one
+        static constexpr int QTYPE_SLOTS = 257;
+        static constexpr int RCODE_SLOTS = 16;
+
+        static Metrics& getInstance() {
+            static Metrics instance;
+            return instance;
+        }
+
+        static void add(Counter counter, uint64_t amount = 1) {
+            bump(local().counters[counter], amount);
+        }
+
+        static void addQueryType(uint16_t type) {
+            bump(local().queryTypes[type < QTYPE_SLOTS - 1 ? type : QTYPE_SLOTS - 1], 1);
+        }
+
+        static void addResponseCode(uint8_t rcode) {
+            bump(local().responseCodes[rcode & 0x0F], 1);
+        }
+
+        static void record(Stage stage, int64_t nanoseconds) {
+            uint64_t value = nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0;
+            Slot &slot = local();
+            bump(slot.latency[stage][bucketIndex(value)], 1);
+            bump(slot.latencySum[stage], value);
+        }
+
+        static int bucketIndex(uint64_t value) {
+            if (value < HISTOGRAM_SUB_BUCKETS) {
+                return static_cast<int>(value);
+            }
+            int exponent = std::bit_width(value) - 1;
+            if (exponent > HISTOGRAM_MAX_EXPONENT) {
+                return HISTOGRAM_BUCKETS - 1;
+            }
+            int shift = exponent - HISTOGRAM_SUB_BITS;
+            return (shift + 1) * HISTOGRAM_SUB_BUCKETS + static_cast<int>((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+        }
+
+        // Midpoint of a bucket
+        static uint64_t bucketValue(int index) {
+            if (index < HISTOGRAM_SUB_BUCKETS) {
+                return index;
+            }
+            int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+            uint64_t lower = static_cast<uint64_t>(HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS) << shift;
+            return lower + ((uint64_t{1} << shift) >> 1);
+        }
+
+        // Extra exposition lines appended on every scrape (gauges owned by other components)
+        void addCollector(std::function<void(std::ostringstream&)> collector) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            collectors.push_back(std::move(collector));
+        }
+
+        uint64_t total(Counter counter) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            uint64_t sum = 0;
+            for (auto *slot: slots) {
+                sum += slot->counters[counter].load(std::memory_order_relaxed);
+            }
+            return sum;
+        }
+
+        std::string render() {
+            uint64_t counters[COUNTER_COUNT] = {};
+            std::vector<uint64_t> queryTypes(QTYPE_SLOTS, 0);
+            uint64_t responseCodes[RCODE_SLOTS] = {};
+            std::vector<std::function<void(std::ostringstream&)>> extra;
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                for (auto *slot: slots) {
+                    for (int i = 0; i < COUNTER_COUNT; i++) {
+                        counters[i] += slot->counters[i].load(std::memory_order_relaxed);
+                    }
+                    for (int i = 0; i < QTYPE_SLOTS; i++) {
+                        queryTypes[i] += slot->queryTypes[i].load(std::memory_order_relaxed);
+                    }
+                    for (int i = 0; i < RCODE_SLOTS; i++) {
+                        responseCodes[i] += slot->responseCodes[i].load(std::memory_order_relaxed);
+                    }
+                }
+                extra = collectors;
+            }
+
+            std::ostringstream out;
+            out << "# HELP dns_queries_total Queries received.\n# TYPE dns_queries_total counter\n";
+            out << "dns_queries_total{transport=\"udp\"} " << counters[QUERIES_UDP] << '\n';
+            out << "dns_queries_total{transport=\"tls\"} " << counters[QUERIES_TLS] << '\n';
+            out << "dns_queries_total{transport=\"tcp\"} " << counters[QUERIES_TCP] << '\n';
+
+            out << "# HELP dns_queries_by_type_total Questions by query type.\n# TYPE dns_queries_by_type_total counter\n";
+            for (int i = 0; i < QTYPE_SLOTS; i++) {
+                if (queryTypes[i] != 0) {
+                    out << "dns_queries_by_type_total{type=\"" << (i == QTYPE_SLOTS - 1 ? std::string("other") : std::to_string(i))
+                        << "\"} " << queryTypes[i] << '\n';
+                }
+            }
+
+            static const char *rcodeNames[RCODE_SLOTS] = {"NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN", "NOTIMP", "REFUSED",
+                                                          "YXDOMAIN", "YXRRSET", "NXRRSET", "NOTAUTH", "NOTZONE", "11",
+                                                          "12", "13", "14", "15"};
+            out << "# HELP dns_responses_total Responses by rcode.\n# TYPE dns_responses_total counter\n";
+            for (int i = 0; i < RCODE_SLOTS; i++) {
+                if (responseCodes[i] != 0 || i == 0) {
+                    out << "dns_responses_total{rcode=\"" << rcodeNames[i] << "\"} " << responseCodes[i] << '\n';
+                }
+            }
+
+            out << "# HELP dns_responses_truncated_total Responses sent with TC=1.\n# TYPE dns_responses_truncated_total counter\n";
+            out << "dns_responses_truncated_total " << counters[RESPONSES_TRUNCATED] << '\n';
+
+            out << "# HELP dns_drops_total Queries that got no response.\n# TYPE dns_drops_total counter\n";
+            out << "dns_drops_total{reason=\"malformed\"} " << counters[DROPS_MALFORMED] << '\n';
+            out << "dns_drops_total{reason=\"rate_limited\"} " << counters[DROPS_RATE_LIMITED] << '\n';
+
+            out << "# HELP dns_bytes_total Payload bytes by direction.\n# TYPE dns_bytes_total counter\n";
+            out << "dns_bytes_total{direction=\"in\"} " << counters[BYTES_IN] << '\n';
+            out << "dns_bytes_total{direction=\"out\"} " << counters[BYTES_OUT] << '\n';
+
+            out << "# HELP dns_cache_hits_total Cache hits.\n# TYPE dns_cache_hits_total counter\n";
+            out << "dns_cache_hits_total{cache=\"forward\"} " << counters[FORWARD_CACHE_HITS] << '\n';
+            out << "dns_cache_hits_total{cache=\"rrsig\"} " << counters[RRSIG_CACHE_HITS] << '\n';
+            out << "dns_cache_hits_total{cache=\"record\"} " << counters[RECORD_CACHE_HITS] << '\n';
+            out << "# HELP dns_cache_misses_total Cache misses.\n# TYPE dns_cache_misses_total counter\n";
+            out << "dns_cache_misses_total{cache=\"forward\"} " << counters[FORWARD_CACHE_MISSES] << '\n';
+            out << "dns_cache_misses_total{cache=\"rrsig\"} " << counters[RRSIG_CACHE_MISSES] << '\n';
+            out << "dns_cache_misses_total{cache=\"record\"} " << counters[RECORD_CACHE_MISSES] << '\n';
+
+            out << "# HELP dns_prefetches_total Record cache entries refreshed before they expired.\n# TYPE dns_prefetches_total counter\n";
+            out << "dns_prefetches_total " << counters[PREFETCHES] << '\n';
+            out << "# HELP dns_prefetch_saved_misses_total Record cache hits that would have been misses without prefetching.\n# TYPE dns_prefetch_saved_misses_total counter\n";
+            out << "dns_prefetch_saved_misses_total " << counters[PREFETCH_SAVED_MISSES] << '\n';
+            out << "# HELP dns_stale_answers_total Lookups answered from expired records (RFC 8767).\n# TYPE dns_stale_answers_total counter\n";
+            out << "dns_stale_answers_total " << counters[STALE_ANSWERS] << '\n';
+            out << "# HELP dns_backend_timeouts_total Lookups the record store did not answer within the deadline.\n# TYPE dns_backend_timeouts_total counter\n";
+            out << "dns_backend_timeouts_total " << counters[BACKEND_TIMEOUTS] << '\n';
+            out << "# HELP dns_backend_breaker_trips_total Times the record store circuit breaker opened.\n# TYPE dns_backend_breaker_trips_total counter\n";
+            out << "dns_backend_breaker_trips_total " << counters[BREAKER_TRIPS] << '\n';
+            out << "# HELP dns_backend_breaker_rejections_total Lookups not sent to the record store because the breaker was open.\n# TYPE dns_backend_breaker_rejections_total counter\n";
+            out << "dns_backend_breaker_rejections_total " << counters[BREAKER_REJECTIONS] << '\n';
+
+            out << "# HELP dns_db_queries_total Database queries.\n# TYPE dns_db_queries_total counter\n";
+            out << "dns_db_queries_total " << counters[DB_QUERIES] << '\n';
+            out << "# HELP dns_db_errors_total Record store lookups that failed.\n# TYPE dns_db_errors_total counter\n";
+            out << "dns_db_errors_total " << counters[DB_ERRORS] << '\n';
+            out << "# HELP dns_db_latency_seconds_total Time spent waiting for the database.\n# TYPE dns_db_latency_seconds_total counter\n";
+            out << "dns_db_latency_seconds_total " << counters[DB_LATENCY_MICROSECONDS] / 1e6 << '\n';
+
+            out << "# HELP dns_log_dropped_total Log records dropped because a buffer was full.\n# TYPE dns_log_dropped_total counter\n";
+            out << "dns_log_dropped_total " << counters[LOG_DROPPED] << '\n';
+            out << "# HELP dns_dnstap_frames_total dnstap frames written.\n# TYPE dns_dnstap_frames_total counter\n";
+            out << "dns_dnstap_frames_total " << counters[DNSTAP_FRAMES] << '\n';
+            out << "# HELP dns_dnstap_dropped_total dnstap frames lost to full buffers or a failed output.\n# TYPE dns_dnstap_dropped_total counter\n";
+            out << "dns_dnstap_dropped_total " << counters[DNSTAP_DROPPED] << '\n';
+
+            out << "# HELP dns_zone_transfers_total Zone transfers served, by query type.\n# TYPE dns_zone_transfers_total counter\n";
+            out << "dns_zone_transfers_total{type=\"axfr\"} " << counters[AXFR_TRANSFERS] << '\n';
+            out << "dns_zone_transfers_total{type=\"ixfr\"} " << counters[IXFR_TRANSFERS] << '\n';
+            out << "# HELP dns_zone_transfers_refused_total Zone transfers refused to unlisted clients or over the limit.\n# TYPE dns_zone_transfers_refused_total counter\n";
+            out << "dns_zone_transfers_refused_total " << counters[TRANSFERS_REFUSED] << '\n';
+            out << "# HELP dns_notify_total NOTIFY messages sent to secondaries and received from the primary.\n# TYPE dns_notify_total counter\n";
+            out << "dns_notify_total{direction=\"sent\"} " << counters[NOTIFY_SENT] << '\n';
+            out << "dns_notify_total{direction=\"received\"} " << counters[NOTIFY_RECEIVED] << '\n';
+            out << "# HELP dns_secondary_updates_total Zones updated from the primary, by kind of transfer.\n# TYPE dns_secondary_updates_total counter\n";
+            out << "dns_secondary_updates_total{type=\"incremental\"} " << counters[SECONDARY_INCREMENTAL] << '\n';
+            out << "dns_secondary_updates_total{type=\"full\"} " << counters[SECONDARY_FULL] << '\n';
+            out << "# HELP dns_secondary_update_failures_total Transfers from the primary that failed.\n# TYPE dns_secondary_update_failures_total counter\n";
+            out << "dns_secondary_update_failures_total " << counters[SECONDARY_FAILURES] << '\n';
+
+            renderLatency(out);
+
+            for (auto &collector: extra) {
+                collector(out);
+            }
+            return out.str();
+        }
+
+        // "host:port" for HTTP over TCP, or a path for a Unix socket
+        void startServer(const std::string &address) {
+            int fd;
+            if (!address.empty() && address[0] == '/') {
+                fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                sockaddr_un local{};
+                local.sun_family = AF_UNIX;
+                strncpy(local.sun_path, address.c_str(), sizeof(local.sun_path) - 1);
+                unlink(address.c_str());
+                if (fd < 0 || bind(fd, (const struct sockaddr *)&local, sizeof(local)) < 0) {
+                    perror("metrics bind failed");
+                    return;
+                }
+            } else {
+                fd = socket(AF_INET, SOCK_STREAM, 0);
+                int enable = 1;
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+                sockaddr_in local{};
+                local.sin_family = AF_INET;
+                size_t colon = address.rfind(':');
+                std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+                local.sin_port = htons(std::stoi(colon == std::string::npos ? address : address.substr(colon + 1)));
+                if (fd < 0 || inet_pton(AF_INET, host.c_str(), &local.sin_addr) != 1 ||
+                    bind(fd, (const struct sockaddr *)&local, sizeof(local)) < 0) {
+                    perror("metrics bind failed");
+                    return;
+                }
+            }
+            if (listen(fd, 16) < 0) {
+                perror("metrics listen failed");
+                return;
+            }
+            std::thread([this, fd] { serve(fd); }).detach();
+            std::thread([this] { mergeLoop(); }).detach();
+        }
+
+    private:
+
+        struct alignas(64) Slot {
+            std::atomic<uint64_t> counters[COUNTER_COUNT];
+            std::atomic<uint64_t> queryTypes[QTYPE_SLOTS];
+            std::atomic<uint64_t> responseCodes[RCODE_SLOTS];
+            std::atomic<uint64_t> latencySum[STAGE_COUNT];
+            std::atomic<uint64_t> latency[STAGE_COUNT][HISTOGRAM_BUCKETS];
+
+            Slot() {
+                for (auto &counter: counters) counter.store(0, std::memory_order_relaxed);
+                for (auto &counter: queryTypes) counter.store(0, std::memory_order_relaxed);
+                for (auto &counter: responseCodes) counter.store(0, std::memory_order_relaxed);
+                for (auto &counter: latencySum) counter.store(0, std::memory_order_relaxed);
+                for (auto &histogram: latency) {
+                    for (auto &counter: histogram) counter.store(0, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        using Histogram = std::vector<uint64_t>;
+
+        // Lends the calling thread a slot for its lifetime
+        struct SlotLease {
+            Slot *slot;
+
+            SlotLease() : slot(getInstance().acquire()) {}
+
+            ~SlotLease() {
+                getInstance().release(slot);
+            }
+        };
+
+        Metrics() = default;
+
+        static Slot &local() {
+            thread_local SlotLease lease;
+            return *lease.slot;
+        }
+
+        // Only the owning thread writes a slot, so a relaxed load and store is enough.
+        static inline void bump(std::atomic<uint64_t> &counter, uint64_t amount) {
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        Slot *acquire() {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            if (!freeSlots.empty()) {
+                Slot *slot = freeSlots.back();
+                freeSlots.pop_back();
+                return slot;
+            }
+            Slot *slot = new Slot();
+            slots.push_back(slot);
+            return slot;
+        }
+
+        void release(Slot *slot) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            freeSlots.push_back(slot);
+        }
+
+        // Sums every thread's histograms; the difference to the previous merge is
+        // the window the quantiles are computed from.
+        void mergeLoop() {
+            while (true) {
+                std::this_thread::sleep_for(std::chrono::seconds(MERGE_INTERVAL_SECONDS));
+                std::vector<Histogram> totals(STAGE_COUNT, Histogram(HISTOGRAM_BUCKETS, 0));
+                std::lock_guard<std::mutex> lock(registryMutex);
+                for (auto *slot: slots) {
+                    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+                        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                            totals[stage][i] += slot->latency[stage][i].load(std::memory_order_relaxed);
+                        }
+                    }
+                }
+                if (mergedTotals.empty()) {
+                    mergedTotals.assign(STAGE_COUNT, Histogram(HISTOGRAM_BUCKETS, 0));
+                }
+                recentWindow.assign(STAGE_COUNT, Histogram(HISTOGRAM_BUCKETS, 0));
+                for (int stage = 0; stage < STAGE_COUNT; stage++) {
+                    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                        recentWindow[stage][i] = totals[stage][i] - mergedTotals[stage][i];
+                    }
+                }
+                mergedTotals = std::move(totals);
+            }
+        }
+
+        static uint64_t quantile(const Histogram &histogram, uint64_t count, double q) {
+            uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+            uint64_t seen = 0;
+            for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                seen += histogram[i];
+                if (seen >= rank) {
+                    return bucketValue(i);
+                }
+            }
+            return bucketValue(HISTOGRAM_BUCKETS - 1);
+        }
+
+        void renderLatency(std::ostringstream &out) {
+            static const char *stageNames[STAGE_COUNT] = {"receive", "parse", "lookup", "encode", "send"};
+            static const double quantiles[] = {0.5, 0.99, 0.999};
+
+            uint64_t sums[STAGE_COUNT] = {};
+            uint64_t counts[STAGE_COUNT] = {};
+            std::vector<Histogram> window;
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                for (auto *slot: slots) {
+                    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+                        sums[stage] += slot->latencySum[stage].load(std::memory_order_relaxed);
+                        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                            counts[stage] += slot->latency[stage][i].load(std::memory_order_relaxed);
+                        }
+                    }
+                }
+                window = recentWindow;
+            }
+
+            out << "# HELP dns_stage_latency_seconds Time spent per query stage; quantiles cover the last "
+                << MERGE_INTERVAL_SECONDS << "s.\n# TYPE dns_stage_latency_seconds summary\n";
+            for (int stage = 0; stage < STAGE_COUNT; stage++) {
+                if (!window.empty()) {
+                    uint64_t windowCount = 0;
+                    for (uint64_t bucket: window[stage]) {
+                        windowCount += bucket;
+                    }
+                    if (windowCount != 0) {
+                        for (double q: quantiles) {
+                            out << "dns_stage_latency_seconds{stage=\"" << stageNames[stage] << "\",quantile=\"" << q << "\"} "
+                                << quantile(window[stage], windowCount, q) / 1e9 << '\n';
+                        }
+                    }
+                }
+                out << "dns_stage_latency_seconds_sum{stage=\"" << stageNames[stage] << "\"} " << sums[stage] / 1e9 << '\n';
+                out << "dns_stage_latency_seconds_count{stage=\"" << stageNames[stage] << "\"} " << counts[stage] << '\n';
+            }
+        }
+
+        void serve(int fd) {
+            while (true) {
+                int client = accept(fd, nullptr, nullptr);
+                if (client < 0) {
+                    continue;
+                }
+                char request[1024];
+                timeval timeout{2, 0};
+                setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                ssize_t n = recv(client, request, sizeof(request), 0);
+                (void)n;
+                std::string body = render();
+                std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                                       std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+                size_t sent = 0;
+                while (sent < response.size()) {
+                    ssize_t written = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                    if (written <= 0) {
+                        break;
+                    }
+                    sent += written;
+                }
+                close(client);
+            }
+        }
+
+        std::mutex registryMutex;
+        std::vector<Slot *> slots;
+        std::vector<Slot *> freeSlots;
+        std::vector<std::function<void(std::ostringstream&)>> collectors;
+        std::vector<Histogram> mergedTotals;
+        std::vector<Histogram> recentWindow;
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+    };
+
+}
+
+#endif // METRICS_H
@@ -0,0 +1,726 @@
+#include "rdata.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+#include <arpa/inet.h>
+
+
+namespace {
+
+    using DNS::DnsEnum;
+    using Field = DNS::RRTypes::Field;
+    using Token = DNS::RData::Token;
+    using Wire = std::vector<uint8_t>;
+
+    // Decodes the character at text[i] (advancing i past \X and \DDD escapes)
+    uint8_t unescape(std::string_view text, size_t &i) {
+        if (text[i] != '\\' || i + 1 >= text.size()) {
+            return text[i];
+        }
+        if (i + 3 < text.size() && std::isdigit(static_cast<unsigned char>(text[i + 1])) &&
+            std::isdigit(static_cast<unsigned char>(text[i + 2])) && std::isdigit(static_cast<unsigned char>(text[i + 3]))) {
+            int value = (text[i + 1] - '0') * 100 + (text[i + 2] - '0') * 10 + (text[i + 3] - '0');
+            if (value > 255) {
+                throw DNS::RData::Error("bad escape in '" + std::string(text) + "'");
+            }
+            i += 3;
+            return static_cast<uint8_t>(value);
+        }
+        return text[++i];
+    }
+
+    void addUint16(Wire &out, uint32_t value) {
+        out.push_back(value >> 8);
+        out.push_back(value & 0xFF);
+    }
+
+    void addUint32(Wire &out, uint32_t value) {
+        addUint16(out, value >> 16);
+        addUint16(out, value & 0xFFFF);
+    }
+
+    // DNSSEC algorithm field: a number or one of the common mnemonics
+    uint8_t algorithmNumber(const Token &token) {
+        static constexpr std::pair<std::string_view, uint8_t> algorithms[] = {
+            {"RSAMD5", 1}, {"DSA", 3}, {"RSASHA1", 5}, {"RSASHA256", 8}, {"RSASHA512", 10},
+            {"ECDSAP256SHA256", 13}, {"ECDSAP384SHA384", 14}, {"ED25519", 15}, {"ED448", 16}};
+        for (const auto &[mnemonic, code]: algorithms) {
+            if (DNS::RRTypes::equalsIgnoreCase(token.text, mnemonic)) {
+                return code;
+            }
+        }
+        return DNS::RData::number(token.text, 0xFF, "algorithm");
+    }
+
+    uint16_t certType(const Token &token) {
+        static constexpr std::pair<std::string_view, uint16_t> certTypes[] = {
+            {"PKIX", 1}, {"SPKI", 2}, {"PGP", 3}, {"IPKIX", 4}, {"ISPKI", 5}, {"IPGP", 6},
+            {"ACPKIX", 7}, {"IACPKIX", 8}, {"URI", 253}, {"OID", 254}};
+        for (const auto &[mnemonic, code]: certTypes) {
+            if (DNS::RRTypes::equalsIgnoreCase(token.text, mnemonic)) {
+                return code;
+            }
+        }
+        return DNS::RData::number(token.text, 0xFFFF, "certificate type");
+    }
+
+    uint16_t typeField(const Token &token) {
+        auto type = DNS::RRTypes::typeCode(token.text);
+        if (!type) {
+            throw DNS::RData::Error("unknown type '" + std::string(token.text) + "'");
+        }
+        return *type;
+    }
+
+    void addCharacterString(Wire &out, const Token &token) {
+        size_t lengthAt = out.size();
+        out.push_back(0);
+        for (size_t i = 0; i < token.text.size(); i++) {
+            if (out.size() - lengthAt > 255) {
+                throw DNS::RData::Error("character string longer than 255 bytes");
+            }
+            out.push_back(unescape(token.text, i));
+        }
+        if (out.size() - lengthAt > 256) {
+            throw DNS::RData::Error("character string longer than 255 bytes");
+        }
+        out[lengthAt] = static_cast<uint8_t>(out.size() - lengthAt - 1);
+    }
+
+    void addBytes(Wire &out, const Token &token) {
+        for (size_t i = 0; i < token.text.size(); i++) {
+            out.push_back(unescape(token.text, i));
+        }
+    }
+
+    // Hex digits spread over the remaining tokens
+    void addHex(Wire &out, const Token *tokens, size_t count) {
+        int high = -1;
+        for (size_t t = 0; t < count; t++) {
+            for (char c: tokens[t].text) {
+                int value;
+                char lower = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                if (c >= '0' && c <= '9') {
+                    value = c - '0';
+                } else if (lower >= 'a' && lower <= 'f') {
+                    value = lower - 'a' + 10;
+                } else {
+                    throw DNS::RData::Error("bad hex digit in '" + std::string(tokens[t].text) + "'");
+                }
+                if (high < 0) {
+                    high = value;
+                } else {
+                    out.push_back(static_cast<uint8_t>(high << 4 | value));
+                    high = -1;
+                }
+            }
+        }
+        if (high >= 0) {
+            throw DNS::RData::Error("odd number of hex digits");
+        }
+    }
+
+    // Base64 spread over the remaining tokens
+    void addBase64(Wire &out, const Token *tokens, size_t count) {
+        uint32_t bits = 0;
+        int bitCount = 0;
+        for (size_t t = 0; t < count; t++) {
+            for (char c: tokens[t].text) {
+                int value;
+                if (c >= 'A' && c <= 'Z') {
+                    value = c - 'A';
+                } else if (c >= 'a' && c <= 'z') {
+                    value = c - 'a' + 26;
+                } else if (c >= '0' && c <= '9') {
+                    value = c - '0' + 52;
+                } else if (c == '+') {
+                    value = 62;
+                } else if (c == '/') {
+                    value = 63;
+                } else if (c == '=') {
+                    continue;
+                } else {
+                    throw DNS::RData::Error("bad base64 in '" + std::string(tokens[t].text) + "'");
+                }
+                bits = (bits << 6) | value;
+                bitCount += 6;
+                if (bitCount >= 8) {
+                    bitCount -= 8;
+                    out.push_back(static_cast<uint8_t>(bits >> bitCount));
+                }
+            }
+        }
+    }
+
+    // RRSIG times: YYYYMMDDHHmmSS or seconds since the epoch
+    uint32_t signatureTime(const Token &token) {
+        if (token.text.size() != 14) {
+            return DNS::RData::number(token.text, 0xFFFFFFFF, "signature time");
+        }
+        std::string digits(token.text);
+        DNS::RData::number(token.text, 99999999999999, "signature time");
+        tm time{};
+        time.tm_year = std::stoi(digits.substr(0, 4)) - 1900;
+        time.tm_mon = std::stoi(digits.substr(4, 2)) - 1;
+        time.tm_mday = std::stoi(digits.substr(6, 2));
+        time.tm_hour = std::stoi(digits.substr(8, 2));
+        time.tm_min = std::stoi(digits.substr(10, 2));
+        time.tm_sec = std::stoi(digits.substr(12, 2));
+        return static_cast<uint32_t>(timegm(&time));
+    }
+
+    // NSEC type bitmap (RFC 4034 section 4.1.2)
+    void addTypeBitmap(Wire &out, const Token *tokens, size_t count) {
+        std::vector<uint16_t> types;
+        for (size_t t = 0; t < count; t++) {
+            types.push_back(typeField(tokens[t]));
+        }
+        std::sort(types.begin(), types.end());
+        types.erase(std::unique(types.begin(), types.end()), types.end());
+        for (size_t i = 0; i < types.size();) {
+            uint8_t window = types[i] >> 8;
+            uint8_t bitmap[32] = {};
+            size_t length = 0;
+            for (; i < types.size() && (types[i] >> 8) == window; i++) {
+                uint8_t low = types[i] & 0xFF;
+                bitmap[low / 8] |= 0x80 >> (low % 8);
+                length = low / 8 + 1;
+            }
+            out.push_back(window);
+            out.push_back(static_cast<uint8_t>(length));
+            out.insert(out.end(), bitmap, bitmap + length);
+        }
+    }
+
+    // One field that takes a single token
+    void addField(Wire &out, Field field, const Token &token, const Wire &origin) {
+        switch (field) {
+            case Field::IPV4:
+            case Field::IPV6: {
+                uint8_t address[16];
+                int family = field == Field::IPV4 ? AF_INET : AF_INET6;
+                if (inet_pton(family, std::string(token.text).c_str(), address) != 1) {
+                    throw DNS::RData::Error(std::string(field == Field::IPV4 ? "bad IPv4" : "bad IPv6") +
+                                            " address '" + std::string(token.text) + "'");
+                }
+                out.insert(out.end(), address, address + (field == Field::IPV4 ? 4 : 16));
+                break;
+            }
+            case Field::NAME:
+                DNS::RData::appendName(out, token.text, origin);
+                break;
+            case Field::U8:
+                out.push_back(DNS::RData::number(token.text, 0xFF, "number"));
+                break;
+            case Field::U16:
+                addUint16(out, DNS::RData::number(token.text, 0xFFFF, "number"));
+                break;
+            case Field::U32:
+                addUint32(out, DNS::RData::number(token.text, 0xFFFFFFFF, "number"));
+                break;
+            case Field::PERIOD: {
+                auto value = DNS::RData::period(token.text);
+                if (!value) {
+                    throw DNS::RData::Error("bad time period '" + std::string(token.text) + "'");
+                }
+                addUint32(out, *value);
+                break;
+            }
+            case Field::TIME:
+                addUint32(out, signatureTime(token));
+                break;
+            case Field::ALGORITHM:
+                out.push_back(algorithmNumber(token));
+                break;
+            case Field::TYPE:
+                addUint16(out, typeField(token));
+                break;
+            case Field::CERT_TYPE:
+                addUint16(out, certType(token));
+                break;
+            case Field::STRING:
+                addCharacterString(out, token);
+                break;
+            case Field::BYTES:
+                addBytes(out, token);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // One line of text split like a zone file entry: on blanks, with quoted
+    // strings kept together and escapes left for the field encoders
+    std::vector<Token> tokenize(std::string_view text) {
+        std::vector<Token> tokens;
+        size_t i = 0;
+        while (i < text.size()) {
+            if (std::isspace(static_cast<unsigned char>(text[i]))) {
+                i++;
+                continue;
+            }
+            bool quoted = text[i] == '"';
+            size_t start = quoted ? ++i : i;
+            while (i < text.size() && (quoted ? text[i] != '"' : !std::isspace(static_cast<unsigned char>(text[i])))) {
+                i += text[i] == '\\' && i + 1 < text.size() ? 2 : 1;
+            }
+            if (quoted && i >= text.size()) {
+                throw DNS::RData::Error("unterminated quoted string");
+            }
+            tokens.push_back({text.substr(start, i - start), quoted});
+            i += quoted ? 1 : 0;
+        }
+        return tokens;
+    }
+
+    // Bounds-checked view of rdata inside a message, for decoding
+    struct Reader {
+        const uint8_t *message;
+        size_t messageSize;
+        size_t pos;
+        size_t end;
+        bool lowercaseNames;
+
+        void need(size_t count) const {
+            if (end - pos < count) {
+                throw DNS::RData::Error("truncated rdata");
+            }
+        }
+
+        uint32_t u8() {
+            need(1);
+            return message[pos++];
+        }
+
+        uint32_t u16() {
+            uint32_t high = u8();
+            return high << 8 | u8();
+        }
+
+        uint32_t u32() {
+            uint32_t high = u16();
+            return high << 16 | u16();
+        }
+
+        // A name, following compression pointers into the rest of the message
+        void name(std::string &out) {
+            size_t at = pos;
+            bool jumped = false;
+            size_t length = 0;
+            for (int hops = 0;; hops++) {
+                if (at >= (jumped ? messageSize : end)) {
+                    throw DNS::RData::Error("truncated name in rdata");
+                }
+                uint8_t label = message[at];
+                if ((label & 0xC0) == 0xC0) {
+                    if (at + 1 >= (jumped ? messageSize : end) || hops > 127) {
+                        throw DNS::RData::Error("bad compression pointer in rdata");
+                    }
+                    if (!jumped) {
+                        pos = at + 2;
+                        jumped = true;
+                    }
+                    at = (label & 0x3F) << 8 | message[at + 1];
+                    continue;
+                }
+                if (label > 63 || at + label >= (jumped ? messageSize : end)) {
+                    throw DNS::RData::Error("bad label in rdata");
+                }
+                if (label == 0) {
+                    if (!jumped) {
+                        pos = at + 1;
+                    }
+                    if (length == 0) {
+                        out.push_back('.');
+                    }
+                    return;
+                }
+                length += label + 1;
+                if (length > 255) {
+                    throw DNS::RData::Error("name longer than 255 bytes in rdata");
+                }
+                for (size_t i = at + 1; i <= at + label; i++) {
+                    char c = static_cast<char>(message[i]);
+                    escapeInto(out, lowercaseNames ? static_cast<char>(std::tolower(static_cast<unsigned char>(c))) : c,
+                               true);
+                }
+                out.push_back('.');
+                at += label + 1;
+            }
+        }
+
+        // Characters that would not survive being read back as a token (special:
+        // also blanks and dots, for names)
+        static void escapeInto(std::string &out, char c, bool special) {
+            auto byte = static_cast<unsigned char>(c);
+            if (byte < 0x20 || byte > 0x7E) {
+                char digits[5];
+                snprintf(digits, sizeof(digits), "\\%03u", byte);
+                out += digits;
+                return;
+            }
+            if (c == '\\' || c == '"' || (special && (c == '.' || c == ';' || c == ' '))) {
+                out.push_back('\\');
+            }
+            out.push_back(c);
+        }
+
+        void quoted(std::string &out, size_t length) {
+            need(length);
+            out.push_back('"');
+            for (size_t i = 0; i < length; i++) {
+                char c = static_cast<char>(message[pos++]);
+                escapeInto(out, c, false);
+            }
+            out.push_back('"');
+        }
+
+        void characterString(std::string &out) {
+            quoted(out, u8());
+        }
+    };
+
+    void typeText(std::string &out, uint16_t type) {
+        std::string_view mnemonic = DNS::RRTypes::mnemonic(type);
+        out += mnemonic.empty() ? "TYPE" + std::to_string(type) : std::string(mnemonic);
+    }
+
+    void hexText(std::string &out, const uint8_t *data, size_t length) {
+        static constexpr char digits[] = "0123456789ABCDEF";
+        for (size_t i = 0; i < length; i++) {
+            out.push_back(digits[data[i] >> 4]);
+            out.push_back(digits[data[i] & 0x0F]);
+        }
+    }
+
+    void base64Text(std::string &out, const uint8_t *data, size_t length) {
+        static constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (size_t i = 0; i < length; i += 3) {
+            uint32_t bits = data[i] << 16 | (i + 1 < length ? data[i + 1] << 8 : 0) | (i + 2 < length ? data[i + 2] : 0);
+            out.push_back(alphabet[bits >> 18 & 0x3F]);
+            out.push_back(alphabet[bits >> 12 & 0x3F]);
+            out.push_back(i + 1 < length ? alphabet[bits >> 6 & 0x3F] : '=');
+            out.push_back(i + 2 < length ? alphabet[bits & 0x3F] : '=');
+        }
+    }
+
+    void signatureTimeText(std::string &out, uint32_t seconds) {
+        time_t value = seconds;
+        tm time{};
+        gmtime_r(&value, &time);
+        char text[16];
+        strftime(text, sizeof(text), "%Y%m%d%H%M%S", &time);
+        out += text;
+    }
+
+    void fieldText(std::string &out, Field field, Reader &reader) {
+        const uint8_t *rest = reader.message + reader.pos;
+        size_t remaining = reader.end - reader.pos;
+        switch (field) {
+            case Field::IPV4:
+            case Field::IPV6: {
+                size_t size = field == Field::IPV4 ? 4 : 16;
+                reader.need(size);
+                char text[INET6_ADDRSTRLEN];
+                inet_ntop(field == Field::IPV4 ? AF_INET : AF_INET6, rest, text, sizeof(text));
+                out += text;
+                reader.pos += size;
+                break;
+            }
+            case Field::NAME:
+                reader.name(out);
+                break;
+            case Field::U8:
+            case Field::ALGORITHM:
+                out += std::to_string(reader.u8());
+                break;
+            case Field::U16:
+            case Field::CERT_TYPE:
+                out += std::to_string(reader.u16());
+                break;
+            case Field::U32:
+            case Field::PERIOD:
+                out += std::to_string(reader.u32());
+                break;
+            case Field::TIME:
+                signatureTimeText(out, reader.u32());
+                break;
+            case Field::TYPE:
+                typeText(out, reader.u16());
+                break;
+            case Field::STRING:
+                reader.characterString(out);
+                break;
+            case Field::BYTES:
+                reader.quoted(out, remaining);
+                break;
+            case Field::STRINGS:
+                reader.need(1);
+                while (reader.pos < reader.end) {
+                    if (reader.message + reader.pos != rest) {
+                        out.push_back(' ');
+                    }
+                    reader.characterString(out);
+                }
+                break;
+            case Field::HEX:
+                hexText(out, rest, remaining);
+                reader.pos = reader.end;
+                break;
+            case Field::BASE64:
+                base64Text(out, rest, remaining);
+                reader.pos = reader.end;
+                break;
+            case Field::TYPE_BITMAP: {
+                bool first = true;
+                while (reader.pos < reader.end) {
+                    uint32_t window = reader.u8();
+                    uint32_t length = reader.u8();
+                    if (length == 0 || length > 32) {
+                        throw DNS::RData::Error("bad type bitmap in rdata");
+                    }
+                    reader.need(length);
+                    for (uint32_t i = 0; i < length * 8; i++) {
+                        if (reader.message[reader.pos + i / 8] & (0x80 >> (i % 8))) {
+                            out += first ? "" : " ";
+                            typeText(out, static_cast<uint16_t>(window << 8 | i));
+                            first = false;
+                        }
+                    }
+                    reader.pos += length;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+}
+
+std::vector<uint8_t> DNS::RData::encode(uint16_t type, const Token *tokens, size_t count,
+                                        const std::vector<uint8_t> &origin) {
+    Wire out;
+
+    // RFC 3597 generic form, valid for every type: \# length hex
+    if (count > 0 && !tokens[0].quoted && tokens[0].text == "\\#") {
+        if (count < 2) {
+            throw Error("missing length in \\# rdata");
+        }
+        uint32_t length = number(tokens[1].text, 0xFFFF, "rdata length");
+        addHex(out, tokens + 2, count - 2);
+        if (out.size() != length) {
+            throw Error("\\# rdata length does not match its data");
+        }
+        return out;
+    }
+
+    const RRTypes::TypeInfo *info = RRTypes::find(type);
+    if (info == nullptr || info->meta) {
+        throw Error("type " + std::to_string(type) + " needs the generic \\# rdata form");
+    }
+
+    size_t used = 0;
+    for (Field field: info->fields) {
+        if (field == Field::END) {
+            break;
+        }
+        const Token *rest = tokens + used;
+        size_t remaining = count - used;
+        switch (field) {
+            case Field::STRINGS:
+            case Field::HEX:
+            case Field::BASE64:
+                if (remaining == 0) {
+                    throw Error("missing rdata fields");
+                }
+                if (field == Field::STRINGS) {
+                    for (size_t i = 0; i < remaining; i++) {
+                        addCharacterString(out, rest[i]);
+                    }
+                } else if (field == Field::HEX) {
+                    addHex(out, rest, remaining);
+                } else {
+                    addBase64(out, rest, remaining);
+                }
+                used = count;
+                break;
+            case Field::TYPE_BITMAP:
+                addTypeBitmap(out, rest, remaining);
+                used = count;
+                break;
+            default:
+                if (remaining == 0) {
+                    throw Error("missing rdata fields");
+                }
+                addField(out, field, *rest, origin);
+                used++;
+                break;
+        }
+    }
+    if (used < count) {
+        throw Error("trailing rdata fields");
+    }
+    if (out.size() > 0xFFFF) {
+        throw Error("rdata longer than 65535 bytes");
+    }
+    return out;
+}
+
+std::vector<uint8_t> DNS::RData::encode(DnsEnum::QueryType type, std::string_view text) {
+    static const Wire root{0};
+    std::vector<Token> tokens;
+    if (type == DnsEnum::QueryType::TXT && !text.empty() && text.front() != '"') {
+        // Plain text: one string, split into 255-byte pieces if it is longer
+        Wire out;
+        for (size_t i = 0; i < text.size() || i == 0; i += 255) {
+            std::string_view piece = text.substr(i, 255);
+            out.push_back(static_cast<uint8_t>(piece.size()));
+            out.insert(out.end(), piece.begin(), piece.end());
+        }
+        return out;
+    }
+    tokens = tokenize(text);
+    if (type == DnsEnum::QueryType::MX && tokens.size() == 1) {
+        tokens.insert(tokens.begin(), Token{"10"});
+    }
+    return encode(static_cast<uint16_t>(type), tokens.data(), tokens.size(), root);
+}
+
+std::string DNS::RData::toText(uint16_t type, const uint8_t *message, size_t messageSize, size_t offset,
+                               size_t length, bool lowercaseNames) {
+    if (offset > messageSize || length > messageSize - offset) {
+        throw Error("truncated rdata");
+    }
+    std::string out;
+    const RRTypes::TypeInfo *info = RRTypes::find(type);
+    if (info == nullptr || info->meta) {
+        // RFC 3597 generic form for types without a row
+        out = "\\# " + std::to_string(length);
+        if (length > 0) {
+            out.push_back(' ');
+            hexText(out, message + offset, length);
+        }
+        return out;
+    }
+
+    Reader reader{message, messageSize, offset, offset + length, lowercaseNames};
+    for (Field field: info->fields) {
+        if (field == Field::END) {
+            break;
+        }
+        if (!out.empty()) {
+            out.push_back(' ');
+        }
+        fieldText(out, field, reader);
+    }
+    if (reader.pos != reader.end) {
+        throw Error("trailing data in rdata");
+    }
+    return out;
+}
+
+void DNS::RData::appendName(std::vector<uint8_t> &out, std::string_view text, const std::vector<uint8_t> &origin) {
+    if (text == "@") {
+        out.insert(out.end(), origin.begin(), origin.end());
+        return;
+    }
+    size_t start = out.size();
+    size_t lengthAt = out.size();
+    out.push_back(0);
+    bool absolute = false;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '.') {
+            if (out[lengthAt] == 0) {
+                if (text.size() != 1) {
+                    throw Error("empty label in '" + std::string(text) + "'");
+                }
+                absolute = true; // the root itself
+                break;
+            }
+            if (i + 1 == text.size()) {
+                out.push_back(0);
+                absolute = true;
+                break;
+            }
+            lengthAt = out.size();
+            out.push_back(0);
+            continue;
+        }
+        uint8_t c = unescape(text, i);
+        if (out[lengthAt] == 63) {
+            throw Error("label longer than 63 bytes in '" + std::string(text) + "'");
+        }
+        out.push_back(std::tolower(c));
+        out[lengthAt]++;
+    }
+    if (!absolute) {
+        if (out[lengthAt] == 0) {
+            throw Error("empty name");
+        }
+        out.insert(out.end(), origin.begin(), origin.end());
+    }
+    if (out.size() - start > 255) {
+        throw Error("name longer than 255 bytes");
+    }
+}
+
+std::string DNS::RData::nameText(const std::vector<uint8_t> &name) {
+    std::string text;
+    for (size_t pos = 0; pos < name.size() && name[pos] != 0; pos += name[pos] + 1) {
+        if (!text.empty()) {
+            text.push_back('.');
+        }
+        text.append(reinterpret_cast<const char *>(&name[pos + 1]), name[pos]);
+    }
+    return text;
+}
+
+uint32_t DNS::RData::number(std::string_view text, uint64_t max, const char *what) {
+    uint64_t value = 0;
+    if (text.empty()) {
+        throw Error(std::string("missing ") + what);
+    }
+    for (char c: text) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) {
+            throw Error(std::string("bad ") + what + " '" + std::string(text) + "'");
+        }
+        value = value * 10 + (c - '0');
+        if (value > max) {
+            throw Error(std::string(what) + " out of range '" + std::string(text) + "'");
+        }
+    }
+    return static_cast<uint32_t>(value);
+}
+
+std::optional<uint32_t> DNS::RData::period(std::string_view text) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return std::nullopt;
+    }
+    uint64_t total = 0, current = 0;
+    for (char c: text) {
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            current = current * 10 + (c - '0');
+        } else {
+            uint64_t unit;
+            switch (std::tolower(static_cast<unsigned char>(c))) {
+                case 's': unit = 1; break;
+                case 'm': unit = 60; break;
+                case 'h': unit = 3600; break;
+                case 'd': unit = 86400; break;
+                case 'w': unit = 604800; break;
+                default: return std::nullopt;
+            }
+            total += current * unit;
+            current = 0;
+        }
+        if (total + current > 0xFFFFFFFF) {
+            return std::nullopt;
+        }
+    }
+    // RFC 2181 limits TTLs to 2^31 - 1
+    return static_cast<uint32_t>(std::min<uint64_t>(total + current, 0x7FFFFFFF));
+}
@@ -0,0 +1,68 @@
+#ifndef RDATA_H
+#define RDATA_H
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dnsEnum.h"
+#include "rrTypes.h"
+
+namespace DNS {
+
+    // Rdata between presentation and wire format. Both directions walk the
+    // field list of the type's row in RRTypes::TYPES, so supporting a type
+    // means adding its row. Records are encoded once, when they are loaded;
+    // answers are then written from the ready wire bytes.
+    class RData {
+    public:
+        struct Error : std::invalid_argument {
+            using std::invalid_argument::invalid_argument;
+        };
+
+        struct Token {
+            std::string_view text;
+            bool quoted = false;
+        };
+
+        // Encodes the rdata fields of one zone file entry; names that do not end
+        // in a dot are relative to origin (wire format). The RFC 3597 generic
+        // "\# length hex" form is accepted for every type.
+        static std::vector<uint8_t> encode(uint16_t type, const Token *tokens, size_t count,
+                                           const std::vector<uint8_t> &origin);
+
+        // Encodes a value stored on one line (database row, records file). Names
+        // are absolute, with or without the trailing dot. An unquoted TXT value
+        // is a single string, and an MX value without a preference gets 10, as
+        // such rows were written before MX carried one.
+        static std::vector<uint8_t> encode(DnsEnum::QueryType type, std::string_view text);
+
+        // Presentation text of wire rdata, which sits at offset in message; names
+        // in it may be compressed against the message. Throws Error when the
+        // data does not fit the type's layout, so it doubles as validation.
+        static std::string toText(uint16_t type, const uint8_t *message, size_t messageSize, size_t offset,
+                                  size_t length, bool lowercaseNames = false);
+
+        static std::string toText(uint16_t type, const std::vector<uint8_t> &rdata) {
+            return toText(type, rdata.data(), rdata.size(), 0, rdata.size());
+        }
+
+        // Appends text as a lowercased wire-format name; relative names get
+        // origin appended
+        static void appendName(std::vector<uint8_t> &out, std::string_view text, const std::vector<uint8_t> &origin);
+
+        // Wire-format name to dotted text without the trailing dot ("" for the root)
+        static std::string nameText(const std::vector<uint8_t> &name);
+
+        static uint32_t number(std::string_view text, uint64_t max, const char *what);
+
+        // "3600", or with units as in "1h30m"; nothing if text is not a period
+        static std::optional<uint32_t> period(std::string_view text);
+    };
+
+}
+
+#endif // RDATA_H
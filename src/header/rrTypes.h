@@ -0,0 +1,242 @@
+#ifndef RRTYPES_H
+#define RRTYPES_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "dnsEnum.h"
+
+namespace DNS {
+
+    // Everything the server knows about record types and classes, as constant
+    // tables the compiler turns into lookup structures: a dense array indexed
+    // by type code, and perfect hashes from mnemonics ("MX", "in") to codes.
+    // Supporting a new type is one row in TYPES, with its rdata fields, plus
+    // its QueryType value; nothing is looked up by comparing strings in turn.
+    namespace RRTypes {
+
+        // Building blocks of rdata, in wire order
+        enum class Field : uint8_t {
+            END,
+            IPV4,
+            IPV6,
+            NAME,           // uncompressed domain name
+            U8,
+            U16,
+            U32,
+            PERIOD,         // 32-bit interval, units allowed ("1h30m")
+            TIME,           // RRSIG time, YYYYMMDDHHmmSS or seconds since the epoch
+            ALGORITHM,      // DNSSEC algorithm, number or mnemonic
+            TYPE,           // type mnemonic
+            CERT_TYPE,      // CERT type, number or mnemonic
+            STRING,         // one <character-string>
+            BYTES,          // one token as raw bytes, without a length (CAA value)
+            // The fields below take all remaining data and must come last
+            STRINGS,        // one or more <character-string>s
+            HEX,
+            BASE64,
+            TYPE_BITMAP     // NSEC type list
+        };
+
+        constexpr size_t MAX_FIELDS = 9;
+
+        struct TypeInfo {
+            DnsEnum::QueryType type;
+            std::string_view mnemonic;
+            Field fields[MAX_FIELDS];
+            bool meta = false;      // only valid in questions, has no rdata of its own
+        };
+
+        struct ClassInfo {
+            DnsEnum::QueryClass queryClass;
+            std::string_view mnemonic;
+        };
+
+        using enum Field;
+        using Type = DnsEnum::QueryType;
+
+        inline constexpr TypeInfo TYPES[] = {
+            {Type::A, "A", {IPV4}},
+            {Type::NS, "NS", {NAME}},
+            {Type::CNAME, "CNAME", {NAME}},
+            {Type::SOA, "SOA", {NAME, NAME, U32, PERIOD, PERIOD, PERIOD, PERIOD}},
+            {Type::PTR, "PTR", {NAME}},
+            {Type::MX, "MX", {U16, NAME}},
+            {Type::TXT, "TXT", {STRINGS}},
+            {Type::AAAA, "AAAA", {IPV6}},
+            {Type::SRV, "SRV", {U16, U16, U16, NAME}},
+            {Type::NAPTR, "NAPTR", {U16, U16, STRING, STRING, STRING, NAME}},
+            {Type::CERT, "CERT", {CERT_TYPE, U16, ALGORITHM, BASE64}},
+            {Type::DNAME, "DNAME", {NAME}},
+            {Type::OPT, "OPT", {}, true},
+            {Type::DS, "DS", {U16, ALGORITHM, U8, HEX}},
+            {Type::RRSIG, "RRSIG", {TYPE, ALGORITHM, U8, U32, TIME, TIME, U16, NAME, BASE64}},
+            {Type::NSEC, "NSEC", {NAME, TYPE_BITMAP}},
+            {Type::DNSKEY, "DNSKEY", {U16, U8, ALGORITHM, BASE64}},
+            {Type::ANY, "ANY", {}, true},
+            {Type::CAA, "CAA", {U8, STRING, BYTES}},
+        };
+
+        inline constexpr ClassInfo CLASSES[] = {
+            {DnsEnum::QueryClass::IN, "IN"},
+            {DnsEnum::QueryClass::CS, "CS"},
+            {DnsEnum::QueryClass::CH, "CH"},
+            {DnsEnum::QueryClass::HS, "HS"},
+            {DnsEnum::QueryClass::NONE, "NONE"},
+            {DnsEnum::QueryClass::ANY, "ANY"},
+        };
+
+        static_assert([] {
+            for (const auto &info: TYPES) {
+                for (size_t i = 0; i + 1 < MAX_FIELDS; i++) {
+                    if (info.fields[i] >= STRINGS && info.fields[i + 1] != END) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }(), "a field that takes the remaining data must be the last one");
+
+        // Dense index by type code, -1 where there is no row
+
+        inline constexpr size_t TYPE_CODES = [] {
+            size_t highest = 0;
+            for (const auto &info: TYPES) {
+                highest = std::max<size_t>(highest, static_cast<uint16_t>(info.type));
+            }
+            return highest + 1;
+        }();
+
+        inline constexpr auto TYPE_INDEX = [] {
+            static_assert(std::size(TYPES) < 128);
+            std::array<int8_t, TYPE_CODES> index{};
+            index.fill(-1);
+            for (size_t i = 0; i < std::size(TYPES); i++) {
+                index[static_cast<uint16_t>(TYPES[i].type)] = static_cast<int8_t>(i);
+            }
+            return index;
+        }();
+
+        constexpr const TypeInfo *find(uint16_t code) {
+            return code < TYPE_CODES && TYPE_INDEX[code] >= 0 ? &TYPES[TYPE_INDEX[code]] : nullptr;
+        }
+
+        // Perfect hashes over the mnemonics: the seed is searched for at compile
+        // time so that every mnemonic gets a slot of its own, and a lookup is one
+        // hash and one comparison
+
+        constexpr char upper(char c) {
+            return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c;
+        }
+
+        constexpr uint32_t mnemonicHash(std::string_view text, uint32_t seed) {
+            uint32_t hash = seed;
+            for (char c: text) {
+                hash = (hash ^ static_cast<uint8_t>(upper(c))) * 16777619u;
+            }
+            return hash ^ (hash >> 15);
+        }
+
+        constexpr bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+            if (a.size() != b.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < a.size(); i++) {
+                if (upper(a[i]) != upper(b[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        template<size_t SLOTS>
+        struct PerfectHash {
+            uint32_t seed = 0;
+            std::array<int8_t, SLOTS> slots{};
+
+            template<typename Row, size_t N>
+            static constexpr PerfectHash build(const Row (&rows)[N]) {
+                static_assert((SLOTS & (SLOTS - 1)) == 0 && SLOTS >= N);
+                for (uint32_t seed = 2166136261u;; seed++) {
+                    PerfectHash hash{seed, {}};
+                    hash.slots.fill(-1);
+                    bool collision = false;
+                    for (size_t i = 0; i < N && !collision; i++) {
+                        int8_t &slot = hash.slots[mnemonicHash(rows[i].mnemonic, seed) & (SLOTS - 1)];
+                        collision = slot >= 0;
+                        slot = static_cast<int8_t>(i);
+                    }
+                    if (!collision) {
+                        return hash;
+                    }
+                }
+            }
+
+            template<typename Row, size_t N>
+            constexpr const Row *find(const Row (&rows)[N], std::string_view mnemonic) const {
+                int8_t slot = slots[mnemonicHash(mnemonic, seed) & (SLOTS - 1)];
+                return slot >= 0 && equalsIgnoreCase(rows[slot].mnemonic, mnemonic) ? &rows[slot] : nullptr;
+            }
+        };
+
+        inline constexpr auto TYPE_HASH = PerfectHash<64>::build(TYPES);
+        inline constexpr auto CLASS_HASH = PerfectHash<16>::build(CLASSES);
+
+        // "MX", any case, to its type; nothing for unknown mnemonics
+        constexpr std::optional<DnsEnum::QueryType> fromMnemonic(std::string_view mnemonic) {
+            const TypeInfo *info = TYPE_HASH.find(TYPES, mnemonic);
+            return info != nullptr ? std::optional(info->type) : std::nullopt;
+        }
+
+        constexpr std::optional<DnsEnum::QueryClass> classFromMnemonic(std::string_view mnemonic) {
+            const ClassInfo *info = CLASS_HASH.find(CLASSES, mnemonic);
+            return info != nullptr ? std::optional(info->queryClass) : std::nullopt;
+        }
+
+        // Mnemonic of a known type, or "" (callers print TYPEnnn)
+        constexpr std::string_view mnemonic(uint16_t code) {
+            const TypeInfo *info = find(code);
+            return info != nullptr ? info->mnemonic : std::string_view();
+        }
+
+        // Number after prefix ("TYPE65534", "CLASS3"), RFC 3597
+        constexpr std::optional<uint16_t> genericCode(std::string_view text, std::string_view prefix) {
+            if (text.size() <= prefix.size() || text.size() > prefix.size() + 5 ||
+                !equalsIgnoreCase(text.substr(0, prefix.size()), prefix)) {
+                return std::nullopt;
+            }
+            uint32_t value = 0;
+            for (char c: text.substr(prefix.size())) {
+                if (c < '0' || c > '9') {
+                    return std::nullopt;
+                }
+                value = value * 10 + (c - '0');
+            }
+            return value <= 0xFFFF ? std::optional<uint16_t>(value) : std::nullopt;
+        }
+
+        // Type code from a mnemonic or the generic TYPEnnn form
+        constexpr std::optional<uint16_t> typeCode(std::string_view text) {
+            if (auto type = fromMnemonic(text)) {
+                return static_cast<uint16_t>(*type);
+            }
+            return genericCode(text, "TYPE");
+        }
+
+        constexpr std::optional<uint16_t> classCode(std::string_view text) {
+            if (auto queryClass = classFromMnemonic(text)) {
+                return static_cast<uint16_t>(*queryClass);
+            }
+            return genericCode(text, "CLASS");
+        }
+
+        static_assert(fromMnemonic("mx") == Type::MX && fromMnemonic("DNSKEY") == Type::DNSKEY && !fromMnemonic("MXX"));
+        static_assert(typeCode("TYPE65534") == 65534 && classCode("in") == 1);
+    }
+
+}
+
+#endif // RRTYPES_H
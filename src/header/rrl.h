@@ -0,0 +1,226 @@
+#ifndef RRL_H
+#define RRL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <netinet/in.h>
+
+namespace DNS {
+
+    // Response Rate Limiting in the style of BIND and Knot. Responses are
+    // accounted per client network (/24 for IPv4, /56 for IPv6) and response
+    // class in a fixed-size table of token buckets, so memory stays bounded no
+    // matter how many source addresses are spoofed: a new network simply takes
+    // over the slot it hashes to. Every bucket is one 64-bit word updated with
+    // compare-and-swap, so the check needs no lock.
+    class RateLimiter {
+    public:
+
+        enum class ResponseClass : uint8_t {
+            ANSWER = 0,
+            NXDOMAIN = 1,
+            ERROR = 2
+        };
+
+        enum class Action : uint8_t {
+            SEND, // within the rate
+            DROP, // over the rate, send nothing
+            SLIP, // over the rate, send an empty TC=1 reply so real clients retry over TCP
+            LEAK  // over the rate, but let this one through
+        };
+
+        static RateLimiter& getInstance() {
+            static RateLimiter instance;
+            return instance;
+        }
+
+        // Responses per second per network and class; 0 disables that class.
+        void setRates(uint32_t answer, uint32_t nxdomain, uint32_t error) {
+            rates[static_cast<int>(ResponseClass::ANSWER)] = answer;
+            rates[static_cast<int>(ResponseClass::NXDOMAIN)] = nxdomain;
+            rates[static_cast<int>(ResponseClass::ERROR)] = error;
+        }
+
+        // Seconds of traffic a quiet network may send in one burst
+        void setBurst(uint32_t seconds) {
+            burstSeconds = seconds == 0 ? 1 : seconds;
+        }
+
+        // Every slip-th limited response is a TC=1 reply, every leak-th one is sent
+        // in full; 0 disables either.
+        void setSlip(uint32_t ratio) {
+            slip = ratio;
+        }
+
+        void setLeak(uint32_t ratio) {
+            leak = ratio;
+        }
+
+        void setPrefixLengths(int ipv4, int ipv6) {
+            ipv4Prefix = ipv4 < 0 ? 0 : (ipv4 > 32 ? 32 : ipv4);
+            ipv6Prefix = ipv6 < 0 ? 0 : (ipv6 > 128 ? 128 : ipv6);
+        }
+
+        // Allocates the table once; the size is rounded up to a power of two.
+        void setTableSize(size_t entries) {
+            size_t size = 1;
+            while (size < entries) {
+                size <<= 1;
+            }
+            tableMask = size - 1;
+            table = std::make_unique<std::atomic<uint64_t>[]>(size);
+            for (size_t i = 0; i < size; i++) {
+                table[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // Response class from the header flags of the reply we are about to send
+        static ResponseClass classify(uint16_t flags) {
+            switch (flags & 0x000F) {
+                case 0:
+                    return ResponseClass::ANSWER;
+                case 3:
+                    return ResponseClass::NXDOMAIN;
+                default:
+                    return ResponseClass::ERROR;
+            }
+        }
+
+        // Response class of a reply on the wire. Replies without answer records
+        // (names outside our zones, empty RRsets) count as NXDOMAIN, as random
+        // name floods produce them just as they produce name errors.
+        static ResponseClass classify(const uint8_t *reply, size_t length) {
+            if (length < 12) {
+                return ResponseClass::ERROR;
+            }
+            ResponseClass byRcode = classify(reply[3]);
+            if (byRcode == ResponseClass::ANSWER && reply[6] == 0 && reply[7] == 0) {
+                return ResponseClass::NXDOMAIN;
+            }
+            return byRcode;
+        }
+
+        bool enabled() const {
+            return table != nullptr && (rates[0] != 0 || rates[1] != 0 || rates[2] != 0);
+        }
+
+        Action check(const sockaddr_in &client, ResponseClass responseClass) {
+            uint32_t address = ntohl(client.sin_addr.s_addr);
+            uint32_t mask = ipv4Prefix == 0 ? 0 : ~0u << (32 - ipv4Prefix);
+            return check(static_cast<uint64_t>(address & mask) | (4ull << 32), 0, responseClass);
+        }
+
+        Action check(const sockaddr_in6 &client, ResponseClass responseClass) {
+            uint8_t prefix[16];
+            std::memcpy(prefix, &client.sin6_addr, sizeof(prefix));
+            for (int bit = ipv6Prefix; bit < 128; bit++) {
+                prefix[bit / 8] &= ~(0x80 >> (bit % 8));
+            }
+            uint64_t high, low;
+            std::memcpy(&high, prefix, 8);
+            std::memcpy(&low, prefix + 8, 8);
+            return check(high, low ^ (6ull << 56), responseClass);
+        }
+
+        uint64_t getLimited() const { return limitedCount.load(std::memory_order_relaxed); }
+
+    private:
+
+        // Bucket layout: | tag:20 | tokens:20 | time:24 |. Tokens are kept in
+        // sixteenths and time in sixteenths of a second, so a rate of r responses
+        // per second refills exactly r units per tick; the clock wraps after ~12
+        // days, which only matters for buckets idle that long.
+        static constexpr int TAG_BITS = 20;
+        static constexpr int TOKEN_BITS = 20;
+        static constexpr int TIME_BITS = 24;
+        static constexpr uint64_t TOKEN_MAX = (1ull << TOKEN_BITS) - 1;
+        static constexpr uint64_t TIME_MASK = (1ull << TIME_BITS) - 1;
+        static constexpr uint64_t UNIT = 16;
+
+        RateLimiter() : burstSeconds(2), slip(2), leak(0), ipv4Prefix(24), ipv6Prefix(56), tableMask(0),
+                        secret(std::random_device{}() | (static_cast<uint64_t>(std::random_device{}()) << 32)),
+                        limitedCount(0) {
+            rates[0] = rates[1] = rates[2] = 0;
+        }
+
+        Action check(uint64_t keyHigh, uint64_t keyLow, ResponseClass responseClass) {
+            uint32_t rate = rates[static_cast<int>(responseClass)];
+            if (table == nullptr || rate == 0) {
+                return Action::SEND;
+            }
+
+            uint64_t hash = mix(mix(keyHigh ^ secret) ^ keyLow ^ static_cast<uint64_t>(responseClass));
+            std::atomic<uint64_t> &bucket = table[hash & tableMask];
+            uint64_t tag = hash >> (64 - TAG_BITS);
+            uint64_t now = ticks();
+            uint64_t capacity = std::min<uint64_t>(static_cast<uint64_t>(rate) * UNIT * burstSeconds, TOKEN_MAX);
+
+            uint64_t current = bucket.load(std::memory_order_relaxed);
+            while (true) {
+                uint64_t tokens;
+                if ((current >> (TOKEN_BITS + TIME_BITS)) != tag || current == 0) {
+                    tokens = capacity; // new network, or it took over this slot
+                } else {
+                    uint64_t elapsed = (now - (current & TIME_MASK)) & TIME_MASK;
+                    tokens = std::min<uint64_t>(((current >> TIME_BITS) & TOKEN_MAX) + elapsed * rate, capacity);
+                }
+                bool allowed = tokens >= UNIT;
+                if (allowed) {
+                    tokens -= UNIT;
+                }
+                uint64_t updated = (tag << (TOKEN_BITS + TIME_BITS)) | (tokens << TIME_BITS) | now;
+                if (bucket.compare_exchange_weak(current, updated, std::memory_order_relaxed)) {
+                    if (allowed) {
+                        return Action::SEND;
+                    }
+                    break;
+                }
+            }
+
+            uint64_t limited = limitedCount.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (slip != 0 && limited % slip == 0) {
+                return Action::SLIP;
+            }
+            if (leak != 0 && limited % leak == 0) {
+                return Action::LEAK;
+            }
+            return Action::DROP;
+        }
+
+        static uint64_t ticks() {
+            auto now = std::chrono::steady_clock::now().time_since_epoch();
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count() / 62500) & TIME_MASK;
+        }
+
+        // splitmix64 finaliser
+        static uint64_t mix(uint64_t x) {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ULL;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebULL;
+            x ^= x >> 31;
+            return x;
+        }
+
+        uint32_t rates[3];
+        uint32_t burstSeconds;
+        uint32_t slip;
+        uint32_t leak;
+        int ipv4Prefix;
+        int ipv6Prefix;
+        size_t tableMask;
+        uint64_t secret;
+        std::unique_ptr<std::atomic<uint64_t>[]> table;
+        std::atomic<uint64_t> limitedCount;
+        RateLimiter(const RateLimiter&) = delete;
+        RateLimiter& operator=(const RateLimiter&) = delete;
+    };
+
+}
+
+#endif // RRL_H
@@ -0,0 +1,648 @@
+#include "secondary.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "dns.h"
+#include "dnsEnum.h"
+#include "logger.h"
+#include "metrics.h"
+#include "rdata.h"
+#include "rrTypes.h"
+#include "../database/zoneFile.h"
+
+
+namespace {
+
+    using DNS::DnsEnum;
+    using DNS::ZoneRecord;
+    using DNS::ZoneTransfer;
+
+    constexpr uint16_t IXFR = 251;
+    constexpr uint16_t AXFR = 252;
+
+    // Retry interval for zones that have never been transferred
+    constexpr uint32_t INITIAL_RETRY_SECONDS = 10;
+
+    // How long a lone SOA answering an IXFR waits for a message after it
+    constexpr int LONE_SOA_WAIT_MS = 2000;
+
+    // RFC 1982 serial number arithmetic
+    bool serialNewer(uint32_t serial, uint32_t than) {
+        return serial != than && static_cast<int32_t>(serial - than) > 0;
+    }
+
+    bool isSoa(const ZoneRecord &record) {
+        return record.type == DnsEnum::QueryType::SOA && record.name == "@";
+    }
+
+    // Field of an SOA after the two names: 0 serial, 1 refresh, 2 retry, 3 expire, 4 minimum
+    uint32_t soaField(const ZoneRecord &soa, int index) {
+        std::vector<uint8_t> rdata = ZoneTransfer::wireRData(soa);
+        size_t pos = 0;
+        for (int names = 0; names < 2 && pos < rdata.size(); pos++) {
+            if (rdata[pos] == 0) {
+                names++;
+            } else {
+                pos += rdata[pos];
+            }
+        }
+        pos += index * 4;
+        if (pos + 4 > rdata.size()) {
+            return 0;
+        }
+        return static_cast<uint32_t>(rdata[pos]) << 24 | rdata[pos + 1] << 16 | rdata[pos + 2] << 8 | rdata[pos + 3];
+    }
+
+    // Reads the possibly compressed name at pos into out, lowercased and
+    // uncompressed, and moves pos past it
+    bool readName(const std::vector<uint8_t> &message, size_t &pos, std::vector<uint8_t> &out) {
+        out.clear();
+        size_t at = pos;
+        bool jumped = false;
+        for (int hops = 0; at < message.size();) {
+            uint8_t label = message[at];
+            if ((label & 0xC0) == 0xC0) {
+                if (at + 1 >= message.size() || ++hops > 64) {
+                    return false;
+                }
+                if (!jumped) {
+                    pos = at + 2;
+                    jumped = true;
+                }
+                at = (label & 0x3F) << 8 | message[at + 1];
+                continue;
+            }
+            if (label > 63 || at + label >= message.size()) {
+                return false;
+            }
+            out.push_back(label);
+            if (label == 0) {
+                if (!jumped) {
+                    pos = at + 1;
+                }
+                return out.size() <= 255;
+            }
+            for (size_t i = at + 1; i <= at + label; i++) {
+                out.push_back(static_cast<uint8_t>(std::tolower(message[i])));
+            }
+            at += label + 1;
+        }
+        return false;
+    }
+
+    // The first question's name, lowercased
+    std::string questionName(const uint8_t *message, size_t length) {
+        std::string name;
+        if (DNS::ParseResponse::questionEnd(message, length) == 0) {
+            return name;
+        }
+        for (size_t pos = 12; message[pos] != 0; pos += message[pos] + 1) {
+            name += name.empty() ? "" : ".";
+            name.append(reinterpret_cast<const char *>(message + pos + 1), message[pos]);
+        }
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        return name;
+    }
+
+    // One master file line, with the owner relative to $ORIGIN
+    void writeRecord(std::ostream &out, const ZoneRecord &record) {
+        uint16_t type = static_cast<uint16_t>(record.type);
+        std::string_view mnemonic = DNS::RRTypes::mnemonic(type);
+        out << record.name << ' ' << record.ttl << " IN "
+            << (mnemonic.empty() ? "TYPE" + std::to_string(type) : std::string(mnemonic)) << ' '
+            << DNS::RData::toText(type, ZoneTransfer::wireRData(record)) << '\n';
+    }
+
+    bool readFully(int fd, uint8_t *buffer, size_t length) {
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = recv(fd, buffer + done, length - done, 0);
+            if (n <= 0) {
+                return false;
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    bool writeFully(int fd, const uint8_t *buffer, size_t length) {
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = send(fd, buffer + done, length - done, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            done += n;
+        }
+        return true;
+    }
+
+}
+
+void DNS::Secondary::setStore(MemoryRecordStore *memoryStore) {
+    store = memoryStore;
+}
+
+bool DNS::Secondary::setPrimary(const std::string &address) {
+    size_t colon = address.find(':');
+    primary = {};
+    primary.sin_family = AF_INET;
+    primary.sin_port = htons(colon == std::string::npos ? 53 : std::atoi(address.c_str() + colon + 1));
+    return inet_pton(AF_INET, address.substr(0, colon).c_str(), &primary.sin_addr) == 1;
+}
+
+void DNS::Secondary::setZones(const std::string &list) {
+    zones.clear();
+    std::istringstream entries(list);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        entry.erase(std::remove_if(entry.begin(), entry.end(), ::isspace), entry.end());
+        std::transform(entry.begin(), entry.end(), entry.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (!entry.empty() && entry.back() == '.') {
+            entry.pop_back();
+        }
+        if (!entry.empty()) {
+            zones.emplace_back().name = entry;
+        }
+    }
+}
+
+void DNS::Secondary::setStateDirectory(const std::string &directory) {
+    stateDirectory = directory;
+}
+
+void DNS::Secondary::setJournalSize(int changes) {
+    journalSize = static_cast<size_t>(std::max(0, changes));
+}
+
+void DNS::Secondary::start() {
+    for (auto &zone: zones) {
+        loadSaved(zone);
+        zone.due = Clock::now();
+    }
+    std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            auto next = std::min_element(zones.begin(), zones.end(), [](const Zone &a, const Zone &b) {
+                return a.due < b.due;
+            });
+            if (next->due > Clock::now()) {
+                wake.wait_until(lock, next->due);
+                continue;
+            }
+            // The transfer runs unlocked so NOTIFYs are answered meanwhile; one
+            // arriving during it schedules another round right away
+            Zone zone = *next;
+            next->notified = false;
+            lock.unlock();
+            bool updated = update(zone);
+            lock.lock();
+            next->serial = zone.serial;
+            next->refreshSeconds = zone.refreshSeconds;
+            next->retrySeconds = zone.retrySeconds;
+            next->journalEntries = zone.journalEntries;
+            if (next->notified) {
+                next->due = Clock::now();
+            } else {
+                next->due = Clock::now() + std::chrono::seconds(updated ? zone.refreshSeconds : zone.retrySeconds);
+            }
+        }
+    }).detach();
+}
+
+void DNS::Secondary::notify(const uint8_t *message, size_t length, const sockaddr_in &client, std::vector<uint8_t> &out) {
+    Metrics::add(Metrics::NOTIFY_RECEIVED);
+    if (length < 12 || (message[2] & 0x80) != 0) {
+        out.clear(); // a response; nothing to answer
+        return;
+    }
+    if (!enabled()) {
+        CreateResponse::errorFromQuery(message, length, static_cast<uint8_t>(DnsEnum::ResponseCode::NOT_IMPLEMENTED), out);
+        return;
+    }
+    char address[INET_ADDRSTRLEN] = "";
+    inet_ntop(AF_INET, &client.sin_addr, address, sizeof(address));
+    std::string name = questionName(message, length);
+    if (client.sin_addr.s_addr != primary.sin_addr.s_addr) {
+        Logger::info("notify refused, not from the primary", {{"zone", name}, {"client", address}});
+        CreateResponse::errorFromQuery(message, length, static_cast<uint8_t>(DnsEnum::ResponseCode::REFUSED), out);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto zone = std::find_if(zones.begin(), zones.end(), [&name](const Zone &z) { return z.name == name; });
+        if (zone == zones.end()) {
+            CreateResponse::errorFromQuery(message, length, static_cast<uint8_t>(DnsEnum::ResponseCode::NOT_AUTHORITATIVE), out);
+            return;
+        }
+        zone->notified = true;
+        zone->due = Clock::now();
+    }
+    wake.notify_one();
+    Logger::info("notify received", {{"zone", name}, {"client", address}});
+    CreateResponse::errorFromQuery(message, length, static_cast<uint8_t>(DnsEnum::ResponseCode::NO_ERROR), out);
+    out[2] |= 0x04; // AA
+}
+
+bool DNS::Secondary::apply(std::vector<ZoneRecord> &records, const ZoneTransfer::Change &change) {
+    const ZoneRecord *soa = ZoneTransfer::findSoa(records);
+    if (soa == nullptr || ZoneTransfer::soaSerial(*soa) != ZoneTransfer::soaSerial(change.oldSoa)) {
+        return false;
+    }
+    std::unordered_map<std::string, size_t> deleted;
+    for (const auto &record: change.deleted) {
+        deleted[ZoneTransfer::recordKey(record)]++;
+    }
+    std::vector<ZoneRecord> next;
+    next.reserve(records.size() + change.added.size());
+    next.push_back(change.newSoa);
+    std::unordered_set<std::string> present;
+    for (auto &record: records) {
+        if (isSoa(record)) {
+            continue;
+        }
+        std::string key = ZoneTransfer::recordKey(record);
+        auto it = deleted.find(key);
+        if (it != deleted.end() && it->second > 0) {
+            it->second--;
+            continue;
+        }
+        present.insert(std::move(key));
+        next.push_back(std::move(record));
+    }
+    // Deleting a record we do not have means the zones have drifted apart
+    if (std::any_of(deleted.begin(), deleted.end(), [](const auto &entry) { return entry.second > 0; })) {
+        return false;
+    }
+    for (const auto &record: change.added) {
+        if (present.insert(ZoneTransfer::recordKey(record)).second) {
+            next.push_back(record);
+        }
+    }
+    records = std::move(next);
+    return true;
+}
+
+std::optional<std::vector<DNS::ZoneTransfer::Change>> DNS::Secondary::changes(const ZoneRecord *first,
+                                                                              const ZoneRecord *last) {
+    std::vector<ZoneTransfer::Change> result;
+    while (first != last) {
+        if (!isSoa(*first)) {
+            return std::nullopt;
+        }
+        ZoneTransfer::Change change;
+        change.oldSoa = *first++;
+        while (first != last && !isSoa(*first)) {
+            change.deleted.push_back(*first++);
+        }
+        if (first == last) {
+            return std::nullopt;
+        }
+        change.newSoa = *first++;
+        while (first != last && !isSoa(*first)) {
+            change.added.push_back(*first++);
+        }
+        result.push_back(std::move(change));
+    }
+    return result;
+}
+
+void DNS::Secondary::loadSaved(Zone &zone) {
+    if (stateDirectory.empty() || store == nullptr || access(statePath(zone, ".zone").c_str(), R_OK) != 0) {
+        return;
+    }
+    std::string name = zone.name;
+    std::vector<ZoneRecord> records;
+    if (!ZoneFile::load(statePath(zone, ".zone"), name, records) || ZoneTransfer::findSoa(records) == nullptr) {
+        Logger::warn("saved zone unusable, transferring it again", {{"zone", zone.name}});
+        return;
+    }
+
+    // Replay the journal up to the first change that does not follow on
+    size_t replayed = 0, total = 0;
+    std::vector<ZoneRecord> journal;
+    if (access(statePath(zone, ".journal").c_str(), R_OK) == 0) {
+        auto entries = ZoneFile::load(statePath(zone, ".journal"), name, journal)
+                           ? changes(journal.data(), journal.data() + journal.size())
+                           : std::nullopt;
+        total = entries ? entries->size() : 1;
+        for (const auto &change: entries.value_or(std::vector<ZoneTransfer::Change>{})) {
+            if (!apply(records, change)) {
+                break;
+            }
+            replayed++;
+        }
+    }
+    install(zone, records);
+    zone.journalEntries = replayed;
+    if (replayed < total) {
+        Logger::warn("zone journal partly unusable, saving the zone whole", {{"zone", zone.name}, {"replayed", replayed}});
+        saveZone(zone, records);
+    }
+    Logger::info("secondary zone loaded", {{"zone", zone.name}, {"serial", *zone.serial}, {"journal", replayed}});
+}
+
+bool DNS::Secondary::update(Zone &zone) {
+    if (zone.retrySeconds == 0) {
+        zone.retrySeconds = INITIAL_RETRY_SECONDS;
+    }
+    std::optional<Transfer> received;
+    if (zone.serial) {
+        received = transfer(zone, IXFR);
+    }
+    if (received && received->incremental) {
+        if (received->changes.empty()) {
+            Logger::debug("secondary zone up to date", {{"zone", zone.name}, {"serial", *zone.serial}});
+            return true;
+        }
+        ZoneRecords current = store->zoneRecords(zone.name);
+        std::vector<ZoneRecord> records(current->begin(), current->end());
+        bool applied = std::all_of(received->changes.begin(), received->changes.end(), [&records](const auto &change) {
+            return apply(records, change);
+        });
+        if (applied) {
+            appendJournal(zone, records, received->changes);
+            install(zone, std::move(records));
+            Metrics::add(Metrics::SECONDARY_INCREMENTAL);
+            Logger::info("secondary zone updated", {{"zone", zone.name}, {"serial", *zone.serial},
+                                                    {"changes", received->changes.size()}});
+            return true;
+        }
+        Logger::warn("incremental transfer does not apply, falling back to AXFR", {{"zone", zone.name}});
+        received.reset();
+    }
+    if (!received) {
+        received = transfer(zone, AXFR);
+    }
+    if (!received || received->incremental) {
+        Metrics::add(Metrics::SECONDARY_FAILURES);
+        return false;
+    }
+    size_t count = received->records.size();
+    zone.journalEntries = 0;
+    saveZone(zone, received->records);
+    install(zone, std::move(received->records));
+    Metrics::add(Metrics::SECONDARY_FULL);
+    Logger::info("secondary zone transferred", {{"zone", zone.name}, {"serial", *zone.serial}, {"records", count}});
+    return true;
+}
+
+std::optional<DNS::Secondary::Transfer> DNS::Secondary::transfer(const Zone &zone, uint16_t type) {
+    const char *kind = type == IXFR ? "IXFR" : "AXFR";
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    struct Closer {
+        int fd;
+        ~Closer() { close(fd); }
+    } closer{fd};
+    timeval timeout{10, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, reinterpret_cast<const sockaddr *>(&primary), sizeof(primary)) != 0) {
+        Logger::warn("cannot reach the primary", {{"zone", zone.name}, {"type", kind}, {"error", std::strerror(errno)}});
+        return std::nullopt;
+    }
+
+    // The query, with an IXFR carrying our SOA serial in the authority section
+    static thread_local std::mt19937 random(std::random_device{}());
+    uint16_t id = static_cast<uint16_t>(random());
+    std::vector<uint8_t> query{0, 0};
+    CreateResponse::addUint16(query, id);
+    query.insert(query.end(), {0, 0});
+    CreateResponse::addUint16(query, 1);
+    CreateResponse::addUint16(query, 0);
+    CreateResponse::addUint16(query, type == IXFR ? 1 : 0);
+    CreateResponse::addUint16(query, 0);
+    std::vector<uint8_t> name = CreateResponse::domainToDnsFormat(zone.name);
+    query.insert(query.end(), name.begin(), name.end());
+    CreateResponse::addUint16(query, type);
+    CreateResponse::addUint16(query, static_cast<uint16_t>(DnsEnum::QueryClass::IN));
+    if (type == IXFR) {
+        query.insert(query.end(), name.begin(), name.end());
+        CreateResponse::addUint16(query, static_cast<uint16_t>(DnsEnum::QueryType::SOA));
+        CreateResponse::addUint16(query, static_cast<uint16_t>(DnsEnum::QueryClass::IN));
+        CreateResponse::addUint32(query, 0);
+        CreateResponse::addUint16(query, 22);
+        query.insert(query.end(), {0, 0}); // root MNAME and RNAME; only the serial matters
+        CreateResponse::addUint32(query, *zone.serial);
+        query.insert(query.end(), 16, 0);
+    }
+    CreateResponse::setUint16(query, 0, static_cast<uint16_t>(query.size() - 2));
+    if (!writeFully(fd, query.data(), query.size())) {
+        return std::nullopt;
+    }
+
+    // Records are collected until the transfer's closing SOA. An incremental
+    // answer has SOAs alternating between old and new versions; the closing
+    // one repeats the first SOA's serial right after an addition run for it.
+    Transfer result;
+    std::vector<ZoneRecord> stream;
+    uint32_t finalSerial = 0;
+    uint32_t additionSerial = 0;
+    size_t soaCount = 0;
+    bool done = false;
+    std::vector<uint8_t> message;
+    std::vector<uint8_t> owner;
+    std::string suffix = "." + zone.name;
+    auto failed = [&](const std::string &reason) {
+        Logger::warn("zone transfer from the primary failed", {{"zone", zone.name}, {"type", kind}, {"error", reason}});
+        return std::nullopt;
+    };
+    while (!done) {
+        uint8_t prefix[2];
+        if (!readFully(fd, prefix, sizeof(prefix))) {
+            return failed("connection closed");
+        }
+        message.resize(prefix[0] << 8 | prefix[1]);
+        if (message.size() < 12 || !readFully(fd, message.data(), message.size())) {
+            return failed("short message");
+        }
+        if (ParseResponse::readUint16(message, 0) != id || (message[2] & 0x80) == 0) {
+            return failed("unexpected message");
+        }
+        if (uint8_t rcode = message[3] & 0x0F) {
+            return failed("rcode " + std::to_string(rcode));
+        }
+        size_t pos = 12;
+        for (uint16_t i = ParseResponse::readUint16(message, 4); i > 0; i--) {
+            if (!ParseResponse::skipName(message, pos) || (pos += 4) > message.size()) {
+                return failed("bad question");
+            }
+        }
+        for (uint16_t i = ParseResponse::readUint16(message, 6); i > 0 && !done; i--) {
+            if (!readName(message, pos, owner) || pos + 10 > message.size()) {
+                return failed("bad record");
+            }
+            uint16_t recordType = ParseResponse::readUint16(message, pos);
+            uint16_t recordClass = ParseResponse::readUint16(message, pos + 2);
+            uint32_t ttl = static_cast<uint32_t>(ParseResponse::readUint16(message, pos + 4)) << 16 |
+                           ParseResponse::readUint16(message, pos + 6);
+            size_t length = ParseResponse::readUint16(message, pos + 8);
+            pos += 10;
+            if (pos + length > message.size()) {
+                return failed("bad record");
+            }
+            size_t rdataAt = pos;
+            pos += length;
+
+            std::string ownerText = RData::nameText(owner);
+            if (ownerText == zone.name) {
+                ownerText = "@";
+            } else if (ownerText.size() > suffix.size() && ownerText.ends_with(suffix)) {
+                ownerText.resize(ownerText.size() - suffix.size());
+            } else {
+                continue; // outside the zone
+            }
+            if (recordClass != static_cast<uint16_t>(DnsEnum::QueryClass::IN)) {
+                continue;
+            }
+            ZoneRecord record{ownerText, static_cast<DnsEnum::QueryType>(recordType), {}, ttl, {}};
+            try {
+                // Names in these rdata may be compressed against the message
+                switch (record.type) {
+                    case DnsEnum::QueryType::NS:
+                    case DnsEnum::QueryType::CNAME:
+                    case DnsEnum::QueryType::SOA:
+                    case DnsEnum::QueryType::PTR:
+                    case DnsEnum::QueryType::MX:
+                        record.rdata = RData::encode(record.type, RData::toText(recordType, message.data(), message.size(),
+                                                                                 rdataAt, length));
+                        break;
+                    default:
+                        record.rdata.assign(message.begin() + rdataAt, message.begin() + rdataAt + length);
+                }
+            } catch (const RData::Error &e) {
+                return failed(e.what());
+            }
+
+            if (stream.empty()) {
+                if (!isSoa(record)) {
+                    return failed("does not start with the SOA");
+                }
+                finalSerial = ZoneTransfer::soaSerial(record);
+            } else if (isSoa(record)) {
+                uint32_t serial = ZoneTransfer::soaSerial(record);
+                soaCount++;
+                if (soaCount == 1) {
+                    // An old serial right after the first SOA makes it incremental
+                    result.incremental = type == IXFR && serial != finalSerial;
+                    done = !result.incremental;
+                } else if (!result.incremental || (soaCount % 2 == 1 && additionSerial == finalSerial)) {
+                    done = true;
+                } else if (soaCount % 2 == 0) {
+                    additionSerial = serial;
+                }
+            }
+            stream.push_back(std::move(record));
+        }
+        // A first message holding only the SOA may just be the start of a
+        // transfer sent one record per message (RFC 5936 section 2.2). It means
+        // "up to date" only if its serial is not newer than ours and nothing
+        // follows: the primary closes the connection or stays silent.
+        if (!done && type == IXFR && stream.size() == 1 && !serialNewer(finalSerial, *zone.serial)) {
+            pollfd pending{fd, POLLIN, 0};
+            char next;
+            if (poll(&pending, 1, LONE_SOA_WAIT_MS) <= 0 || recv(fd, &next, 1, MSG_PEEK) <= 0) {
+                result.incremental = true;
+                return result;
+            }
+        }
+    }
+
+    if (result.incremental) {
+        auto parsed = changes(stream.data() + 1, stream.data() + stream.size() - 1);
+        if (!parsed) {
+            return failed("malformed incremental transfer");
+        }
+        result.changes = std::move(*parsed);
+    } else {
+        stream.pop_back();
+        result.records = std::move(stream);
+    }
+    return result;
+}
+
+void DNS::Secondary::saveZone(const Zone &zone, const std::vector<ZoneRecord> &records) {
+    if (stateDirectory.empty()) {
+        return;
+    }
+    std::string path = statePath(zone, ".zone");
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        out << "$ORIGIN " << zone.name << ".\n";
+        for (const auto &record: records) {
+            writeRecord(out, record);
+        }
+        out.flush();
+        if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            Logger::warn("cannot save zone", {{"zone", zone.name}, {"path", path}});
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    // The saved zone now includes everything the journal held
+    std::remove(statePath(zone, ".journal").c_str());
+}
+
+void DNS::Secondary::appendJournal(Zone &zone, const std::vector<ZoneRecord> &records,
+                                   const std::vector<ZoneTransfer::Change> &applied) {
+    if (stateDirectory.empty()) {
+        return;
+    }
+    if (zone.journalEntries + applied.size() > journalSize) {
+        zone.journalEntries = 0;
+        saveZone(zone, records);
+        return;
+    }
+    std::string path = statePath(zone, ".journal");
+    std::ofstream out(path, std::ios::app);
+    if (zone.journalEntries == 0) {
+        out << "$ORIGIN " << zone.name << ".\n";
+    }
+    for (const auto &change: applied) {
+        writeRecord(out, change.oldSoa);
+        for (const auto &record: change.deleted) {
+            writeRecord(out, record);
+        }
+        writeRecord(out, change.newSoa);
+        for (const auto &record: change.added) {
+            writeRecord(out, record);
+        }
+    }
+    out.flush();
+    if (!out) {
+        Logger::warn("cannot write zone journal", {{"zone", zone.name}, {"path", path}});
+        return;
+    }
+    zone.journalEntries += applied.size();
+}
+
+void DNS::Secondary::install(Zone &zone, std::vector<ZoneRecord> records) {
+    if (const ZoneRecord *soa = ZoneTransfer::findSoa(records)) {
+        zone.serial = ZoneTransfer::soaSerial(*soa);
+        zone.refreshSeconds = std::max<uint32_t>(1, soaField(*soa, 1));
+        zone.retrySeconds = std::max<uint32_t>(1, soaField(*soa, 2));
+    }
+    store->replaceZone(zone.name, std::move(records));
+}
+
+std::string DNS::Secondary::statePath(const Zone &zone, const char *suffix) const {
+    return stateDirectory + "/" + zone.name + suffix;
+}
@@ -0,0 +1,124 @@
+#ifndef SECONDARY_H
+#define SECONDARY_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+
+#include "zoneTransfer.h"
+#include "../database/memoryStore.h"
+
+namespace DNS {
+
+    // Keeps zones of a primary server in the memory store (RFC 1995, 1996,
+    // 5936). A zone is brought up to date with IXFR, or AXFR when the primary
+    // cannot send a difference, whenever the primary sends a NOTIFY and
+    // otherwise after the SOA refresh time. Changes are applied to a copy of
+    // the zone, which then replaces the old one in a single swap. With a state
+    // directory every zone is saved as a master file plus a journal of the
+    // changes applied since, so after a restart the zone is served at once and
+    // only what changed in between is transferred.
+    class Secondary {
+    public:
+
+        static Secondary& getInstance() {
+            static Secondary instance;
+            return instance;
+        }
+
+        void setStore(MemoryRecordStore *memoryStore);
+
+        // "ip[:port]"; false if it is not an address
+        bool setPrimary(const std::string &address);
+
+        // "zone,..."
+        void setZones(const std::string &list);
+
+        // Where zones and journals are saved; empty keeps nothing
+        void setStateDirectory(const std::string &directory);
+
+        // Journal entries kept before the zone is saved whole again
+        void setJournalSize(int changes);
+
+        // Loads the saved zones and starts the thread that keeps them current
+        void start();
+
+        bool enabled() const { return !zones.empty(); }
+
+        // Answers a NOTIFY (RFC 1996) into out: the primary's are acknowledged and
+        // bring the zone's refresh forward, others are refused
+        void notify(const uint8_t *message, size_t length, const sockaddr_in &client, std::vector<uint8_t> &out);
+
+        // Applies change to records if they are at its old serial
+        static bool apply(std::vector<ZoneRecord> &records, const ZoneTransfer::Change &change);
+
+        // Splits "old SOA, deleted, new SOA, added" runs, as IXFR answers and
+        // journals list them, into changes; nothing if the runs are malformed
+        static std::optional<std::vector<ZoneTransfer::Change>> changes(const ZoneRecord *first, const ZoneRecord *last);
+
+    private:
+
+        Secondary() = default;
+
+        using Clock = std::chrono::steady_clock;
+
+        struct Zone {
+            std::string name;
+            std::optional<uint32_t> serial;     // nothing until the zone is loaded
+            uint32_t refreshSeconds = 0;
+            uint32_t retrySeconds = 0;
+            size_t journalEntries = 0;
+            Clock::time_point due;
+            bool notified = false;              // a NOTIFY came in since the last round
+        };
+
+        // What the primary sent for one transfer
+        struct Transfer {
+            bool incremental = false;
+            std::vector<ZoneRecord> records;                 // full zone
+            std::vector<ZoneTransfer::Change> changes;       // incremental
+        };
+
+        void loadSaved(Zone &zone);
+
+        // Brings zone up to date; false if the primary could not be reached or
+        // sent something unusable
+        bool update(Zone &zone);
+
+        // Runs one AXFR or IXFR against the primary; nothing on failure
+        std::optional<Transfer> transfer(const Zone &zone, uint16_t type);
+
+        // Writes records as the zone's master file and drops its journal
+        void saveZone(const Zone &zone, const std::vector<ZoneRecord> &records);
+
+        // Adds applied, which turned the zone into records, to its journal; a
+        // journal grown past journalSize is folded into the saved zone instead
+        void appendJournal(Zone &zone, const std::vector<ZoneRecord> &records,
+                           const std::vector<ZoneTransfer::Change> &applied);
+
+        // Swaps records in as the zone and takes its timers from the SOA
+        void install(Zone &zone, std::vector<ZoneRecord> records);
+
+        std::string statePath(const Zone &zone, const char *suffix) const;
+
+        MemoryRecordStore *store = nullptr;
+        sockaddr_in primary{};
+        std::string stateDirectory;
+        size_t journalSize = 100;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<Zone> zones;
+
+        Secondary(const Secondary&) = delete;
+        Secondary& operator=(const Secondary&) = delete;
+    };
+
+}
+
+#endif // SECONDARY_H
@@ -0,0 +1,204 @@
+#ifndef TCP_H
+#define TCP_H
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+namespace DNS {
+
+    // DNS over plain TCP (RFC 7766) on the UDP port. Connections are served on
+    // their own threads like the TLS ones; besides ordinary queries they carry
+    // zone transfers, whose many reply messages are written as they are built.
+    class TCP {
+    public:
+
+        // Builds the wire response for one query; an empty vector means no reply.
+        using QueryHandler = std::vector<uint8_t> (*)(const char*, size_t, const sockaddr_in&);
+
+        // Writes one message to the connection; false once the client is gone
+        using MessageWriter = std::function<bool(const std::vector<uint8_t>&)>;
+
+        // Answers queries that take several messages (zone transfers) through the
+        // writer; returns false, having written nothing, for any other query
+        using StreamHandler = bool (*)(const char*, size_t, const sockaddr_in&, const MessageWriter&);
+
+        static TCP& getInstance() {
+            static TCP instance;
+            return instance;
+        }
+
+        void setPort(int sPort) {
+            port = sPort;
+        }
+
+        void setMaxConnections(int sMaxConnections) {
+            maxConnections = sMaxConnections;
+        }
+
+        void setIdleTimeout(int seconds) {
+            idleTimeoutSeconds = seconds;
+        }
+
+        void setQueryHandler(QueryHandler handler) {
+            queryHandler = handler;
+        }
+
+        void setStreamHandler(StreamHandler handler) {
+            streamHandler = handler;
+        }
+
+        void bindTcp() {
+            if (port == -1) {
+                port = 53;
+            }
+            if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+                perror("tcp socket creation failed");
+                exit(EXIT_FAILURE);
+            }
+            int enable = 1;
+            setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+            memset(&server_addr, 0, sizeof(server_addr));
+            server_addr.sin_family = AF_INET;
+            server_addr.sin_addr.s_addr = INADDR_ANY;
+            server_addr.sin_port = htons(port);
+
+            if (bind(sockfd, (const struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+                perror("tcp bind failed");
+                exit(EXIT_FAILURE);
+            }
+            if (listen(sockfd, SOMAXCONN) < 0) {
+                perror("tcp listen failed");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        void listenForConnections() {
+            while (true) {
+                sockaddr_in client_addr{};
+                socklen_t len = sizeof(client_addr);
+                int clientfd = accept(sockfd, (struct sockaddr*)&client_addr, &len);
+                if (clientfd < 0) {
+                    perror("tcp accept failed");
+                    continue;
+                }
+                if (activeConnections.fetch_add(1) >= maxConnections) {
+                    activeConnections.fetch_sub(1);
+                    close(clientfd);
+                    continue;
+                }
+                std::thread([this, clientfd, client_addr] {
+                    serveConnection(clientfd, client_addr);
+                    activeConnections.fetch_sub(1);
+                }).detach();
+            }
+        }
+
+        ~TCP() {
+            if (sockfd >= 0) {
+                close(sockfd);
+            }
+        }
+
+        int getSocketFd() const { return sockfd; }
+        int getActiveConnections() const { return activeConnections.load(); }
+
+    private:
+
+        TCP() : sockfd(-1), port(-1), maxConnections(256), idleTimeoutSeconds(10),
+                queryHandler(nullptr), streamHandler(nullptr), activeConnections(0) {}
+
+        void serveConnection(int clientfd, const sockaddr_in &client_addr) {
+            timeval timeout{idleTimeoutSeconds, 0};
+            setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(clientfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            int enable = 1;
+            setsockopt(clientfd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+            // Length prefix and message go out in one send
+            std::vector<uint8_t> output;
+            MessageWriter write = [clientfd, &output](const std::vector<uint8_t> &message) {
+                if (message.empty() || message.size() > 0xFFFF) {
+                    return !message.empty();
+                }
+                output.clear();
+                output.push_back(message.size() >> 8);
+                output.push_back(message.size() & 0xFF);
+                output.insert(output.end(), message.begin(), message.end());
+                return writeFully(clientfd, output.data(), output.size());
+            };
+
+            std::vector<uint8_t> query;
+            while (true) {
+                uint8_t lengthPrefix[2];
+                if (!readFully(clientfd, lengthPrefix, sizeof(lengthPrefix))) {
+                    break;
+                }
+                size_t length = (lengthPrefix[0] << 8) | lengthPrefix[1];
+                query.resize(length);
+                if (length == 0 || !readFully(clientfd, query.data(), length)) {
+                    break;
+                }
+                const char *data = reinterpret_cast<const char*>(query.data());
+
+                if (streamHandler != nullptr && streamHandler(data, length, client_addr, write)) {
+                    continue;
+                }
+                if (queryHandler != nullptr && !write(queryHandler(data, length, client_addr))) {
+                    break;
+                }
+            }
+
+            close(clientfd);
+        }
+
+        static bool readFully(int fd, uint8_t *buffer, size_t length) {
+            size_t done = 0;
+            while (done < length) {
+                ssize_t n = recv(fd, buffer + done, length - done, 0);
+                if (n <= 0) {
+                    return false;
+                }
+                done += n;
+            }
+            return true;
+        }
+
+        static bool writeFully(int fd, const uint8_t *buffer, size_t length) {
+            size_t done = 0;
+            while (done < length) {
+                ssize_t n = send(fd, buffer + done, length - done, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    return false;
+                }
+                done += n;
+            }
+            return true;
+        }
+
+        int sockfd;
+        int port;
+        int maxConnections;
+        int idleTimeoutSeconds;
+        QueryHandler queryHandler;
+        StreamHandler streamHandler;
+        std::atomic<int> activeConnections;
+        sockaddr_in server_addr{};
+        TCP(const TCP&) = delete;
+        TCP& operator=(const TCP&) = delete;
+    };
+
+}
+
+#endif // TCP_H
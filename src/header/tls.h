@@ -0,0 +1,267 @@
+#ifndef TLS_H
+#define TLS_H
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+namespace DNS {
+
+    // DNS-over-TLS listener (RFC 7858). Every accepted connection is served on
+    // its own thread and kept open for many queries, so the handshake cost is
+    // paid once per client rather than once per query. Sessions can be resumed
+    // with TLS tickets, and the kernel can take over record encryption (kTLS)
+    // when it is available.
+    class TLS {
+    public:
+
+        // Builds the wire response for one query; an empty vector means no reply.
+        using QueryHandler = std::vector<uint8_t> (*)(const char*, size_t, const sockaddr_in&);
+
+        static TLS& getInstance() {
+            static TLS instance;
+            return instance;
+        }
+
+        void setPort(int sPort) {
+            port = sPort;
+        }
+
+        void setMaxConnections(int sMaxConnections) {
+            maxConnections = sMaxConnections;
+        }
+
+        void setIdleTimeout(int seconds) {
+            idleTimeoutSeconds = seconds;
+        }
+
+        void setKtls(bool enabled) {
+            ktls = enabled;
+        }
+
+        void setQueryHandler(QueryHandler handler) {
+            queryHandler = handler;
+        }
+
+        void loadCertificate(const std::string &certFile, const std::string &keyFile) {
+            ctx = SSL_CTX_new(TLS_server_method());
+            if (ctx == nullptr) {
+                ERR_print_errors_fp(stderr);
+                exit(EXIT_FAILURE);
+            }
+            SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+
+            // Resumption: stateless tickets for TLS 1.3 and a server-side cache for
+            // TLS 1.2 session IDs. A client reconnecting within the lifetime skips the
+            // full key exchange.
+            static const unsigned char sessionContext[] = "dns-dot";
+            SSL_CTX_set_session_id_context(ctx, sessionContext, sizeof(sessionContext) - 1);
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_set_timeout(ctx, 7200);
+            SSL_CTX_set_num_tickets(ctx, 2);
+
+#ifdef SSL_OP_ENABLE_KTLS
+            if (ktls) {
+                SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+            }
+#else
+            if (ktls) {
+                std::cerr << "kTLS requested but not supported by this OpenSSL build" << '\n';
+            }
+#endif
+
+            SSL_CTX_set_alpn_select_cb(ctx, selectAlpn, nullptr);
+
+            if (SSL_CTX_use_certificate_chain_file(ctx, certFile.c_str()) <= 0 ||
+                SSL_CTX_use_PrivateKey_file(ctx, keyFile.c_str(), SSL_FILETYPE_PEM) <= 0 ||
+                SSL_CTX_check_private_key(ctx) != 1) {
+                ERR_print_errors_fp(stderr);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        void bindTls() {
+            if (port == -1) {
+                port = 853;
+            }
+            if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+                perror("tls socket creation failed");
+                exit(EXIT_FAILURE);
+            }
+            int enable = 1;
+            setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+            memset(&server_addr, 0, sizeof(server_addr));
+            server_addr.sin_family = AF_INET;
+            server_addr.sin_addr.s_addr = INADDR_ANY;
+            server_addr.sin_port = htons(port);
+
+            if (bind(sockfd, (const struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+                perror("tls bind failed");
+                exit(EXIT_FAILURE);
+            }
+            if (listen(sockfd, SOMAXCONN) < 0) {
+                perror("tls listen failed");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        void listenForConnections() {
+            while (true) {
+                sockaddr_in client_addr{};
+                socklen_t len = sizeof(client_addr);
+                int clientfd = accept(sockfd, (struct sockaddr*)&client_addr, &len);
+                if (clientfd < 0) {
+                    perror("tls accept failed");
+                    continue;
+                }
+                if (activeConnections.fetch_add(1) >= maxConnections) {
+                    activeConnections.fetch_sub(1);
+                    close(clientfd);
+                    continue;
+                }
+                std::thread([this, clientfd, client_addr] {
+                    serveConnection(clientfd, client_addr);
+                    activeConnections.fetch_sub(1);
+                }).detach();
+            }
+        }
+
+        ~TLS() {
+            if (sockfd >= 0) {
+                close(sockfd);
+            }
+            if (ctx != nullptr) {
+                SSL_CTX_free(ctx);
+            }
+        }
+
+        int getSocketFd() const { return sockfd; }
+        int getActiveConnections() const { return activeConnections.load(); }
+
+    private:
+
+        TLS() : sockfd(-1), port(-1), maxConnections(256), idleTimeoutSeconds(10), ktls(false),
+                queryHandler(nullptr), ctx(nullptr), activeConnections(0) {}
+
+        // Upper bound on buffered replies before they are written out, so a long
+        // pipeline still gets its answers streamed back.
+        static constexpr size_t MAX_PENDING_OUTPUT = 16 * 1024;
+
+        void serveConnection(int clientfd, const sockaddr_in &client_addr) {
+            timeval timeout{idleTimeoutSeconds, 0};
+            setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(clientfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            int enable = 1;
+            setsockopt(clientfd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+            SSL *ssl = SSL_new(ctx);
+            SSL_set_fd(ssl, clientfd);
+            if (SSL_accept(ssl) <= 0) {
+                SSL_free(ssl);
+                close(clientfd);
+                return;
+            }
+
+            // Queries are answered in arrival order. While the client has more
+            // queries already buffered, replies are collected and written together,
+            // so a pipelined burst costs one TLS record and one syscall.
+            std::vector<uint8_t> query;
+            std::vector<uint8_t> output;
+            while (true) {
+                uint8_t lengthPrefix[2];
+                if (!readFully(ssl, lengthPrefix, sizeof(lengthPrefix))) {
+                    break;
+                }
+                size_t length = (lengthPrefix[0] << 8) | lengthPrefix[1];
+                query.resize(length);
+                if (length == 0 || !readFully(ssl, query.data(), length)) {
+                    break;
+                }
+
+                if (queryHandler != nullptr) {
+                    std::vector<uint8_t> response = queryHandler(reinterpret_cast<const char*>(query.data()), length, client_addr);
+                    if (!response.empty() && response.size() <= 0xFFFF) {
+                        output.push_back(response.size() >> 8);
+                        output.push_back(response.size() & 0xFF);
+                        output.insert(output.end(), response.begin(), response.end());
+                    }
+                }
+
+                if (!output.empty() && (SSL_pending(ssl) == 0 || output.size() >= MAX_PENDING_OUTPUT)) {
+                    if (!writeFully(ssl, output.data(), output.size())) {
+                        break;
+                    }
+                    output.clear();
+                }
+            }
+
+            SSL_shutdown(ssl);
+            SSL_free(ssl);
+            close(clientfd);
+        }
+
+        static bool readFully(SSL *ssl, uint8_t *buffer, size_t length) {
+            size_t done = 0;
+            while (done < length) {
+                int n = SSL_read(ssl, buffer + done, static_cast<int>(length - done));
+                if (n <= 0) {
+                    return false;
+                }
+                done += n;
+            }
+            return true;
+        }
+
+        static bool writeFully(SSL *ssl, const uint8_t *buffer, size_t length) {
+            size_t done = 0;
+            while (done < length) {
+                int n = SSL_write(ssl, buffer + done, static_cast<int>(length - done));
+                if (n <= 0) {
+                    return false;
+                }
+                done += n;
+            }
+            return true;
+        }
+
+        // Accept the "dot" ALPN token (RFC 7858 / IANA) when the client offers it.
+        static int selectAlpn(SSL *, const unsigned char **out, unsigned char *outlen,
+                              const unsigned char *in, unsigned int inlen, void *) {
+            static const unsigned char protocols[] = {3, 'd', 'o', 't'};
+            unsigned char *selected = nullptr;
+            if (SSL_select_next_proto(&selected, outlen, protocols, sizeof(protocols), in, inlen) == OPENSSL_NPN_NEGOTIATED) {
+                *out = selected;
+                return SSL_TLSEXT_ERR_OK;
+            }
+            return SSL_TLSEXT_ERR_NOACK;
+        }
+
+        int sockfd;
+        int port;
+        int maxConnections;
+        int idleTimeoutSeconds;
+        bool ktls;
+        QueryHandler queryHandler;
+        SSL_CTX *ctx;
+        std::atomic<int> activeConnections;
+        sockaddr_in server_addr{};
+        TLS(const TLS&) = delete;
+        TLS& operator=(const TLS&) = delete;
+    };
+
+}
+
+#endif // TLS_H
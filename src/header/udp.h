@@ -11,6 +11,8 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <time.h>
+#include "metrics.h"
 
 namespace DNS {
 
@@ -48,13 +50,26 @@ namespace DNS {
 
         void listenForData() {
             char buffer[MAXLINE];
+            // Kernel arrival timestamps, so the receive stage includes socket queueing
+            int enable = 1;
+            setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+            char control[CMSG_SPACE(sizeof(timespec))];
             while (true) {
-                len = sizeof(client_addr);
-                int n = recvfrom(sockfd, buffer, MAXLINE, MSG_WAITALL, (struct sockaddr*)&client_addr, &len);
+                iovec iov{buffer, static_cast<size_t>(MAXLINE)};
+                msghdr message{};
+                message.msg_name = &client_addr;
+                message.msg_namelen = sizeof(client_addr);
+                message.msg_iov = &iov;
+                message.msg_iovlen = 1;
+                message.msg_control = control;
+                message.msg_controllen = sizeof(control);
+                int n = recvmsg(sockfd, &message, MSG_WAITALL);
                 if (n < 0) {
                     perror("recvfrom failed");
                     continue;
                 }
+                len = message.msg_namelen;
+                recordReceiveLatency(message);
 
                 if (dataCallback) {
                     dataCallback(buffer, n, client_addr);
@@ -68,6 +83,12 @@ namespace DNS {
             }
         }
 
+        // Replies to a specific client; safe to call from other threads.
+        void sendResponseTo(const char* response, int response_length, int flags, const sockaddr_in &addr) {
+            if (sendto(sockfd, response, response_length, flags, (const struct sockaddr*)&addr, sizeof(addr)) < 0) {
+                perror("sendto failed");
+            }
+        }
 
         // Destructor
         ~UDP() {
@@ -82,6 +103,19 @@ namespace DNS {
 
         UDP() : sockfd(-1), port(-1) {}
 
+        static void recordReceiveLatency(msghdr &message) {
+            for (cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)) {
+                if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_TIMESTAMPNS) {
+                    timespec arrived{}, now{};
+                    memcpy(&arrived, CMSG_DATA(header), sizeof(arrived));
+                    clock_gettime(CLOCK_REALTIME, &now);
+                    Metrics::record(Metrics::STAGE_RECEIVE, (now.tv_sec - arrived.tv_sec) * 1000000000LL +
+                                                            (now.tv_nsec - arrived.tv_nsec));
+                    return;
+                }
+            }
+        }
+
         void createSocket() {
             if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
                 perror("socket creation failed");
@@ -0,0 +1,629 @@
+#include "zoneTransfer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <random>
+#include <thread>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "dns.h"
+#include "dnsEnum.h"
+#include "logger.h"
+#include "metrics.h"
+#include "rdata.h"
+
+
+namespace {
+
+    using DNS::DnsEnum;
+
+    constexpr uint16_t IXFR = 251;
+    constexpr uint16_t AXFR = 252;
+
+    // Types whose rdata names may be compressed (RFC 3597 section 4)
+    bool compressible(DnsEnum::QueryType type) {
+        switch (type) {
+            case DnsEnum::QueryType::NS:
+            case DnsEnum::QueryType::CNAME:
+            case DnsEnum::QueryType::SOA:
+            case DnsEnum::QueryType::PTR:
+            case DnsEnum::QueryType::MX:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Length of the uncompressed wire name at data, 0 if it is malformed
+    size_t nameLength(const uint8_t *data, size_t size) {
+        size_t pos = 0;
+        while (pos < size && data[pos] != 0) {
+            if (data[pos] > 63) {
+                return 0;
+            }
+            pos += data[pos] + 1;
+        }
+        return pos < size ? pos + 1 : 0;
+    }
+
+    // The messages of one transfer. Records are appended with name compression
+    // until the next one would push the message past 64 KiB; the message is
+    // then written out and the next one started in the same buffer.
+    class MessageBuilder {
+    public:
+        MessageBuilder(const uint8_t *query, size_t questionEnd, const DNS::ZoneTransfer::MessageWriter &write)
+            : query(query), questionEnd(questionEnd), write(write) {
+            begin();
+        }
+
+        // false once the client is gone
+        bool add(const std::vector<uint8_t> &owner, const DNS::ZoneRecord &record) {
+            std::vector<uint8_t> encoded;
+            const std::vector<uint8_t> *rdata = &record.rdata;
+            if (rdata->empty()) {
+                encoded = DNS::ZoneTransfer::wireRData(record);
+                rdata = &encoded;
+            }
+            for (int attempt = 0; attempt < 2; attempt++) {
+                size_t mark = packet.size();
+                writeRecord(owner, record, *rdata);
+                if (packet.size() <= MESSAGE_LIMIT) {
+                    count++;
+                    return true;
+                }
+                rollback(mark);
+                if (count == 0) {
+                    break; // too large even for a message of its own
+                }
+                if (!flush()) {
+                    return false;
+                }
+            }
+            DNS::Logger::warn("record too large to transfer", {{"name", record.name}});
+            return true;
+        }
+
+        bool finish() {
+            return count == 0 && messages > 0 ? true : flush();
+        }
+
+        size_t messageCount() const { return messages; }
+
+    private:
+        static constexpr size_t MESSAGE_LIMIT = 0xFFFF;
+
+        void begin() {
+            packet.clear();
+            names.clear();
+            packet.insert(packet.end(), query, query + 2); // ID
+            packet.push_back(0x84 | (query[2] & 0x01));    // QR, AA, RD echoed
+            packet.push_back(0);
+            uint16_t questions = messages == 0 ? 1 : 0;   // the question goes in the first message only
+            DNS::CreateResponse::addUint16(packet, questions);
+            DNS::CreateResponse::addUint16(packet, 0);
+            DNS::CreateResponse::addUint16(packet, 0);
+            DNS::CreateResponse::addUint16(packet, 0);
+            if (questions != 0) {
+                packet.insert(packet.end(), query + 12, query + questionEnd);
+            }
+            count = 0;
+        }
+
+        bool flush() {
+            DNS::CreateResponse::setUint16(packet, 6, count);
+            messages++;
+            if (!write(packet)) {
+                return false;
+            }
+            begin();
+            return true;
+        }
+
+        void rollback(size_t mark) {
+            packet.resize(mark);
+            for (auto it = names.begin(); it != names.end();) {
+                it = it->second >= mark ? names.erase(it) : std::next(it);
+            }
+        }
+
+        // Writes an uncompressed wire name, pointing at the longest suffix
+        // already in the message
+        void writeName(const uint8_t *name, size_t length) {
+            for (size_t pos = 0; pos < length && name[pos] != 0; pos += name[pos] + 1) {
+                std::string suffix(reinterpret_cast<const char *>(name + pos), length - pos);
+                auto it = names.find(suffix);
+                if (it != names.end()) {
+                    DNS::CreateResponse::addUint16(packet, 0xC000 | it->second);
+                    return;
+                }
+                if (packet.size() < 0x4000) {
+                    names.emplace(std::move(suffix), static_cast<uint16_t>(packet.size()));
+                }
+                packet.insert(packet.end(), name + pos, name + pos + name[pos] + 1);
+            }
+            packet.push_back(0);
+        }
+
+        void writeRecord(const std::vector<uint8_t> &owner, const DNS::ZoneRecord &record,
+                         const std::vector<uint8_t> &rdata) {
+            writeName(owner.data(), owner.size());
+            DNS::CreateResponse::addUint16(packet, static_cast<uint16_t>(record.type));
+            DNS::CreateResponse::addUint16(packet, static_cast<uint16_t>(DnsEnum::QueryClass::IN));
+            DNS::CreateResponse::addUint32(packet, record.ttl);
+            size_t lengthAt = packet.size();
+            DNS::CreateResponse::addUint16(packet, 0);
+
+            size_t pos = 0;
+            if (compressible(record.type)) {
+                // Only names and fixed-size numbers occur in these types
+                for (auto field: DNS::RRTypes::find(static_cast<uint16_t>(record.type))->fields) {
+                    size_t size = field == DNS::RRTypes::Field::U16 ? 2 : 4;
+                    if (field == DNS::RRTypes::Field::END) {
+                        break;
+                    }
+                    if (field == DNS::RRTypes::Field::NAME) {
+                        size = nameLength(rdata.data() + pos, rdata.size() - pos);
+                        if (size == 0) {
+                            break;
+                        }
+                        writeName(rdata.data() + pos, size);
+                    } else if (pos + size <= rdata.size()) {
+                        packet.insert(packet.end(), rdata.begin() + pos, rdata.begin() + pos + size);
+                    } else {
+                        break;
+                    }
+                    pos += size;
+                }
+            }
+            packet.insert(packet.end(), rdata.begin() + pos, rdata.end());
+            DNS::CreateResponse::setUint16(packet, lengthAt, packet.size() - lengthAt - 2);
+        }
+
+        const uint8_t *query;
+        size_t questionEnd;
+        const DNS::ZoneTransfer::MessageWriter &write;
+        std::vector<uint8_t> packet;
+        std::unordered_map<std::string, uint16_t> names; // wire name suffix -> offset
+        uint16_t count = 0;
+        size_t messages = 0;
+    };
+
+    // Serial of the SOA an IXFR query carries in its authority section
+    std::optional<uint32_t> requestedSerial(const uint8_t *query, size_t length, size_t questionEnd) {
+        std::vector<uint8_t> data(query, query + length);
+        if (DNS::ParseResponse::readUint16(data, 8) == 0) {
+            return std::nullopt;
+        }
+        size_t pos = questionEnd;
+        if (!DNS::ParseResponse::skipName(data, pos) || pos + 10 > data.size() ||
+            DNS::ParseResponse::readUint16(data, pos) != static_cast<uint16_t>(DnsEnum::QueryType::SOA)) {
+            return std::nullopt;
+        }
+        size_t rdataEnd = pos + 10 + DNS::ParseResponse::readUint16(data, pos + 8);
+        pos += 10;
+        if (!DNS::ParseResponse::skipName(data, pos) || !DNS::ParseResponse::skipName(data, pos) ||
+            pos + 4 > rdataEnd || rdataEnd > data.size()) {
+            return std::nullopt;
+        }
+        return static_cast<uint32_t>(DNS::ParseResponse::readUint16(data, pos)) << 16 |
+               DNS::ParseResponse::readUint16(data, pos + 2);
+    }
+
+}
+
+void DNS::ZoneTransfer::setStore(RecordStore *recordStore) {
+    store = recordStore;
+}
+
+void DNS::ZoneTransfer::setAllowed(const std::string &list) {
+    allowedNetworks.clear();
+    std::istringstream entries(list);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        entry.erase(std::remove_if(entry.begin(), entry.end(), ::isspace), entry.end());
+        if (entry.empty()) {
+            continue;
+        }
+        size_t slash = entry.find('/');
+        int prefix = slash == std::string::npos ? 32 : std::clamp(std::atoi(entry.c_str() + slash + 1), 0, 32);
+        in_addr address{};
+        if (inet_pton(AF_INET, entry.substr(0, slash).c_str(), &address) != 1) {
+            Logger::warn("ignoring bad transfer client", {{"entry", entry}});
+            continue;
+        }
+        uint32_t mask = prefix == 0 ? 0 : ~0u << (32 - prefix);
+        allowedNetworks.emplace_back(ntohl(address.s_addr) & mask, mask);
+    }
+}
+
+void DNS::ZoneTransfer::setNotifyTargets(const std::string &list) {
+    notifyTargets.clear();
+    std::istringstream entries(list);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        entry.erase(std::remove_if(entry.begin(), entry.end(), ::isspace), entry.end());
+        if (entry.empty()) {
+            continue;
+        }
+        size_t colon = entry.find(':');
+        sockaddr_in target{};
+        target.sin_family = AF_INET;
+        target.sin_port = htons(colon == std::string::npos ? 53 : std::atoi(entry.c_str() + colon + 1));
+        if (inet_pton(AF_INET, entry.substr(0, colon).c_str(), &target.sin_addr) != 1) {
+            Logger::warn("ignoring bad notify target", {{"entry", entry}});
+            continue;
+        }
+        notifyTargets.push_back(target);
+    }
+}
+
+void DNS::ZoneTransfer::setMaxTransfers(int count) {
+    maxTransfers = std::max(1, count);
+}
+
+void DNS::ZoneTransfer::setJournalSize(int changes) {
+    journalSize = static_cast<size_t>(std::max(0, changes));
+}
+
+void DNS::ZoneTransfer::start(int intervalSeconds) {
+    std::thread([this, intervalSeconds] {
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::seconds(intervalSeconds));
+            std::vector<std::string> names;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const auto &[zone, version]: zones) {
+                    names.push_back(zone);
+                }
+            }
+            for (const auto &zone: names) {
+                try {
+                    refresh(zone);
+                } catch (const std::exception &e) {
+                    Logger::debug("zone journal refresh failed", {{"zone", zone}, {"error", e.what()}});
+                }
+            }
+        }
+    }).detach();
+}
+
+bool DNS::ZoneTransfer::serve(const uint8_t *query, size_t length, const sockaddr_in &client, const MessageWriter &write) {
+    size_t end = ParseResponse::questionEnd(query, length);
+    if (end == 0 || (query[2] & 0x80) != 0) {
+        return false;
+    }
+    uint16_t type = query[end - 4] << 8 | query[end - 3];
+    uint16_t queryClass = query[end - 2] << 8 | query[end - 1];
+    if (type != AXFR && type != IXFR) {
+        return false;
+    }
+
+    std::vector<uint8_t> error;
+    auto fail = [&](DnsEnum::ResponseCode rcode) {
+        CreateResponse::errorFromQuery(query, length, static_cast<uint8_t>(rcode), error);
+        write(error);
+        return true;
+    };
+    char address[INET_ADDRSTRLEN] = "";
+    inet_ntop(AF_INET, &client.sin_addr, address, sizeof(address));
+
+    if (!allowed(client) || queryClass != static_cast<uint16_t>(DnsEnum::QueryClass::IN)) {
+        Metrics::add(Metrics::TRANSFERS_REFUSED);
+        Logger::info("zone transfer refused", {{"client", address}});
+        return fail(DnsEnum::ResponseCode::REFUSED);
+    }
+    if (active.fetch_add(1) >= maxTransfers) {
+        active.fetch_sub(1);
+        Metrics::add(Metrics::TRANSFERS_REFUSED);
+        Logger::warn("zone transfer refused, too many running", {{"client", address}, {"limit", maxTransfers}});
+        return fail(DnsEnum::ResponseCode::REFUSED);
+    }
+    struct Release {
+        std::atomic<int> &count;
+        ~Release() { count.fetch_sub(1); }
+    } release{active};
+
+    std::string zone;
+    for (size_t pos = 12; query[pos] != 0; pos += query[pos] + 1) {
+        zone += zone.empty() ? "" : ".";
+        zone.append(reinterpret_cast<const char *>(query + pos + 1), query[pos]);
+    }
+    std::transform(zone.begin(), zone.end(), zone.begin(), [](unsigned char c) { return std::tolower(c); });
+    std::string subdomain, mainDomain;
+    ParseResponse::splitDomain(zone, subdomain, mainDomain);
+    if (!subdomain.empty() || store == nullptr) {
+        return fail(DnsEnum::ResponseCode::NOT_AUTHORITATIVE);
+    }
+
+    ZoneRecords records;
+    Journal journal;
+    try {
+        std::tie(records, journal) = refresh(zone);
+    } catch (const std::exception &e) {
+        Logger::warn("zone transfer failed", {{"zone", zone}, {"error", e.what()}});
+        return fail(DnsEnum::ResponseCode::SERVER_FAILURE);
+    }
+    if (records->empty()) {
+        return fail(DnsEnum::ResponseCode::NOT_AUTHORITATIVE);
+    }
+    const ZoneRecord *soa = findSoa(*records);
+    if (soa == nullptr) {
+        return fail(DnsEnum::ResponseCode::SERVER_FAILURE);
+    }
+    uint32_t serial = soaSerial(*soa);
+
+    std::optional<uint32_t> clientSerial;
+    if (type == IXFR) {
+        clientSerial = requestedSerial(query, length, end);
+        if (!clientSerial) {
+            return fail(DnsEnum::ResponseCode::FORMAT_ERROR);
+        }
+    }
+
+    // Owner names are relative to the apex; consecutive records mostly share one
+    std::vector<uint8_t> apex = CreateResponse::domainToDnsFormat(zone);
+    std::vector<uint8_t> owner;
+    const std::string *ownerName = nullptr;
+    MessageBuilder builder(query, end, write);
+    auto add = [&](const ZoneRecord &record) {
+        if (ownerName == nullptr || *ownerName != record.name) {
+            owner.clear();
+            try {
+                RData::appendName(owner, record.name, apex);
+            } catch (const RData::Error &) {
+                Logger::warn("skipping record with a bad owner in transfer", {{"name", record.name}});
+                ownerName = nullptr;
+                return true;
+            }
+            ownerName = &record.name;
+        }
+        return builder.add(owner, record);
+    };
+
+    // An IXFR is answered from the journal when it reaches back to the client's
+    // serial, and otherwise with the whole zone (RFC 1995 section 4)
+    bool upToDate = clientSerial && static_cast<int32_t>(serial - *clientSerial) <= 0;
+    auto from = journal.end();
+    if (clientSerial && !upToDate) {
+        from = std::find_if(journal.begin(), journal.end(), [&clientSerial](const auto &change) {
+            return soaSerial(change->oldSoa) == *clientSerial;
+        });
+    }
+    const char *kind;
+    bool sent = add(*soa);
+    if (upToDate) {
+        kind = "IXFR, up to date";
+    } else if (from != journal.end()) {
+        kind = "IXFR, incremental";
+        for (auto it = from; it != journal.end() && sent; ++it) {
+            sent = add((*it)->oldSoa);
+            for (const auto &record: (*it)->deleted) {
+                sent = sent && add(record);
+            }
+            sent = sent && add((*it)->newSoa);
+            for (const auto &record: (*it)->added) {
+                sent = sent && add(record);
+            }
+        }
+        sent = sent && add(*soa);
+    } else {
+        kind = type == IXFR ? "IXFR, full zone" : "AXFR";
+        for (const auto &record: *records) {
+            if (&record != soa && sent) {
+                sent = add(record);
+            }
+        }
+        sent = sent && add(*soa);
+    }
+    sent = sent && builder.finish();
+
+    Metrics::add(type == IXFR ? Metrics::IXFR_TRANSFERS : Metrics::AXFR_TRANSFERS);
+    if (sent) {
+        Logger::info("zone transfer", {{"zone", zone}, {"client", address}, {"answer", kind}, {"serial", serial}});
+    } else {
+        Logger::warn("zone transfer aborted by the client", {{"zone", zone}, {"client", address},
+                                                             {"messages", builder.messageCount()}});
+    }
+    return true;
+}
+
+const DNS::ZoneRecord *DNS::ZoneTransfer::findSoa(const std::vector<ZoneRecord> &records) {
+    for (const auto &record: records) {
+        if (record.type == DnsEnum::QueryType::SOA && record.name == "@") {
+            return &record;
+        }
+    }
+    return nullptr;
+}
+
+uint32_t DNS::ZoneTransfer::soaSerial(const ZoneRecord &soa) {
+    std::vector<uint8_t> rdata = wireRData(soa);
+    size_t mname = nameLength(rdata.data(), rdata.size());
+    size_t rname = mname == 0 ? 0 : nameLength(rdata.data() + mname, rdata.size() - mname);
+    size_t pos = mname + rname;
+    if (rname == 0 || pos + 4 > rdata.size()) {
+        return 0;
+    }
+    return static_cast<uint32_t>(rdata[pos]) << 24 | rdata[pos + 1] << 16 | rdata[pos + 2] << 8 | rdata[pos + 3];
+}
+
+DNS::ZoneTransfer::Change DNS::ZoneTransfer::compare(const std::vector<ZoneRecord> &before,
+                                                     const std::vector<ZoneRecord> &after) {
+    auto keyed = [](const std::vector<ZoneRecord> &records) {
+        std::vector<std::pair<std::string, const ZoneRecord *>> keys;
+        keys.reserve(records.size());
+        for (const auto &record: records) {
+            if (record.type != DnsEnum::QueryType::SOA || record.name != "@") {
+                keys.emplace_back(recordKey(record), &record);
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+        return keys;
+    };
+    auto old = keyed(before), current = keyed(after);
+
+    Change change;
+    if (const ZoneRecord *soa = findSoa(before)) {
+        change.oldSoa = *soa;
+    }
+    if (const ZoneRecord *soa = findSoa(after)) {
+        change.newSoa = *soa;
+    }
+    size_t i = 0, j = 0;
+    while (i < old.size() || j < current.size()) {
+        if (j == current.size() || (i < old.size() && old[i].first < current[j].first)) {
+            change.deleted.push_back(*old[i++].second);
+        } else if (i == old.size() || current[j].first < old[i].first) {
+            change.added.push_back(*current[j++].second);
+        } else {
+            i++;
+            j++;
+        }
+    }
+    return change;
+}
+
+std::vector<uint8_t> DNS::ZoneTransfer::wireRData(const ZoneRecord &record) {
+    if (!record.rdata.empty()) {
+        return record.rdata;
+    }
+    try {
+        return RData::encode(record.type, record.value);
+    } catch (const RData::Error &) {
+        return {};
+    }
+}
+
+std::string DNS::ZoneTransfer::recordKey(const ZoneRecord &record) {
+    std::string key = record.name;
+    key.push_back('\0');
+    uint16_t type = static_cast<uint16_t>(record.type);
+    key.push_back(static_cast<char>(type >> 8));
+    key.push_back(static_cast<char>(type & 0xFF));
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        key.push_back(static_cast<char>(record.ttl >> shift & 0xFF));
+    }
+    std::vector<uint8_t> rdata = wireRData(record);
+    key.append(rdata.begin(), rdata.end());
+    return key;
+}
+
+std::pair<DNS::ZoneRecords, DNS::ZoneTransfer::Journal> DNS::ZoneTransfer::refresh(const std::string &zone) {
+    ZoneRecords records = store->zoneRecords(zone);
+    if (records->empty()) {
+        return {records, {}};
+    }
+    const ZoneRecord *soa = findSoa(*records);
+    uint32_t serial = soa != nullptr ? soaSerial(*soa) : 0;
+
+    ZoneRecords previous;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = zones.find(zone);
+        if (it != zones.end()) {
+            if (it->second.serial == serial) {
+                it->second.records = records;
+                return {records, it->second.journal};
+            }
+            previous = it->second.records;
+        }
+    }
+
+    // Comparing the versions may take a while on a large zone; do it unlocked
+    std::shared_ptr<Change> change;
+    if (previous != nullptr && soa != nullptr && findSoa(*previous) != nullptr) {
+        change = std::make_shared<Change>(compare(*previous, *records));
+    }
+
+    Journal journal;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ZoneVersion &version = zones[zone];
+        if (change != nullptr && version.records == previous && journalSize > 0) {
+            version.journal.push_back(change);
+            while (version.journal.size() > journalSize) {
+                version.journal.pop_front();
+            }
+        } else if (version.records != previous) {
+            version.journal.clear(); // raced with another refresh; start over
+        }
+        version.records = records;
+        version.serial = serial;
+        journal = version.journal;
+    }
+    if (change != nullptr) {
+        notify(zone, *soa);
+    }
+    return {records, journal};
+}
+
+bool DNS::ZoneTransfer::allowed(const sockaddr_in &client) const {
+    uint32_t address = ntohl(client.sin_addr.s_addr);
+    return std::any_of(allowedNetworks.begin(), allowedNetworks.end(), [address](const auto &network) {
+        return (address & network.second) == network.first;
+    });
+}
+
+void DNS::ZoneTransfer::notify(const std::string &zone, const ZoneRecord &soa) {
+    if (notifyTargets.empty()) {
+        return;
+    }
+    // NOTIFY with AA, the zone as question and its new SOA as answer
+    static thread_local std::mt19937 random(std::random_device{}());
+    uint16_t id = static_cast<uint16_t>(random());
+    std::vector<uint8_t> message;
+    CreateResponse::addUint16(message, id);
+    message.push_back(static_cast<uint8_t>(DnsEnum::Opcode::NOTIFY) << 3 | 0x04);
+    message.push_back(0);
+    CreateResponse::addUint16(message, 1);
+    CreateResponse::addUint16(message, 1);
+    CreateResponse::addUint16(message, 0);
+    CreateResponse::addUint16(message, 0);
+    std::vector<uint8_t> name = CreateResponse::domainToDnsFormat(zone);
+    message.insert(message.end(), name.begin(), name.end());
+    CreateResponse::addUint16(message, static_cast<uint16_t>(DnsEnum::QueryType::SOA));
+    CreateResponse::addUint16(message, static_cast<uint16_t>(DnsEnum::QueryClass::IN));
+    message.insert(message.end(), name.begin(), name.end());
+    CreateResponse::addUint16(message, static_cast<uint16_t>(DnsEnum::QueryType::SOA));
+    CreateResponse::addUint16(message, static_cast<uint16_t>(DnsEnum::QueryClass::IN));
+    CreateResponse::addUint32(message, soa.ttl);
+    std::vector<uint8_t> rdata = wireRData(soa);
+    CreateResponse::addUint16(message, static_cast<uint16_t>(rdata.size()));
+    message.insert(message.end(), rdata.begin(), rdata.end());
+
+    for (const auto &target: notifyTargets) {
+        std::thread([zone, message, target, id] {
+            int fd = socket(AF_INET, SOCK_DGRAM, 0);
+            if (fd < 0) {
+                return;
+            }
+            timeval timeout{2, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            char address[INET_ADDRSTRLEN] = "";
+            inet_ntop(AF_INET, &target.sin_addr, address, sizeof(address));
+            bool answered = false;
+            for (int attempt = 0; attempt < 5 && !answered; attempt++) {
+                sendto(fd, message.data(), message.size(), 0, reinterpret_cast<const sockaddr *>(&target), sizeof(target));
+                Metrics::add(Metrics::NOTIFY_SENT);
+                uint8_t reply[512];
+                ssize_t n;
+                while ((n = recv(fd, reply, sizeof(reply), 0)) >= 12) {
+                    if ((reply[0] << 8 | reply[1]) == id && (reply[2] & 0x80) != 0) {
+                        answered = true;
+                        break;
+                    }
+                }
+            }
+            close(fd);
+            if (answered) {
+                Logger::debug("notify answered", {{"zone", zone}, {"target", address}});
+            } else {
+                Logger::warn("notify not answered", {{"zone", zone}, {"target", address}});
+            }
+        }).detach();
+    }
+}
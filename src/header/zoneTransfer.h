@@ -0,0 +1,123 @@
+#ifndef ZONETRANSFER_H
+#define ZONETRANSFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <netinet/in.h>
+
+#include "../database/recordStore.h"
+
+namespace DNS {
+
+    // Outgoing zone transfers over TCP: AXFR (RFC 5936) and IXFR (RFC 1995).
+    // A transfer walks a snapshot of the zone from the record store and packs it
+    // into compressed messages close to 64 KiB, each written out before the next
+    // one is built, so the connection thread never holds more than one message
+    // and no lock is held while the client reads. IXFR answers come from a
+    // journal: whenever a zone shows up with a new SOA serial, its records are
+    // compared with the previous version and the difference is kept, and the
+    // configured secondaries are sent a NOTIFY.
+    class ZoneTransfer {
+    public:
+
+        using MessageWriter = std::function<bool(const std::vector<uint8_t> &)>;
+
+        // One journal entry: the zone went from oldSoa to newSoa by removing
+        // deleted and adding added; neither list holds the SOA itself
+        struct Change {
+            ZoneRecord oldSoa;
+            ZoneRecord newSoa;
+            std::vector<ZoneRecord> deleted;
+            std::vector<ZoneRecord> added;
+        };
+
+        using Journal = std::deque<std::shared_ptr<const Change>>;
+
+        static ZoneTransfer& getInstance() {
+            static ZoneTransfer instance;
+            return instance;
+        }
+
+        void setStore(RecordStore *recordStore);
+
+        // Clients allowed to transfer, "ip[/prefix],..."; empty allows none
+        void setAllowed(const std::string &list);
+
+        // Transfers served at the same time; more are refused
+        void setMaxTransfers(int count);
+
+        // Changes kept per zone; older serials get the whole zone
+        void setJournalSize(int changes);
+
+        // Secondaries to NOTIFY (RFC 1996) when a zone gets a new serial,
+        // "ip[:port],..."
+        void setNotifyTargets(const std::string &list);
+
+        // Checks the zones transferred so far every intervalSeconds, so versions
+        // that nobody asked for in between still get their own journal entry
+        void start(int intervalSeconds);
+
+        // Serves query if it asks for AXFR or IXFR, writing every message through
+        // write; false, having written nothing, for any other query
+        bool serve(const uint8_t *query, size_t length, const sockaddr_in &client, const MessageWriter &write);
+
+        int activeTransfers() const { return active.load(); }
+
+        // The SOA among records (owner "@"), nullptr if there is none
+        static const ZoneRecord *findSoa(const std::vector<ZoneRecord> &records);
+
+        static uint32_t soaSerial(const ZoneRecord &soa);
+
+        // What turns before into after, SOA left out of both lists
+        static Change compare(const std::vector<ZoneRecord> &before, const std::vector<ZoneRecord> &after);
+
+        // Wire rdata of a record, encoding its text if it has none yet
+        static std::vector<uint8_t> wireRData(const ZoneRecord &record);
+
+        // Identity of a record for diffs: owner, type, TTL and rdata
+        static std::string recordKey(const ZoneRecord &record);
+
+    private:
+
+        ZoneTransfer() = default;
+
+        struct ZoneVersion {
+            ZoneRecords records;
+            uint32_t serial = 0;
+            Journal journal;
+        };
+
+        // Current records of zone from the store, journaling a change of serial
+        std::pair<ZoneRecords, Journal> refresh(const std::string &zone);
+
+        bool allowed(const sockaddr_in &client) const;
+
+        // Sends each target a NOTIFY for zone, retried until it is answered
+        void notify(const std::string &zone, const ZoneRecord &soa);
+
+        RecordStore *store = nullptr;
+        std::vector<std::pair<uint32_t, uint32_t>> allowedNetworks; // address, mask (host order)
+        std::vector<sockaddr_in> notifyTargets;
+        int maxTransfers = 4;
+        size_t journalSize = 100;
+        std::atomic<int> active{0};
+
+        std::mutex mutex;
+        std::unordered_map<std::string, ZoneVersion> zones;
+
+        ZoneTransfer(const ZoneTransfer&) = delete;
+        ZoneTransfer& operator=(const ZoneTransfer&) = delete;
+    };
+
+}
+
+#endif // ZONETRANSFER_H
@@ -3,70 +3,687 @@
 #include "header/dns.h"
 #include "header/udp.h"
 #include "header/dnsRequestBody.h"
+#include "header/config.h"
+#include "header/tls.h"
+#include "header/tcp.h"
+#include "header/forwarder.h"
+#include "header/rrl.h"
+#include "header/cookie.h"
+#include "header/dnssec.h"
+#include "header/metrics.h"
+#include "header/logger.h"
+#include "header/dnstap.h"
+#include "header/rdata.h"
+#include "header/zoneTransfer.h"
+#include "header/secondary.h"
 #include <vector>
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <future>
+#include <optional>
 #include <sstream>
-#include "database/postegre.h"
+#include <thread>
+#include "database/postegreStore.h"
+#include "database/memoryStore.h"
+#include "database/imageStore.h"
+#include "database/faultStore.h"
+#include "database/cachingStore.h"
 
-#define PORT 53
-#define MAXLINE 1024
+#define MAXLINE 4096
 
-std::string conn_str = "";
-auto &db = postegre::Database::get_database(conn_str);
+// Chosen in main() from DNS_BACKEND before any listener starts
+std::unique_ptr<DNS::RecordStore> recordStore;
 
 
-void processData(const char *data, size_t length, const sockaddr_in &client_addr) {
+// Text rows are encoded when the reply is built, zone file rows carry wire rdata
+AnswerSection answerFor(const std::string &owner, const DNS::ZoneRecord &record) {
+    if (!record.rdata.empty()) {
+        return AnswerSection(owner, record.type, DNS::DnsEnum::QueryClass::IN, record.ttl, record.rdata);
+    }
+    return AnswerSection(owner, record.type, DNS::DnsEnum::QueryClass::IN, record.ttl, record.value);
+}
+
+// The zone's SOA for the authority section of a negative answer; its TTL is the
+// negative caching time, the smaller of the SOA TTL and its minimum (RFC 2308).
+// Nothing when the zone has no SOA. Every store encodes rdata as it loads, so
+// the minimum is read from the last four bytes of the wire form.
+std::optional<AnswerSection> negativeSoa(const std::string &zone, const DNS::RecordRange &apex) {
+    for (const auto &record: apex) {
+        // Two names and five 32-bit fields; anything shorter is not an SOA
+        if (record.type != DNS::DnsEnum::QueryType::SOA || record.rdata.size() < 22) {
+            continue;
+        }
+        AnswerSection soa = answerFor(zone, record);
+        const uint8_t *last = record.rdata.data() + record.rdata.size() - 4;
+        uint32_t minimum = (static_cast<uint32_t>(last[0]) << 24) | (last[1] << 16) | (last[2] << 8) | last[3];
+        soa.ttl = std::min(minimum, record.ttl);
+        return soa;
+    }
+    return std::nullopt;
+}
+
+// TTL for records the server makes up at the apex (DNSKEY): the SOA's, as the
+// zone's own default, or the configured one
+uint32_t zoneTtl(const DNS::RecordRange &apex) {
+    for (const auto &record: apex) {
+        if (record.type == DNS::DnsEnum::QueryType::SOA) {
+            return record.ttl;
+        }
+    }
+    return DNS::Config::getInstance().defaultTtl;
+}
+
+// Longest CNAME chain followed inside our zones before the rest is left to the client
+constexpr int MAX_CNAME_CHAIN = 8;
+
+// Target name in the wire rdata of a CNAME, NS, MX or SRV record, "" for other types
+std::string rdataTarget(DNS::DnsEnum::QueryType type, const std::vector<uint8_t> &rdata) {
+    size_t offset;
+    switch (type) {
+        case DNS::DnsEnum::QueryType::CNAME:
+        case DNS::DnsEnum::QueryType::NS:
+            offset = 0;
+            break;
+        case DNS::DnsEnum::QueryType::MX:
+            offset = 2; // preference
+            break;
+        case DNS::DnsEnum::QueryType::SRV:
+            offset = 6; // priority, weight, port
+            break;
+        default:
+            return "";
+    }
+    if (rdata.size() <= offset) {
+        return "";
+    }
+    return DNS::RData::nameText(std::vector<uint8_t>(rdata.begin() + offset, rdata.end()));
+}
+
+std::string lowercase(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    return name;
+}
+
+// Appends the chain that starts at target: CNAMEs in turn, then the records of
+// the asked type at its end. Each step is only peeked at, so a chain never costs
+// a database query; it stops at names outside our zones or not at hand, at a
+// loop or after MAX_CNAME_CHAIN steps, and the client resolves the rest.
+void followCname(std::string target, const QuestionSection &question, bool dnssecOk,
+                 std::pmr::list<AnswerSection> &answers) {
+    std::vector<std::string> seen{lowercase(question.query)};
+    auto &dnssec = DNS::Dnssec::getInstance();
+    for (int depth = 0; depth < MAX_CNAME_CHAIN && !target.empty(); depth++) {
+        if (std::find(seen.begin(), seen.end(), target) != seen.end()) {
+            DNS::Logger::debug("cname loop", {{"query", question.query}, {"target", target}});
+            return;
+        }
+        seen.push_back(target);
+
+        std::string subdomain, zone;
+        DNS::ParseResponse::splitDomain(target, subdomain, zone);
+        auto found = recordStore->peek(zone, subdomain.empty() ? "@" : subdomain);
+        if (!found || !found->zoneFound) {
+            return;
+        }
+
+        std::pmr::list<AnswerSection> step;
+        std::string next;
+        for (const auto &record: found->records) {
+            if (question.type == static_cast<uint16_t>(record.type)) {
+                step.push_back(answerFor(target, record));
+            } else if (record.type == DNS::DnsEnum::QueryType::CNAME) {
+                step.push_back(answerFor(target, record));
+                next = lowercase(rdataTarget(record.type, record.rdata));
+            }
+        }
+        if (dnssecOk && dnssec.isSigned(zone)) {
+            dnssec.signSection(zone, step);
+        }
+        answers.splice(answers.end(), step);
+        target = next;
+    }
+}
+
+// A and AAAA records of the MX, NS and SRV targets among the answers, taken only
+// from what the store has at hand so glue never costs a database query; signed
+// for DO=1 queries when their zone is
+void addGlue(const std::pmr::list<AnswerSection> &answers, bool dnssecOk, std::pmr::list<AnswerSection> &additional) {
+    auto &dnssec = DNS::Dnssec::getInstance();
+    std::vector<std::string> targets;
+    for (const auto &answer: answers) {
+        std::string target = lowercase(rdataTarget(answer.queryType, answer.wireData));
+        if (answer.queryType != DNS::DnsEnum::QueryType::CNAME && !target.empty() &&
+            std::find(targets.begin(), targets.end(), target) == targets.end()) {
+            targets.push_back(std::move(target));
+        }
+    }
+    for (const auto &target: targets) {
+        std::string subdomain, zone;
+        DNS::ParseResponse::splitDomain(target, subdomain, zone);
+        auto found = recordStore->peek(zone, subdomain.empty() ? "@" : subdomain);
+        if (!found) {
+            continue;
+        }
+        std::pmr::list<AnswerSection> glue;
+        for (const auto &record: found->records) {
+            if (record.type == DNS::DnsEnum::QueryType::A || record.type == DNS::DnsEnum::QueryType::AAAA) {
+                glue.push_back(answerFor(target, record));
+            }
+        }
+        if (dnssecOk && !glue.empty() && dnssec.isSigned(zone)) {
+            dnssec.signSection(zone, glue);
+        }
+        additional.splice(additional.end(), glue);
+    }
+}
+
+// Keeps only the RRset with the least rdata
+void minimalAny(std::pmr::list<AnswerSection> &answers) {
+    std::vector<std::pair<DNS::DnsEnum::QueryType, size_t>> sizes;
+    for (const auto &answer: answers) {
+        size_t size = answer.wireData.empty() ? answer.rData.size() : answer.wireData.size();
+        auto it = std::find_if(sizes.begin(), sizes.end(), [&answer](const auto &entry) {
+            return entry.first == answer.queryType;
+        });
+        if (it == sizes.end()) {
+            sizes.emplace_back(answer.queryType, size);
+        } else {
+            it->second += size;
+        }
+    }
+    if (sizes.size() <= 1) {
+        return;
+    }
+    auto kept = std::min_element(sizes.begin(), sizes.end(), [](const auto &a, const auto &b) {
+        return a.second < b.second;
+    })->first;
+    answers.remove_if([kept](const AnswerSection &answer) { return answer.queryType != kept; });
+}
+
+// Carries out a DROP or SLIP for the message (query or reply) being answered;
+// false when the reply goes out as it is
+bool rateLimit(DNS::RateLimiter::Action action, const uint8_t *message, size_t length, uint8_t rcode,
+               const DNS::Forwarder::Completion &reply) {
+    switch (action) {
+        case DNS::RateLimiter::Action::DROP:
+            DNS::Metrics::add(DNS::Metrics::DROPS_RATE_LIMITED);
+            reply({});
+            return true;
+        case DNS::RateLimiter::Action::SLIP: {
+            // Header and question only, with TC set so real clients retry over TCP
+            thread_local std::vector<uint8_t> slipped;
+            DNS::CreateResponse::errorFromQuery(message, length, rcode, slipped);
+            slipped[2] |= static_cast<uint8_t>(static_cast<uint16_t>(DNS::DnsEnum::ResponseFlags::TRUNCATED) >> 8);
+            reply(slipped);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// Wraps reply so that UDP replies not already checked by resolveQuery (early
+// errors and forwarded replies) pass one rate limit check, classified by what
+// they actually say. exempt is set once the query is parsed: for clients with
+// a valid server cookie, who cannot spoof their address, and for answers from
+// our own zones, checked before they were signed and encoded.
+DNS::Forwarder::Completion rateLimited(DNS::Forwarder::Completion reply, const sockaddr_in &client_addr,
+                                       std::shared_ptr<const bool> exempt) {
+    return [reply = std::move(reply), client_addr, exempt = std::move(exempt)](const std::vector<uint8_t> &dnsResponse) {
+        if (dnsResponse.size() < 12 || *exempt) {
+            reply(dnsResponse);
+            return;
+        }
+        auto responseClass = DNS::RateLimiter::classify(dnsResponse.data(), dnsResponse.size());
+        auto action = DNS::RateLimiter::getInstance().check(client_addr, responseClass);
+        if (!rateLimit(action, dnsResponse.data(), dnsResponse.size(), dnsResponse[3] & 0x0F, reply)) {
+            reply(dnsResponse);
+        }
+    };
+}
+
+// Builds the reply for one query and hands it to reply, either right away or,
+// for forwarded names, from the forwarder thread once the upstream answers.
+// An empty reply means nothing should be sent.
+void resolveQuery(const char *data, size_t length, const sockaddr_in &client_addr, bool streamTransport,
+                  DNS::Forwarder::Completion reply) {
+    std::shared_ptr<bool> rateLimitExempt;
+    if (!streamTransport && DNS::RateLimiter::getInstance().enabled()) {
+        rateLimitExempt = std::make_shared<bool>(false);
+        reply = rateLimited(std::move(reply), client_addr, rateLimitExempt);
+    }
+
+    // A NOTIFY (RFC 1996) only asks a secondary to check its zone soon
+    if (length >= 12 && (data[2] >> 3 & 0x0F) == static_cast<uint8_t>(DNS::DnsEnum::Opcode::NOTIFY)) {
+        thread_local std::vector<uint8_t> acknowledgement;
+        DNS::Secondary::getInstance().notify(reinterpret_cast<const uint8_t *>(data), length, client_addr, acknowledgement);
+        reply(acknowledgement);
+        return;
+    }
+
+    // Unsupported opcodes, classes and meta qtypes are turned away from the raw
+    // bytes, before parsing and without touching the store
+    if (uint8_t rcode = DNS::CreateResponse::screenQuery(reinterpret_cast<const uint8_t *>(data), length)) {
+        thread_local std::vector<uint8_t> refusal;
+        DNS::CreateResponse::errorFromQuery(reinterpret_cast<const uint8_t *>(data), length, rcode, refusal);
+        reply(refusal);
+        return;
+    }
+
     std::vector<uint8_t> dataVector(data, data + length);
-    DnsRequestBody requestBody = DNS::ParseResponse::parseDnsRequest(dataVector);
+    DnsRequestBody requestBody;
+    {
+        DNS::Metrics::StageTimer timer(DNS::Metrics::STAGE_PARSE);
+        requestBody = DNS::ParseResponse::parseDnsRequest(dataVector);
+    }
 
 
-    if (requestBody.transactionID != 0) {
+    if (requestBody.valid) {
 
         std::pmr::list<AnswerSection> answers;
+        std::pmr::list<AnswerSection> authority;
+        std::pmr::list<AnswerSection> additional;
+        size_t maxSize = DNS::CreateResponse::responseSizeLimit(requestBody, streamTransport);
+
+        // DNS Cookies are checked before any lookup: a valid server cookie proves the
+        // client saw one of our replies, so it cannot be spoofed and skips RRL.
+        bool validCookie = false;
+        auto &cookies = DNS::Cookies::getInstance();
+        if (cookies.enabled() && requestBody.hasEdns) {
+            if (requestBody.cookieMalformed) {
+                reply(DNS::CreateResponse::createResponse(static_cast<int>(DNS::DnsEnum::ResponseFlags::RESPONSE_FORMAT_ERROR),
+                                                          {}, requestBody.questionsSection, requestBody, maxSize));
+                return;
+            }
+            if (!requestBody.clientCookie.empty()) {
+                validCookie = cookies.verify(requestBody.clientCookie, requestBody.serverCookie, client_addr);
+                if (rateLimitExempt != nullptr) {
+                    *rateLimitExempt = validCookie;
+                }
+                requestBody.replyEdnsOptions = cookies.replyOption(requestBody.clientCookie, requestBody.serverCookie,
+                                                                   validCookie, client_addr);
+                if (!validCookie && cookies.required() && !streamTransport) {
+                    requestBody.replyExtendedRcode = 1; // BADCOOKIE (23) = extended 1, header 7
+                    uint16_t flags = static_cast<int>(DNS::DnsEnum::ResponseFlags::RESPONSE) | 0x0007;
+                    reply(DNS::CreateResponse::createResponse(flags, {}, requestBody.questionsSection, requestBody, maxSize));
+                    return;
+                }
+            }
+        }
 
         for (auto &question: requestBody.questionsSection) {
-            std::cout << question.query << std::endl;
+            DNS::Metrics::addQueryType(question.type);
             std::string subdomain, mainDomain;
-            DNS::ParseResponse::splitDomain(question.query, subdomain, mainDomain);
-            std::string domainQuery =
-                    "SELECT * FROM dnsrecord_entries WHERE archived = FALSE AND deleted = FALSE AND domain_name = ($1)";
-            pqxx::result domainRecords = db.execute_query(domainQuery, mainDomain);
-
-
-            std::cout << subdomain << std::endl;
-            std::cout << mainDomain << std::endl;
-            //std::cout << domainRecords << std::endl;
-            std::cout << domainRecords.size() << std::endl;
-
-            for (const auto &row: domainRecords) {
-                auto name = row["name"].as<std::string>();
-                auto value = row["value"].as<std::string>();
-                auto type_str = row["type"].as<std::string>();
-                DNS::DnsEnum::QueryType type = DNS::DnsEnum::get_query_type(type_str);
-
-                std::cout << "Name: " << name << ", Value: " << value << ", Type: " << static_cast<int>(type) <<
-                        std::endl;
-                if (subdomain.empty() && name == "@" ) {
-                    answers.push_back(AnswerSection(question.query,type,DNS::DnsEnum::QueryClass::IN,3600,value));
+            // Stores hold names in lowercase; the answers keep the client's spelling
+            DNS::ParseResponse::splitDomain(lowercase(question.query), subdomain, mainDomain);
+            auto queryStart = std::chrono::steady_clock::now();
+            DNS::OwnerLookup found;
+            try {
+                found = recordStore->lookup(mainDomain, subdomain.empty() ? "@" : subdomain);
+            } catch (const std::exception &e) {
+                DNS::Metrics::add(DNS::Metrics::DB_ERRORS);
+                DNS::Logger::warn("record store lookup failed", {{"zone", mainDomain}, {"error", e.what()}});
+                reply(DNS::CreateResponse::createResponse(static_cast<uint16_t>(DNS::DnsEnum::ResponseFlags::RESPONSE_SERVER_FAILURE),
+                                                          {}, requestBody.questionsSection, requestBody, maxSize));
+                return;
+            }
+            auto queryTime = std::chrono::steady_clock::now() - queryStart;
+            DNS::Metrics::add(DNS::Metrics::DB_QUERIES);
+            DNS::Metrics::add(DNS::Metrics::DB_LATENCY_MICROSECONDS,
+                              std::chrono::duration_cast<std::chrono::microseconds>(queryTime).count());
+            DNS::Metrics::record(DNS::Metrics::STAGE_LOOKUP, std::chrono::duration_cast<std::chrono::nanoseconds>(queryTime).count());
+            DNS::Logger::debug("lookup", {{"query", question.query}, {"type", question.type}, {"zone", mainDomain},
+                                          {"rows", found.records.size()}});
+
+            // No records for the zone: we are not authoritative, so relay it upstream
+            auto &forwarder = DNS::Forwarder::getInstance();
+            if (!found.zoneFound && forwarder.enabled() && requestBody.questionsSection.size() == 1) {
+                forwarder.forward(dataVector, maxSize, requestBody.replyEdnsOptions, streamTransport, std::move(reply));
+                return;
+            }
+
+            std::pmr::list<AnswerSection> questionAnswers;
+            std::vector<uint16_t> typesAtOwner;
+            std::string cnameTarget;
+            for (const auto &record: found.records) {
+                DNS::DnsEnum::QueryType type = record.type;
+
+                DNS::Logger::debug("record", {{"name", record.name}, {"value", record.value}, {"type", static_cast<int>(type)}});
+                typesAtOwner.push_back(static_cast<uint16_t>(type));
+
+                // Only the requested RRset, or a CNAME standing in for it
+                if (question.type == static_cast<uint16_t>(type) || question.type == static_cast<uint16_t>(DNS::DnsEnum::QueryType::ANY) ||
+                    type == DNS::DnsEnum::QueryType::CNAME) {
+                    questionAnswers.push_back(answerFor(question.query, record));
                 }
+                if (type == DNS::DnsEnum::QueryType::CNAME && question.type != static_cast<uint16_t>(type) &&
+                    question.type != static_cast<uint16_t>(DNS::DnsEnum::QueryType::ANY)) {
+                    cnameTarget = lowercase(rdataTarget(type, record.rdata));
+                }
+            }
 
-                if (!subdomain.empty() && name == subdomain ) {
-                    answers.push_back(AnswerSection(question.query,type,DNS::DnsEnum::QueryClass::IN,3600,value));
+            // ANY over UDP gets one RRset, the smallest, instead of everything at
+            // the name (RFC 8482); over TLS the client's address is proven and the
+            // full answer cannot be used for amplification
+            if (question.type == static_cast<uint16_t>(DNS::DnsEnum::QueryType::ANY) && !streamTransport) {
+                minimalAny(questionAnswers);
+            }
+
+            auto &dnssec = DNS::Dnssec::getInstance();
+            bool signedZone = found.zoneFound && dnssec.isSigned(mainDomain);
+            if (signedZone && subdomain.empty()) {
+                typesAtOwner.push_back(static_cast<uint16_t>(DNS::DnsEnum::QueryType::DNSKEY));
+                if (question.type == static_cast<uint16_t>(DNS::DnsEnum::QueryType::DNSKEY)) {
+                    dnssec.addDnskey(mainDomain, zoneTtl(found.apex), questionAnswers);
                 }
+            }
 
+            // RRL on the outcome of the lookup, so a limited reply is never signed
+            // or encoded; classified as RateLimiter::classify would the reply
+            if (rateLimitExempt != nullptr && !*rateLimitExempt) {
+                *rateLimitExempt = true;
+                auto responseClass = questionAnswers.empty() ? DNS::RateLimiter::ResponseClass::NXDOMAIN
+                                                             : DNS::RateLimiter::ResponseClass::ANSWER;
+                auto action = DNS::RateLimiter::getInstance().check(client_addr, responseClass);
+                if (rateLimit(action, reinterpret_cast<const uint8_t *>(data), length, 0, reply)) {
+                    return;
+                }
             }
+
+            if (signedZone) {
+                // Signatures, and proof that nothing else exists, only for DO=1 queries
+                if (requestBody.dnssecOk) {
+                    // A zone without an SOA has no negative TTL, so no denial either
+                    auto soa = questionAnswers.empty() ? negativeSoa(mainDomain, found.apex) : std::nullopt;
+                    if (soa) {
+                        authority.push_back(*soa);
+                        dnssec.addDenial(question.query, typesAtOwner, soa->ttl, authority);
+                        dnssec.signSection(mainDomain, authority);
+                    }
+                    dnssec.signSection(mainDomain, questionAnswers);
+                }
+            }
+            answers.splice(answers.end(), questionAnswers);
+            if (!cnameTarget.empty()) {
+                followCname(cnameTarget, question, requestBody.dnssecOk, answers);
+            }
+        }
+
+        uint16_t flags = static_cast<int>(DNS::DnsEnum::ResponseFlags::RESPONSE);
+        addGlue(answers, requestBody.dnssecOk, additional);
+
+
+        std::vector<uint8_t> response;
+        {
+            DNS::Metrics::StageTimer timer(DNS::Metrics::STAGE_ENCODE);
+            response = DNS::CreateResponse::createResponse(flags,answers ,requestBody.questionsSection,requestBody, maxSize, authority,
+                                                           additional);
         }
+        reply(response);
+        return;
+    }
+    DNS::Metrics::add(DNS::Metrics::DROPS_MALFORMED);
+    reply({});
+}
 
-        auto dnsResponse =  DNS::CreateResponse::createResponse(static_cast<int>(DNS::DnsEnum::ResponseFlags::RESPONSE),answers ,requestBody.questionsSection,requestBody);
-        auto& udp = DNS::UDP::getInstance();
-        udp.sendResponse(reinterpret_cast<const char*>(dnsResponse.data()), dnsResponse.size(), MSG_CONFIRM);
+// Per-response counters shared by both transports
+void countResponse(const std::vector<uint8_t> &dnsResponse) {
+    if (dnsResponse.size() < 4) {
+        return;
+    }
+    DNS::Metrics::add(DNS::Metrics::BYTES_OUT, dnsResponse.size());
+    DNS::Metrics::addResponseCode(dnsResponse[3] & 0x0F);
+    if (dnsResponse[2] & 0x02) {
+        DNS::Metrics::add(DNS::Metrics::RESPONSES_TRUNCATED);
     }
 }
 
+std::vector<uint8_t> resolveStreamQuery(const char *data, size_t length, const sockaddr_in &client_addr,
+                                        DNS::Dnstap::Protocol protocol) {
+    std::promise<std::vector<uint8_t>> response;
+    auto future = response.get_future();
+    DNS::Metrics::add(protocol == DNS::Dnstap::DOT ? DNS::Metrics::QUERIES_TLS : DNS::Metrics::QUERIES_TCP);
+    DNS::Metrics::add(DNS::Metrics::BYTES_IN, length);
+    auto &dnstap = DNS::Dnstap::getInstance();
+    bool logged = dnstap.sample();
+    timespec queryTime{};
+    if (logged) {
+        queryTime = DNS::Dnstap::now();
+        dnstap.logQuery(protocol, client_addr, queryTime, reinterpret_cast<const uint8_t *>(data), length);
+    }
+    resolveQuery(data, length, client_addr, true, [&response, logged, queryTime, client_addr, protocol](const std::vector<uint8_t> &dnsResponse) {
+        countResponse(dnsResponse);
+        if (logged && !dnsResponse.empty()) {
+            DNS::Dnstap::getInstance().logResponse(protocol, client_addr, queryTime, dnsResponse.data(), dnsResponse.size());
+        }
+        response.set_value(dnsResponse);
+    });
+    return future.get();
+}
+
+std::vector<uint8_t> resolveTlsQuery(const char *data, size_t length, const sockaddr_in &client_addr) {
+    return resolveStreamQuery(data, length, client_addr, DNS::Dnstap::DOT);
+}
+
+std::vector<uint8_t> resolveTcpQuery(const char *data, size_t length, const sockaddr_in &client_addr) {
+    return resolveStreamQuery(data, length, client_addr, DNS::Dnstap::TCP);
+}
+
+// AXFR and IXFR; every other query goes on to resolveTcpQuery
+bool serveTransfer(const char *data, size_t length, const sockaddr_in &client_addr,
+                   const DNS::TCP::MessageWriter &write) {
+    return DNS::ZoneTransfer::getInstance().serve(reinterpret_cast<const uint8_t *>(data), length, client_addr,
+                                                  [&write](const std::vector<uint8_t> &message) {
+        countResponse(message);
+        return write(message);
+    });
+}
+
+void processData(const char *data, size_t length, const sockaddr_in &client_addr) {
+    DNS::Metrics::add(DNS::Metrics::QUERIES_UDP);
+    DNS::Metrics::add(DNS::Metrics::BYTES_IN, length);
+    auto &dnstap = DNS::Dnstap::getInstance();
+    bool logged = dnstap.sample();
+    timespec queryTime{};
+    if (logged) {
+        queryTime = DNS::Dnstap::now();
+        dnstap.logQuery(DNS::Dnstap::UDP, client_addr, queryTime, reinterpret_cast<const uint8_t *>(data), length);
+    }
+    resolveQuery(data, length, client_addr, false, [client_addr, logged, queryTime](const std::vector<uint8_t> &dnsResponse) {
+        countResponse(dnsResponse);
+        if (!dnsResponse.empty()) {
+            {
+                DNS::Metrics::StageTimer timer(DNS::Metrics::STAGE_SEND);
+                auto& udp = DNS::UDP::getInstance();
+                udp.sendResponseTo(reinterpret_cast<const char*>(dnsResponse.data()), dnsResponse.size(), MSG_CONFIRM, client_addr);
+            }
+            if (logged) {
+                DNS::Dnstap::getInstance().logResponse(DNS::Dnstap::UDP, client_addr, queryTime, dnsResponse.data(), dnsResponse.size());
+            }
+        }
+    });
+}
+
 
 int main() {
+    // A client dropping its TLS connection mid-write must not kill the server.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    auto &config = DNS::Config::getInstance();
+    DNS::Logger::getInstance().setLevel(config.logLevel);
+
+    if (config.backend == "memory") {
+        auto memoryStore = std::make_unique<DNS::MemoryRecordStore>();
+        if (!config.recordsFile.empty() && !memoryStore->loadFile(config.recordsFile, config.defaultTtl)) {
+            exit(EXIT_FAILURE);
+        }
+        std::istringstream zoneFiles(config.zoneFiles);
+        std::string entry;
+        while (std::getline(zoneFiles, entry, ',')) {
+            size_t equals = entry.find('=');
+            bool loaded = equals == std::string::npos
+                              ? memoryStore->loadZoneFile(entry)
+                              : memoryStore->loadZoneFile(entry.substr(equals + 1), entry.substr(0, equals));
+            if (!loaded) {
+                exit(EXIT_FAILURE);
+            }
+        }
+        recordStore = std::move(memoryStore);
+    } else if (config.backend == "image") {
+        auto imageStore = std::make_unique<DNS::ImageRecordStore>();
+        if (!imageStore->load(config.imageFile)) {
+            exit(EXIT_FAILURE);
+        }
+        if (config.imageReloadSeconds > 0) {
+            imageStore->watch(config.imageReloadSeconds);
+        }
+        recordStore = std::move(imageStore);
+    } else if (config.backend == "secondary") {
+        auto memoryStore = std::make_unique<DNS::MemoryRecordStore>();
+        auto &secondary = DNS::Secondary::getInstance();
+        if (!secondary.setPrimary(config.primary) || config.secondaryZones.empty()) {
+            std::cerr << "The secondary backend needs DNS_PRIMARY and DNS_SECONDARY_ZONES" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        secondary.setStore(memoryStore.get());
+        secondary.setZones(config.secondaryZones);
+        secondary.setStateDirectory(config.secondaryStateDirectory);
+        secondary.setJournalSize(config.ixfrJournalSize);
+        secondary.start();
+        std::cout << "Secondary for " << config.secondaryZones << " from " << config.primary << '\n';
+        recordStore = std::move(memoryStore);
+    } else {
+        recordStore = std::make_unique<postegre::PostgresStore>(config.dbConnection, config.defaultTtl);
+    }
+    bool faultsInjected = config.faultLatencyMs > 0 || config.faultJitterMs > 0 || config.faultErrorPercent > 0;
+    if (faultsInjected) {
+        recordStore = std::make_unique<DNS::FaultInjectingStore>(std::move(recordStore), config.faultLatencyMs,
+                                                                 config.faultJitterMs, config.faultErrorPercent);
+    }
+    // The in-process backends answer from memory; only a remote one needs the cache
+    bool remoteBackend = config.backend != "memory" && config.backend != "image" && config.backend != "secondary";
+    if (config.recordCacheTtl > 0 && (remoteBackend || faultsInjected)) {
+        auto cachingStore = std::make_unique<DNS::CachingStore>(std::move(recordStore));
+        cachingStore->setMaxTtl(config.recordCacheTtl);
+        cachingStore->setMaxEntries(config.recordCacheSize);
+        cachingStore->setPrefetchHits(config.prefetchHits);
+        cachingStore->setStaleWindow(config.staleWindowSeconds);
+        cachingStore->setStaleTtl(config.staleTtl);
+        cachingStore->setDeadline(config.backendDeadlineMs);
+        cachingStore->setBreaker(config.breakerFailures, config.breakerCooldownSeconds);
+        cachingStore->start(4);
+        recordStore = std::move(cachingStore);
+    }
+    std::cout << "Records from the " << recordStore->name() << " backend" << '\n';
+    DNS::CreateResponse::setMaxUdpPayload(config.ednsMaxUdpPayload);
+
+    if (config.tlsEnabled()) {
+        auto &tlsSoc = DNS::TLS::getInstance();
+        tlsSoc.setPort(config.tlsPort);
+        tlsSoc.setMaxConnections(config.tlsMaxConnections);
+        tlsSoc.setIdleTimeout(config.tlsIdleTimeoutSeconds);
+        tlsSoc.setKtls(config.tlsKtls);
+        tlsSoc.loadCertificate(config.tlsCertFile, config.tlsKeyFile);
+        tlsSoc.bindTls();
+        tlsSoc.setQueryHandler(resolveTlsQuery);
+        std::thread([&tlsSoc] { tlsSoc.listenForConnections(); }).detach();
+        std::cout << "Tls socket listening on port " << config.tlsPort << '\n';
+    }
+
+    auto &transfers = DNS::ZoneTransfer::getInstance();
+    transfers.setStore(recordStore.get());
+    transfers.setAllowed(config.xfrAllow);
+    transfers.setMaxTransfers(config.xfrMaxTransfers);
+    transfers.setJournalSize(config.ixfrJournalSize);
+    transfers.setNotifyTargets(config.notifyTargets);
+    if (config.ixfrPollSeconds > 0) {
+        transfers.start(config.ixfrPollSeconds);
+    }
+
+    auto &tcpSoc = DNS::TCP::getInstance();
+    tcpSoc.setPort(config.port);
+    tcpSoc.setMaxConnections(config.tcpMaxConnections);
+    tcpSoc.setIdleTimeout(config.tcpIdleTimeoutSeconds);
+    tcpSoc.bindTcp();
+    tcpSoc.setQueryHandler(resolveTcpQuery);
+    tcpSoc.setStreamHandler(serveTransfer);
+    std::thread([&tcpSoc] { tcpSoc.listenForConnections(); }).detach();
+    std::cout << "Tcp socket listening on port " << config.port << '\n';
+
+    if (!config.forwarders.empty()) {
+        auto &forwarder = DNS::Forwarder::getInstance();
+        forwarder.setUpstreams(config.forwarders);
+        forwarder.setTimeout(config.forwardTimeoutMs);
+        forwarder.setRetries(config.forwardRetries);
+        forwarder.setCacheSize(config.forwardCacheSize);
+        forwarder.start(config.forwardSockets);
+        std::cout << "Forwarding to " << config.forwarders << '\n';
+    }
+
+    if (config.rrlRate != 0 || config.rrlNxdomainRate != 0 || config.rrlErrorRate != 0) {
+        auto &rrl = DNS::RateLimiter::getInstance();
+        rrl.setRates(config.rrlRate, config.rrlNxdomainRate, config.rrlErrorRate);
+        rrl.setBurst(config.rrlBurst);
+        rrl.setSlip(config.rrlSlip);
+        rrl.setLeak(config.rrlLeak);
+        rrl.setPrefixLengths(config.rrlIpv4Prefix, config.rrlIpv6Prefix);
+        rrl.setTableSize(config.rrlTableSize);
+        std::cout << "Response rate limiting at " << config.rrlRate << " responses/s per network" << '\n';
+    }
+
+    if (config.cookieMode != "off") {
+        auto &cookies = DNS::Cookies::getInstance();
+        cookies.setEnabled(true);
+        cookies.setRequired(config.cookieMode == "required");
+        cookies.setSecret(config.cookieSecret);
+        cookies.setRotationInterval(config.cookieRotationSeconds);
+    }
+
+    if (!config.dnssecKeyDirectory.empty()) {
+        auto &dnssec = DNS::Dnssec::getInstance();
+        dnssec.setKeyDirectory(config.dnssecKeyDirectory);
+        dnssec.setAlgorithm(config.dnssecAlgorithm);
+        dnssec.setGenerateKeys(config.dnssecGenerateKeys);
+        dnssec.setValidity(config.dnssecValidity);
+        dnssec.setZoneSource([] { return recordStore->zoneNames(); });
+        if (!remoteBackend) {
+            // Zones held in memory are signed whole as they are loaded or replaced
+            dnssec.setRecordSource([](const std::string &zone) { return recordStore->zoneRecords(zone); });
+            recordStore->setZoneListener([](const std::string &zone) { DNS::Dnssec::getInstance().zoneChanged(zone); });
+        }
+        dnssec.start();
+        std::cout << "DNSSEC keys from " << config.dnssecKeyDirectory << '\n';
+    }
+
+    if (!config.metricsAddress.empty()) {
+        auto &metrics = DNS::Metrics::getInstance();
+        metrics.addCollector([](std::ostringstream &out) {
+            out << "# HELP dns_tls_connections Open DNS-over-TLS connections.\n# TYPE dns_tls_connections gauge\n";
+            out << "dns_tls_connections " << DNS::TLS::getInstance().getActiveConnections() << '\n';
+            out << "# HELP dns_tcp_connections Open DNS-over-TCP connections.\n# TYPE dns_tcp_connections gauge\n";
+            out << "dns_tcp_connections " << DNS::TCP::getInstance().getActiveConnections() << '\n';
+            out << "# HELP dns_zone_transfers_active Zone transfers in progress.\n# TYPE dns_zone_transfers_active gauge\n";
+            out << "dns_zone_transfers_active " << DNS::ZoneTransfer::getInstance().activeTransfers() << '\n';
+            out << "# HELP dns_rrl_limited_total Responses dropped or slipped by rate limiting.\n# TYPE dns_rrl_limited_total counter\n";
+            out << "dns_rrl_limited_total " << DNS::RateLimiter::getInstance().getLimited() << '\n';
+            out << "# HELP dns_dnssec_signatures_total Signatures created.\n# TYPE dns_dnssec_signatures_total counter\n";
+            out << "dns_dnssec_signatures_total " << DNS::Dnssec::getInstance().signaturesCreated() << '\n';
+        });
+        metrics.startServer(config.metricsAddress);
+        std::cout << "Metrics on " << config.metricsAddress << '\n';
+    }
+
+    if (!config.dnstapOutput.empty()) {
+        auto &dnstap = DNS::Dnstap::getInstance();
+        dnstap.setSampleRate(config.dnstapSampleRate);
+        dnstap.setIdentity(config.dnstapIdentity);
+        dnstap.start(config.dnstapOutput);
+        std::cout << "dnstap log to " << config.dnstapOutput << '\n';
+    }
+
     auto &udpSoc = DNS::UDP::getInstance();
-    udpSoc.setPort(PORT);
+    udpSoc.setPort(config.port);
     udpSoc.setMaxLine(MAXLINE);
     udpSoc.bindUdp();
     std::cout << "Udp socket bound" << '\n';
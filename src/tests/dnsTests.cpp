@@ -0,0 +1,247 @@
+// dns-tests: checks of the pieces that are easy to get subtly wrong and hard to
+// notice from the outside. Run by ctest; the exit status is the failure count.
+//
+//  - RData::encode/toText round trips for every row of RRTypes::TYPES, the
+//    RFC 3597 generic form, escapes, the 255-byte string limit and the NSEC
+//    type bitmap
+//  - the master file loader (ZoneFile)
+//  - the RFC 9018 appendix A server cookie vectors (A.1 to A.3)
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "../header/cookie.h"
+#include "../header/rdata.h"
+#include "../database/zoneFile.h"
+
+namespace {
+
+    int failures = 0;
+
+    void check(bool ok, const std::string &what) {
+        if (!ok) {
+            std::cerr << "FAIL " << what << '\n';
+            failures++;
+        }
+    }
+
+    std::string hex(const uint8_t *data, size_t length) {
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        for (size_t i = 0; i < length; i++) {
+            out.push_back(digits[data[i] >> 4]);
+            out.push_back(digits[data[i] & 0x0F]);
+        }
+        return out;
+    }
+
+    std::vector<uint8_t> unhex(const std::string &text) {
+        std::vector<uint8_t> out;
+        for (size_t i = 0; i + 1 < text.size(); i += 2) {
+            out.push_back(static_cast<uint8_t>(std::stoul(text.substr(i, 2), nullptr, 16)));
+        }
+        return out;
+    }
+
+    // Encodes text, prints it back and encodes that again: the text must come
+    // back as expected and both encodings must be the same bytes
+    void roundTrip(DNS::DnsEnum::QueryType type, const std::string &text, const std::string &expected) {
+        std::string what = std::string(DNS::RRTypes::mnemonic(static_cast<uint16_t>(type))) + " '" + text + "'";
+        try {
+            std::vector<uint8_t> wire = DNS::RData::encode(type, text);
+            std::string printed = DNS::RData::toText(static_cast<uint16_t>(type), wire);
+            check(printed == expected, what + " printed as '" + printed + "'");
+            check(DNS::RData::encode(type, printed) == wire, what + " re-encodes differently");
+        } catch (const std::exception &e) {
+            check(false, what + ": " + e.what());
+        }
+    }
+
+    void rejects(DNS::DnsEnum::QueryType type, const std::string &text) {
+        try {
+            DNS::RData::encode(type, text);
+            check(false, std::string(DNS::RRTypes::mnemonic(static_cast<uint16_t>(type))) + " accepted '" + text + "'");
+        } catch (const DNS::RData::Error &) {
+        }
+    }
+
+    void rdataTests() {
+        using Type = DNS::DnsEnum::QueryType;
+        struct Row {
+            Type type;
+            std::string text;
+            std::string expected;
+        };
+        const Row rows[] = {
+            {Type::A, "192.0.2.1", "192.0.2.1"},
+            {Type::NS, "ns1.example.com.", "ns1.example.com."},
+            {Type::CNAME, "www.example.com", "www.example.com."},
+            {Type::SOA, "ns1.example.com. hostmaster.example.com. 2024010101 1h 600 86400 300",
+             "ns1.example.com. hostmaster.example.com. 2024010101 3600 600 86400 300"},
+            {Type::PTR, "host.example.com.", "host.example.com."},
+            {Type::MX, "10 mail.example.com.", "10 mail.example.com."},
+            {Type::TXT, "v=spf1 -all", "\"v=spf1 -all\""},
+            {Type::AAAA, "2001:db8::1", "2001:db8::1"},
+            {Type::SRV, "0 5 5060 sip.example.com.", "0 5 5060 sip.example.com."},
+            {Type::NAPTR, "100 10 \"u\" \"E2U+sip\" \"!^.*$!sip:info@example.com!\" .",
+             "100 10 \"u\" \"E2U+sip\" \"!^.*$!sip:info@example.com!\" ."},
+            {Type::CERT, "PKIX 0 RSASHA256 AQIDBA==", "1 0 8 AQIDBA=="},
+            {Type::DNAME, "example.net.", "example.net."},
+            {Type::DS, "60485 5 1 2BB183AF5F22588179A53B0A98631FAD1A292118",
+             "60485 5 1 2BB183AF5F22588179A53B0A98631FAD1A292118"},
+            {Type::RRSIG, "A 13 3 300 20240101000000 20231201000000 12345 example.com. AQIDBA==",
+             "A 13 3 300 20240101000000 20231201000000 12345 example.com. AQIDBA=="},
+            {Type::NSEC, "host.example.com. A MX RRSIG NSEC TYPE1234", "host.example.com. A MX RRSIG NSEC TYPE1234"},
+            {Type::DNSKEY, "257 3 13 AQIDBA==", "257 3 13 AQIDBA=="},
+            {Type::CAA, "0 issue \"ca.example.net\"", "0 \"issue\" \"ca.example.net\""},
+        };
+
+        // Every type with rdata of its own has a row above
+        for (const auto &info: DNS::RRTypes::TYPES) {
+            bool covered = info.meta;
+            for (const auto &row: rows) {
+                covered = covered || row.type == info.type;
+            }
+            check(covered, std::string("no round trip for ") + std::string(info.mnemonic));
+        }
+        for (const auto &row: rows) {
+            roundTrip(row.type, row.text, row.expected);
+        }
+
+        // Old rows without an MX preference get 10
+        roundTrip(Type::MX, "mail.example.com.", "10 mail.example.com.");
+
+        // RFC 3597 generic form, for a known type and as the printed form of none
+        roundTrip(Type::A, "\\# 4 C0000201", "192.0.2.1");
+        check(DNS::RData::encode(Type::A, "\\# 4 C0000201") == unhex("c0000201"), "generic A bytes");
+        rejects(Type::A, "\\# 5 C0000201");
+
+        // Escapes: \" \\ and \DDD inside quoted strings
+        roundTrip(Type::TXT, "\"hello world\" \"a\\\"b\\\\c\\065\"", "\"hello world\" \"a\\\"b\\\\cA\"");
+        check(DNS::RData::encode(Type::TXT, "\"a\\\"b\\\\c\\065\"") == std::vector<uint8_t>{6, 'a', '"', 'b', '\\', 'c', 'A'},
+              "TXT escapes on the wire");
+
+        // A character string holds at most 255 bytes
+        std::string longest(255, 'x');
+        check(DNS::RData::encode(Type::TXT, "\"" + longest + "\"").size() == 256, "255-byte TXT string");
+        rejects(Type::TXT, "\"" + longest + "y\"");
+
+        // NSEC type bitmap (RFC 4034 section 4.1.2): window 0 with A, MX, RRSIG
+        // and NSEC, then window 4 for TYPE1234
+        auto nsec = DNS::RData::encode(Type::NSEC, "host.example.com. A MX RRSIG NSEC TYPE1234");
+        std::vector<uint8_t> bitmap(nsec.end() - 37, nsec.end());
+        check(hex(bitmap.data(), bitmap.size()) ==
+              "0006400100000003" "041b" + std::string(52, '0') + "20",
+              "NSEC bitmap " + hex(bitmap.data(), bitmap.size()));
+
+        rejects(Type::A, "300.1.1.1");
+        rejects(Type::AAAA, "2001:db8::g");
+        rejects(Type::MX, "70000 mail.example.com.");
+    }
+
+    void zoneFileTests() {
+        auto path = std::filesystem::temp_directory_path() / ("dns-tests-" + std::to_string(getpid()) + ".zone");
+        {
+            std::ofstream file(path);
+            file << "$ORIGIN Example.COM.\n"
+                    "$TTL 1h\n"
+                    "@   IN SOA ns1 hostmaster ( 2024010101 ; serial\n"
+                    "        3600 600 86400 300 )\n"
+                    "    NS ns1\n"
+                    "ns1 A 192.0.2.1\n"
+                    "WWW 300 IN A 192.0.2.2\n"
+                    "    AAAA 2001:db8::2 ; same owner as the line above\n"
+                    "txt TXT \"semi;colon\" \"paren(\"\n"
+                    "other.example.net. A 192.0.2.3\n";
+        }
+        std::string zone;
+        std::vector<DNS::ZoneRecord> records;
+        bool loaded = DNS::ZoneFile::load(path, zone, records);
+        check(loaded, "zone file loads");
+        check(zone == "example.com", "zone name from $ORIGIN, lowercased: " + zone);
+
+        auto find = [&records](const std::string &name, DNS::DnsEnum::QueryType type) -> const DNS::ZoneRecord * {
+            for (const auto &record: records) {
+                if (record.name == name && record.type == type) {
+                    return &record;
+                }
+            }
+            return nullptr;
+        };
+        using Type = DNS::DnsEnum::QueryType;
+        check(records.size() == 6, "six records in the zone, the out-of-zone one skipped: " + std::to_string(records.size()));
+        const auto *soa = find("@", Type::SOA);
+        check(soa != nullptr && soa->ttl == 3600 &&
+              DNS::RData::toText(6, soa->rdata) == "ns1.example.com. hostmaster.example.com. 2024010101 3600 600 86400 300",
+              "SOA across parentheses with a comment");
+        check(find("@", Type::NS) != nullptr, "blank owner continues the apex");
+        const auto *www = find("www", Type::A);
+        check(www != nullptr && www->ttl == 300, "explicit TTL and lowercased owner");
+        const auto *aaaa = find("www", Type::AAAA);
+        check(aaaa != nullptr && aaaa->ttl == 3600, "blank owner continues www with the $TTL default");
+        const auto *txt = find("txt", Type::TXT);
+        check(txt != nullptr && DNS::RData::toText(16, txt->rdata) == "\"semi;colon\" \"paren(\"",
+              "quoted ; and ( are text");
+
+        {
+            std::ofstream file(path);
+            file << "$ORIGIN example.com.\n@ 3600 SOA ns1 hostmaster 1 2 3 4 5\nbad A 192.0.2\n";
+        }
+        zone.clear();
+        records.clear();
+        check(!DNS::ZoneFile::load(path, zone, records), "an invalid entry fails the load");
+        std::filesystem::remove(path);
+    }
+
+    void cookieTests() {
+        struct Vector {
+            const char *secret;
+            const char *clientCookie;
+            const char *address;
+            uint32_t timestamp;
+            const char *serverCookie;
+        };
+        // RFC 9018 appendix A.1 to A.3: a first cookie, its renewal, a second client
+        const Vector vectors[] = {
+            {"e5e973e5a6b2a43f48e7dc849e37bfcf", "2464c4abcf10c957", "198.51.100.100", 1559731985,
+             "010000005cf79f111f8130c3eee29480"},
+            {"e5e973e5a6b2a43f48e7dc849e37bfcf", "2464c4abcf10c957", "198.51.100.100", 1559734385,
+             "010000005cf7a871d4a564a1442aca77"},
+            {"e5e973e5a6b2a43f48e7dc849e37bfcf", "fc93fc62807ddb86", "203.0.113.203", 1559734700,
+             "010000005cf7a9acf73a7810aca2381e"},
+        };
+        for (const auto &vector: vectors) {
+            std::vector<uint8_t> key = unhex(vector.secret);
+            std::vector<uint8_t> clientCookie = unhex(vector.clientCookie);
+            sockaddr_in client{};
+            client.sin_family = AF_INET;
+            inet_pton(AF_INET, vector.address, &client.sin_addr);
+            uint8_t cookie[DNS::Cookies::SERVER_COOKIE_SIZE] = {1, 0, 0, 0,
+                                                                static_cast<uint8_t>(vector.timestamp >> 24),
+                                                                static_cast<uint8_t>(vector.timestamp >> 16),
+                                                                static_cast<uint8_t>(vector.timestamp >> 8),
+                                                                static_cast<uint8_t>(vector.timestamp)};
+            DNS::Cookies::computeHash(clientCookie.data(), cookie, client, key.data(), cookie + 8);
+            std::string made = hex(cookie, sizeof(cookie));
+            check(made == vector.serverCookie, std::string("server cookie for ") + vector.address + " at " +
+                                               std::to_string(vector.timestamp) + ": " + made);
+        }
+    }
+
+}
+
+int main() {
+    rdataTests();
+    zoneFileTests();
+    cookieTests();
+    if (failures == 0) {
+        std::cout << "All tests passed\n";
+    }
+    return failures;
+}
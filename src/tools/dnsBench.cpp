@@ -0,0 +1,387 @@
+// dns-bench: UDP load generator for the server, in the spirit of dnsperf.
+//
+// Queries come from a file ("name type" per line, replayed in order) or are
+// generated: names drawn from a Zipf distribution over --names hosts of --zone,
+// a --nxdomain share of random names that do not exist, and qtypes from --mix.
+// Every thread owns a connected socket, sends in sendmmsg batches either as fast
+// as it can (--qps 0) or paced to its share of --qps, and a paired receiver
+// thread matches replies by transaction ID to measure latency.
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <netinet/in.h>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../header/dns.h"
+#include "../header/dnsEnum.h"
+#include "../header/metrics.h"
+#include "../header/rrTypes.h"
+
+namespace {
+
+    struct Options {
+        std::string server = "127.0.0.1";
+        int port = 53;
+        int threads = 2;
+        long qps = 0;
+        int duration = 10;
+        int timeoutMs = 1000;
+        int batch = 32;
+        std::string queryFile;
+        std::string zone = "example.com";
+        int names = 10000;
+        double zipf = 1.0;
+        double nxdomain = 0.0;
+        std::string mix = "A:80,AAAA:15,MX:5";
+    };
+
+    struct Query {
+        std::string name;
+        uint16_t type;
+    };
+
+    using Histogram = std::vector<uint64_t>;
+
+    struct alignas(64) ThreadStats {
+        uint64_t sent = 0;
+        uint64_t received = 0;
+        uint64_t late = 0;
+        uint64_t rcodes[16] = {};
+        Histogram latency = Histogram(DNS::Metrics::HISTOGRAM_BUCKETS, 0);
+    };
+
+    void usage() {
+        std::cerr << "usage: dns-bench [--server 127.x.x.x] [--port n] [--threads n] [--qps n (0 = unpaced)]\n"
+                     "                 [--duration s] [--timeout-ms n] [--batch n]\n"
+                     "                 [--queries file] | [--zone name] [--names n] [--zipf s]\n"
+                     "                 [--nxdomain ratio] [--mix A:80,AAAA:15,MX:5]\n";
+    }
+
+    // The tools put real load on what they point at, so they only aim at this host
+    bool loopback(const std::string &address) {
+        in_addr parsed{};
+        if (inet_pton(AF_INET, address.c_str(), &parsed) != 1 || (ntohl(parsed.s_addr) >> 24) != 127) {
+            std::cerr << "--server must be a loopback address (127.0.0.0/8): " << address << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool parseOptions(int argc, char **argv, Options &options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            std::string value = argv[++i];
+            try {
+                if (arg == "--server") options.server = value;
+                else if (arg == "--port") options.port = std::stoi(value);
+                else if (arg == "--threads") options.threads = std::max(1, std::stoi(value));
+                else if (arg == "--qps") options.qps = std::stol(value);
+                else if (arg == "--duration") options.duration = std::stoi(value);
+                else if (arg == "--timeout-ms") options.timeoutMs = std::stoi(value);
+                else if (arg == "--batch") options.batch = std::clamp(std::stoi(value), 1, 1024);
+                else if (arg == "--queries") options.queryFile = value;
+                else if (arg == "--zone") options.zone = value;
+                else if (arg == "--names") options.names = std::max(1, std::stoi(value));
+                else if (arg == "--zipf") options.zipf = std::stod(value);
+                else if (arg == "--nxdomain") options.nxdomain = std::stod(value);
+                else if (arg == "--mix") options.mix = value;
+                else return false;
+            } catch (const std::logic_error &) {
+                std::cerr << "bad value for " << arg << ": " << value << std::endl;
+                return false;
+            }
+        }
+        return loopback(options.server);
+    }
+
+    // Mnemonic or TYPEnnn; unknown types are sent as ANY
+    uint16_t queryType(const std::string &text) {
+        auto type = DNS::RRTypes::typeCode(text);
+        if (!type) {
+            std::cerr << "unknown type " << text << ", sending ANY" << std::endl;
+            return static_cast<uint16_t>(DNS::DnsEnum::QueryType::ANY);
+        }
+        return *type;
+    }
+
+    std::vector<Query> loadQueries(const std::string &path) {
+        std::vector<Query> queries;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            std::string name, type = "A";
+            if (!(fields >> name) || name[0] == '#') {
+                continue;
+            }
+            fields >> type;
+            queries.push_back({name, queryType(type)});
+        }
+        return queries;
+    }
+
+    // Builds the generated query set: one slot per name rank, plus the qtype mix
+    class Generator {
+    public:
+        Generator(const Options &options, uint64_t seed) : options(options), random(seed), uniform(0.0, 1.0) {
+            double total = 0;
+            for (int rank = 1; rank <= options.names; rank++) {
+                total += 1.0 / std::pow(rank, options.zipf);
+                cdf.push_back(total);
+            }
+            for (auto &value: cdf) {
+                value /= total;
+            }
+
+            std::istringstream entries(options.mix);
+            std::string entry;
+            double weightTotal = 0;
+            while (std::getline(entries, entry, ',')) {
+                size_t colon = entry.find(':');
+                std::string type = entry.substr(0, colon);
+                double weight = colon == std::string::npos ? 1 : std::stod(entry.substr(colon + 1));
+                weightTotal += weight;
+                types.push_back(queryType(type));
+                typeCdf.push_back(weightTotal);
+            }
+            for (auto &value: typeCdf) {
+                value /= weightTotal;
+            }
+        }
+
+        Query next() {
+            uint16_t type = types[std::lower_bound(typeCdf.begin(), typeCdf.end(), uniform(random)) - typeCdf.begin()];
+            if (uniform(random) < options.nxdomain) {
+                return {"nx" + std::to_string(random()) + "." + options.zone, type};
+            }
+            size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(random)) - cdf.begin();
+            return {"host" + std::to_string(rank) + "." + options.zone, type};
+        }
+
+    private:
+        const Options &options;
+        std::mt19937_64 random;
+        std::uniform_real_distribution<double> uniform;
+        std::vector<double> cdf;
+        std::vector<uint16_t> types;
+        std::vector<double> typeCdf;
+    };
+
+    void encodeQuery(std::vector<uint8_t> &packet, uint16_t id, const Query &query) {
+        packet = {static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id & 0xFF), 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0};
+        auto name = DNS::CreateResponse::domainToDnsFormat(query.name);
+        packet.insert(packet.end(), name.begin(), name.end());
+        packet.push_back(query.type >> 8);
+        packet.push_back(query.type & 0xFF);
+        packet.push_back(0);
+        packet.push_back(1);
+    }
+
+    int64_t nowNanoseconds() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Send times indexed by transaction ID; 0 means no query outstanding
+    using SendTimes = std::vector<std::atomic<int64_t>>;
+
+    void receiveLoop(int fd, SendTimes &sendTimes, ThreadStats &stats, const std::atomic<bool> &stop, int timeoutMs) {
+        constexpr int BATCH = 64;
+        std::vector<std::vector<uint8_t>> buffers(BATCH, std::vector<uint8_t>(4096));
+        std::vector<iovec> iovecs(BATCH);
+        std::vector<mmsghdr> messages(BATCH);
+        timeval timeout{0, 100000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        while (!stop.load(std::memory_order_relaxed)) {
+            for (int i = 0; i < BATCH; i++) {
+                iovecs[i] = {buffers[i].data(), buffers[i].size()};
+                messages[i] = {};
+                messages[i].msg_hdr.msg_iov = &iovecs[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            int count = recvmmsg(fd, messages.data(), BATCH, MSG_WAITFORONE, nullptr);
+            int64_t now = nowNanoseconds();
+            for (int i = 0; i < count; i++) {
+                if (messages[i].msg_len < 12) {
+                    continue;
+                }
+                const uint8_t *reply = buffers[i].data();
+                uint16_t id = (reply[0] << 8) | reply[1];
+                int64_t sentAt = sendTimes[id].exchange(0, std::memory_order_relaxed);
+                if (sentAt == 0) {
+                    continue;
+                }
+                int64_t latency = now - sentAt;
+                if (latency > static_cast<int64_t>(timeoutMs) * 1000000) {
+                    stats.late++;
+                    continue;
+                }
+                stats.received++;
+                stats.rcodes[reply[3] & 0x0F]++;
+                stats.latency[DNS::Metrics::bucketIndex(latency)]++;
+            }
+        }
+    }
+
+    void sendLoop(const Options &options, const std::vector<Query> &replay, int threadIndex, ThreadStats &stats) {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in server{};
+        server.sin_family = AF_INET;
+        server.sin_port = htons(options.port);
+        if (fd < 0 || inet_pton(AF_INET, options.server.c_str(), &server.sin_addr) != 1 ||
+            connect(fd, (const struct sockaddr *)&server, sizeof(server)) < 0) {
+            perror("socket setup failed");
+            exit(EXIT_FAILURE);
+        }
+        int bufferSize = 8 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+        SendTimes sendTimes(65536);
+        std::atomic<bool> stop(false);
+        std::thread receiver(receiveLoop, fd, std::ref(sendTimes), std::ref(stats), std::cref(stop), options.timeoutMs);
+
+        Generator generator(options, 0x9E3779B97F4A7C15ULL * (threadIndex + 1));
+        size_t replayPosition = threadIndex;
+        uint16_t nextId = static_cast<uint16_t>(threadIndex * 7919);
+        double perThreadRate = options.qps > 0 ? static_cast<double>(options.qps) / options.threads : 0;
+
+        std::vector<std::vector<uint8_t>> packets(options.batch);
+        std::vector<iovec> iovecs(options.batch);
+        std::vector<mmsghdr> messages(options.batch);
+        int64_t start = nowNanoseconds();
+        int64_t end = start + static_cast<int64_t>(options.duration) * 1000000000;
+        while (true) {
+            int64_t now = nowNanoseconds();
+            if (now >= end) {
+                break;
+            }
+            if (perThreadRate > 0) {
+                int64_t due = start + static_cast<int64_t>(stats.sent / perThreadRate * 1e9);
+                if (due > now) {
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(std::min<int64_t>(due - now, 1000000)));
+                    continue;
+                }
+            }
+
+            for (int i = 0; i < options.batch; i++) {
+                Query query = replay.empty() ? generator.next() : replay[replayPosition++ % replay.size()];
+                encodeQuery(packets[i], nextId + i, query);
+                iovecs[i] = {packets[i].data(), packets[i].size()};
+                messages[i] = {};
+                messages[i].msg_hdr.msg_iov = &iovecs[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            int64_t sentAt = nowNanoseconds();
+            for (int i = 0; i < options.batch; i++) {
+                // An ID still outstanding from 65536 queries ago is counted as lost
+                sendTimes[static_cast<uint16_t>(nextId + i)].store(sentAt, std::memory_order_relaxed);
+            }
+            int sent = sendmmsg(fd, messages.data(), options.batch, 0);
+            if (sent < 0) {
+                sent = 0;
+            }
+            for (int i = sent; i < options.batch; i++) {
+                sendTimes[static_cast<uint16_t>(nextId + i)].store(0, std::memory_order_relaxed);
+            }
+            nextId += sent;
+            stats.sent += sent;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.timeoutMs));
+        stop.store(true);
+        receiver.join();
+        close(fd);
+    }
+
+    double quantile(const Histogram &histogram, uint64_t count, double q) {
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < histogram.size(); i++) {
+            seen += histogram[i];
+            if (seen >= rank) {
+                return DNS::Metrics::bucketValue(static_cast<int>(i)) / 1e6;
+            }
+        }
+        return 0;
+    }
+
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+    std::vector<Query> replay;
+    if (!options.queryFile.empty()) {
+        replay = loadQueries(options.queryFile);
+        if (replay.empty()) {
+            std::cerr << "no queries in " << options.queryFile << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<ThreadStats> stats(options.threads);
+    std::vector<std::thread> senders;
+    for (int i = 0; i < options.threads; i++) {
+        senders.emplace_back(sendLoop, std::cref(options), std::cref(replay), i, std::ref(stats[i]));
+    }
+    for (auto &sender: senders) {
+        sender.join();
+    }
+
+    ThreadStats total;
+    for (const auto &threadStats: stats) {
+        total.sent += threadStats.sent;
+        total.received += threadStats.received;
+        total.late += threadStats.late;
+        for (int i = 0; i < 16; i++) {
+            total.rcodes[i] += threadStats.rcodes[i];
+        }
+        for (size_t i = 0; i < total.latency.size(); i++) {
+            total.latency[i] += threadStats.latency[i];
+        }
+    }
+
+    static const char *rcodeNames[16] = {"NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN", "NOTIMP", "REFUSED",
+                                         "YXDOMAIN", "YXRRSET", "NXRRSET", "NOTAUTH", "NOTZONE", "11", "12", "13",
+                                         "14", "15"};
+    uint64_t lost = total.sent - total.received;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Queries sent:      " << total.sent << " (" << total.sent / static_cast<double>(options.duration) << " qps)\n";
+    std::cout << "Queries answered:  " << total.received << " (" << total.received / static_cast<double>(options.duration) << " qps)\n";
+    std::cout << "Queries lost:      " << lost << " (" << (total.sent ? 100.0 * lost / total.sent : 0) << "%, "
+              << total.late << " answered after the timeout)\n";
+    for (int i = 0; i < 16; i++) {
+        if (total.rcodes[i] != 0) {
+            std::cout << "  " << std::left << std::setw(16) << rcodeNames[i] << total.rcodes[i] << '\n';
+        }
+    }
+    if (total.received != 0) {
+        std::cout << "Latency (ms):      p50 " << quantile(total.latency, total.received, 0.5)
+                  << "  p90 " << quantile(total.latency, total.received, 0.9)
+                  << "  p99 " << quantile(total.latency, total.received, 0.99)
+                  << "  p99.9 " << quantile(total.latency, total.received, 0.999)
+                  << "  max " << quantile(total.latency, total.received, 1.0) << '\n';
+    }
+    return 0;
+}
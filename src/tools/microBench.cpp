@@ -0,0 +1,147 @@
+// Microbenchmarks for the wire parser and encoder (Google Benchmark).
+//
+// The corpus mirrors what the server sees in practice: short plain queries,
+// dig-style EDNS0 queries carrying a COOKIE option, long service names and a
+// truncated packet. Besides ns/op every benchmark reports allocs/op, counted
+// by the global operator new below.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../header/dns.h"
+#include "../header/dnsEnum.h"
+#include "../header/dnsRequestBody.h"
+#include "../header/rdata.h"
+
+namespace {
+    std::atomic<uint64_t> allocations{0};
+}
+
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+    // Runs the timed loop and attaches the allocation count per iteration
+    template<typename Body>
+    void measure(benchmark::State &state, Body body) {
+        uint64_t before = allocations.load(std::memory_order_relaxed);
+        for (auto _: state) {
+            body();
+        }
+        state.counters["allocs/op"] = benchmark::Counter(
+                static_cast<double>(allocations.load(std::memory_order_relaxed) - before),
+                benchmark::Counter::kAvgIterations);
+    }
+
+    std::vector<uint8_t> query(const std::string &name, DNS::DnsEnum::QueryType type, bool edns, bool cookie) {
+        std::vector<uint8_t> packet = {0xBE, 0xEF, 0x01, 0x20, 0, 1, 0, 0, 0, 0, 0, static_cast<uint8_t>(edns ? 1 : 0)};
+        auto encoded = DNS::CreateResponse::domainToDnsFormat(name);
+        packet.insert(packet.end(), encoded.begin(), encoded.end());
+        uint16_t qtype = static_cast<uint16_t>(type);
+        packet.insert(packet.end(), {static_cast<uint8_t>(qtype >> 8), static_cast<uint8_t>(qtype & 0xFF), 0, 1});
+        if (edns) {
+            // OPT: root owner, 1232 byte payload, DO clear
+            packet.insert(packet.end(), {0, 0, 41, 0x04, 0xD0, 0, 0, 0, 0, 0, static_cast<uint8_t>(cookie ? 12 : 0)});
+            if (cookie) {
+                packet.insert(packet.end(), {0, 10, 0, 8, 0x24, 0xA1, 0x3C, 0x5B, 0x90, 0x0E, 0xD2, 0x41});
+            }
+        }
+        return packet;
+    }
+
+    const std::vector<std::vector<uint8_t>> &corpus() {
+        static const std::vector<std::vector<uint8_t>> packets = [] {
+            std::vector<std::vector<uint8_t>> all;
+            all.push_back(query("example.com", DNS::DnsEnum::QueryType::A, false, false));
+            all.push_back(query("www.example.com", DNS::DnsEnum::QueryType::AAAA, true, true));
+            all.push_back(query("mail.example.com", DNS::DnsEnum::QueryType::MX, true, false));
+            all.push_back(query("_sip._tcp.voice.eu-west-1.example.co.uk", DNS::DnsEnum::QueryType::SRV, true, true));
+            auto truncated = query("api.example.com", DNS::DnsEnum::QueryType::A, true, true);
+            truncated.resize(truncated.size() - 7);
+            all.push_back(truncated);
+            return all;
+        }();
+        return packets;
+    }
+
+    void BM_ParseDnsRequest(benchmark::State &state) {
+        const auto &packet = corpus()[state.range(0)];
+        measure(state, [&] {
+            benchmark::DoNotOptimize(DNS::ParseResponse::parseDnsRequest(packet));
+        });
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * packet.size()));
+    }
+    BENCHMARK(BM_ParseDnsRequest)->DenseRange(0, 4);
+
+    void BM_CreateResponse(benchmark::State &state) {
+        DnsRequestBody request = DNS::ParseResponse::parseDnsRequest(corpus()[1]);
+        std::pmr::list<AnswerSection> answers;
+        for (int i = 0; i < state.range(0); i++) {
+            answers.emplace_back(request.questionsSection.front().query, DNS::DnsEnum::QueryType::A,
+                                 DNS::DnsEnum::QueryClass::IN, 3600, "192.0.2." + std::to_string(i + 1));
+        }
+        uint16_t flags = static_cast<uint16_t>(DNS::DnsEnum::ResponseFlags::RESPONSE);
+        measure(state, [&] {
+            benchmark::DoNotOptimize(DNS::CreateResponse::createResponse(flags, answers, request.questionsSection,
+                                                                         request, 1232));
+        });
+    }
+    BENCHMARK(BM_CreateResponse)->Arg(0)->Arg(1)->Arg(8);
+
+    // Load-time encoding of text rows, one value per type
+    void BM_EncodeRData(benchmark::State &state) {
+        static const std::pair<DNS::DnsEnum::QueryType, std::string> values[] = {
+            {DNS::DnsEnum::QueryType::A, "203.0.113.254"},
+            {DNS::DnsEnum::QueryType::AAAA, "2001:db8::8a2e:370:7334"},
+            {DNS::DnsEnum::QueryType::MX, "10 mx1.example.com"},
+            {DNS::DnsEnum::QueryType::SRV, "10 60 5060 sip.voice.example.com"},
+            {DNS::DnsEnum::QueryType::TXT, "v=spf1 include:_spf.example.com ~all"},
+            {DNS::DnsEnum::QueryType::SOA, "ns1.example.com hostmaster.example.com 2024090601 3600 600 86400 300"}};
+        const auto &[type, value] = values[state.range(0)];
+        measure(state, [&] {
+            benchmark::DoNotOptimize(DNS::RData::encode(type, value));
+        });
+    }
+    BENCHMARK(BM_EncodeRData)->DenseRange(0, 5);
+
+    void BM_DomainToDnsFormat(benchmark::State &state) {
+        std::string domain = state.range(0) == 0 ? "example.com" : "_sip._tcp.voice.eu-west-1.example.co.uk";
+        measure(state, [&] {
+            benchmark::DoNotOptimize(DNS::CreateResponse::domainToDnsFormat(domain));
+        });
+    }
+    BENCHMARK(BM_DomainToDnsFormat)->Arg(0)->Arg(1);
+
+    void BM_SplitDomain(benchmark::State &state) {
+        std::string domain = state.range(0) == 0 ? "www.example.com" : "_sip._tcp.voice.eu-west-1.example.co.uk";
+        measure(state, [&] {
+            std::string subdomain, mainDomain;
+            DNS::ParseResponse::splitDomain(domain, subdomain, mainDomain);
+            benchmark::DoNotOptimize(subdomain);
+            benchmark::DoNotOptimize(mainDomain);
+        });
+    }
+    BENCHMARK(BM_SplitDomain)->Arg(0)->Arg(1);
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,549 @@
+// dns-replay: replays the DNS queries of a pcap/pcapng capture against a server
+// and checks the answers.
+//
+// Queries (UDP to --capture-port) are sent from one connected socket, either
+// with the capture's own timing scaled by --speed or as fast as possible
+// (--speed 0). Each query gets a fresh transaction ID so replies from many
+// captured clients cannot collide. With --golden the replies are compared with
+// the responses in a reference capture, matched by original ID and question;
+// TTLs and EDNS options (cookies) are ignored, and names inside rdata are
+// compared decompressed. --write-golden stores the replies as a new reference.
+// Ethernet, Linux cooked (v1/v2), BSD loopback and raw IP link types are read.
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../header/metrics.h"
+#include "../header/rdata.h"
+
+namespace {
+
+    struct Options {
+        std::string input;
+        std::string golden;
+        std::string writeGolden;
+        std::string server = "127.0.0.1";
+        int port = 53;
+        int capturePort = 53;
+        double speed = 1.0;
+        int timeoutMs = 1000;
+        int maxDiffs = 10;
+        bool compareTtl = false;
+    };
+
+    struct Packet {
+        double time;
+        std::vector<uint8_t> payload;
+    };
+
+    class Reader {
+    public:
+        explicit Reader(const std::vector<uint8_t> &data) : data(data) {}
+
+        bool has(size_t offset, size_t length) const { return offset + length <= data.size(); }
+
+        uint16_t u16(size_t offset) const {
+            return swapped ? data[offset] << 8 | data[offset + 1] : data[offset + 1] << 8 | data[offset];
+        }
+
+        uint32_t u32(size_t offset) const {
+            uint32_t value;
+            memcpy(&value, &data[offset], 4);
+            return swapped ? __builtin_bswap32(value) : value;
+        }
+
+        const std::vector<uint8_t> &data;
+        bool swapped = false;
+    };
+
+    uint16_t big16(const uint8_t *bytes) {
+        return bytes[0] << 8 | bytes[1];
+    }
+
+    // Strips link, IP and UDP headers; keeps DNS payloads between the given ports
+    bool extractDns(int linkType, const uint8_t *frame, size_t length, int capturePort, bool fromServer,
+                    std::vector<uint8_t> &payload) {
+        size_t offset = 0;
+        uint16_t etherType = 0;
+        switch (linkType) {
+            case 0: // BSD loopback
+                offset = 4;
+                if (length < 4) return false;
+                etherType = frame[0] == 2 || frame[3] == 2 ? 0x0800 : 0x86DD; // AF_INET in either byte order
+                break;
+            case 1: // Ethernet
+                if (length < 14) return false;
+                offset = 14;
+                etherType = big16(frame + 12);
+                while (etherType == 0x8100 && length >= offset + 4) {
+                    etherType = big16(frame + offset + 2);
+                    offset += 4;
+                }
+                break;
+            case 113: // Linux cooked
+                if (length < 16) return false;
+                offset = 16;
+                etherType = big16(frame + 14);
+                break;
+            case 276: // Linux cooked v2
+                if (length < 20) return false;
+                offset = 20;
+                etherType = big16(frame);
+                break;
+            case 101:
+            case 228:
+            case 229: // raw IP
+                if (length < 1) return false;
+                etherType = (frame[0] >> 4) == 6 ? 0x86DD : 0x0800;
+                break;
+            default:
+                return false;
+        }
+
+        size_t udp;
+        if (etherType == 0x0800) {
+            if (length < offset + 20 || frame[offset + 9] != 17 || (big16(frame + offset + 6) & 0x3FFF) != 0) {
+                return false;
+            }
+            udp = offset + (frame[offset] & 0x0F) * 4;
+        } else if (etherType == 0x86DD) {
+            if (length < offset + 40 || frame[offset + 6] != 17) {
+                return false;
+            }
+            udp = offset + 40;
+        } else {
+            return false;
+        }
+        if (length < udp + 8 + 12) {
+            return false;
+        }
+        uint16_t sourcePort = big16(frame + udp);
+        uint16_t destinationPort = big16(frame + udp + 2);
+        if ((fromServer ? sourcePort : destinationPort) != capturePort) {
+            return false;
+        }
+        size_t end = std::min(length, udp + big16(frame + udp + 4));
+        payload.assign(frame + udp + 8, frame + end);
+        bool isResponse = payload.size() >= 3 && (payload[2] & 0x80) != 0;
+        return isResponse == fromServer;
+    }
+
+    bool readCapture(const std::string &path, int capturePort, bool responses, std::vector<Packet> &packets) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Cannot open " << path << std::endl;
+            return false;
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        Reader in(data);
+        if (!in.has(0, 24)) {
+            std::cerr << path << ": too short for a capture" << std::endl;
+            return false;
+        }
+
+        uint32_t magic;
+        memcpy(&magic, data.data(), 4);
+        std::vector<uint8_t> payload;
+
+        if (magic == 0x0A0D0D0A) {
+            // pcapng: section header, interface descriptions, packet blocks
+            std::vector<std::pair<int, double>> interfaces; // link type, seconds per tick
+            size_t offset = 0;
+            while (in.has(offset, 12)) {
+                uint32_t type;
+                memcpy(&type, &data[offset], 4);
+                if (type == 0x0A0D0D0A) {
+                    uint32_t byteOrder;
+                    memcpy(&byteOrder, &data[offset + 8], 4);
+                    in.swapped = byteOrder != 0x1A2B3C4D;
+                    interfaces.clear();
+                } else {
+                    type = in.u32(offset);
+                }
+                uint32_t blockLength = in.u32(offset + 4);
+                if (blockLength < 12 || !in.has(offset, blockLength)) {
+                    break;
+                }
+                if (type == 1 && blockLength >= 20) {
+                    double resolution = 1e-6;
+                    for (size_t option = offset + 16; option + 4 <= offset + blockLength - 4;) {
+                        uint16_t code = in.u16(option), optionLength = in.u16(option + 2);
+                        if (code == 0) break;
+                        if (code == 9 && optionLength >= 1) {
+                            // if_tsresol: negative power of two or of ten
+                            uint8_t value = data[option + 4];
+                            resolution = std::pow(value & 0x80 ? 2.0 : 10.0, -static_cast<double>(value & 0x7F));
+                        }
+                        option += 4 + ((optionLength + 3) & ~3u);
+                    }
+                    interfaces.emplace_back(in.u16(offset + 8), resolution);
+                } else if (type == 6 && blockLength >= 32) {
+                    uint32_t interface = in.u32(offset + 8);
+                    uint32_t captured = in.u32(offset + 20);
+                    if (interface < interfaces.size() && offset + 28 + captured <= offset + blockLength) {
+                        uint64_t ticks = static_cast<uint64_t>(in.u32(offset + 12)) << 32 | in.u32(offset + 16);
+                        if (extractDns(interfaces[interface].first, &data[offset + 28], captured, capturePort, responses, payload)) {
+                            packets.push_back({ticks * interfaces[interface].second, payload});
+                        }
+                    }
+                } else if (type == 3 && blockLength >= 16 && !interfaces.empty()) {
+                    uint32_t captured = std::min<uint32_t>(in.u32(offset + 8), blockLength - 16);
+                    if (extractDns(interfaces[0].first, &data[offset + 12], captured, capturePort, responses, payload)) {
+                        packets.push_back({packets.empty() ? 0 : packets.back().time, payload});
+                    }
+                }
+                offset += blockLength;
+            }
+            return true;
+        }
+
+        double resolution;
+        if (magic == 0xA1B2C3D4 || magic == 0xD4C3B2A1) {
+            resolution = 1e-6;
+        } else if (magic == 0xA1B23C4D || magic == 0x4D3CB2A1) {
+            resolution = 1e-9;
+        } else {
+            std::cerr << path << ": not a pcap or pcapng file" << std::endl;
+            return false;
+        }
+        in.swapped = magic == 0xD4C3B2A1 || magic == 0x4D3CB2A1;
+        int linkType = static_cast<int>(in.u32(20) & 0x0FFFFFFF);
+        for (size_t offset = 24; in.has(offset, 16);) {
+            uint32_t captured = in.u32(offset + 8);
+            if (!in.has(offset + 16, captured)) {
+                break;
+            }
+            double time = in.u32(offset) + in.u32(offset + 4) * resolution;
+            if (extractDns(linkType, &data[offset + 16], captured, capturePort, responses, payload)) {
+                packets.push_back({time, payload});
+            }
+            offset += 16 + captured;
+        }
+        return true;
+    }
+
+    // Raw-IP pcap with synthetic IPv4/UDP headers from server:53 to the client
+    void writeCapture(const std::string &path, const std::vector<std::vector<uint8_t>> &responses) {
+        std::ofstream file(path, std::ios::binary);
+        auto put32 = [&file](uint32_t value) { file.write(reinterpret_cast<const char *>(&value), 4); };
+        auto put16 = [&file](uint16_t value) { file.write(reinterpret_cast<const char *>(&value), 2); };
+        put32(0xA1B2C3D4);
+        put16(2);
+        put16(4);
+        put32(0);
+        put32(0);
+        put32(65535);
+        put32(101);
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+        uint32_t seconds = std::chrono::duration_cast<std::chrono::seconds>(now).count();
+        uint32_t micros = std::chrono::duration_cast<std::chrono::microseconds>(now).count() % 1000000;
+        for (const auto &response: responses) {
+            if (response.empty()) {
+                continue;
+            }
+            uint16_t udpLength = response.size() + 8, ipLength = udpLength + 20;
+            uint8_t headers[28] = {0x45, 0, static_cast<uint8_t>(ipLength >> 8), static_cast<uint8_t>(ipLength & 0xFF),
+                                   0, 0, 0x40, 0, 64, 17, 0, 0, 127, 0, 0, 1, 127, 0, 0, 1,
+                                   0, 53, 0x30, 0x39, static_cast<uint8_t>(udpLength >> 8),
+                                   static_cast<uint8_t>(udpLength & 0xFF), 0, 0};
+            uint32_t sum = 0;
+            for (int i = 0; i < 20; i += 2) sum += headers[i] << 8 | headers[i + 1];
+            while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+            headers[10] = static_cast<uint8_t>(~sum >> 8);
+            headers[11] = static_cast<uint8_t>(~sum & 0xFF);
+            put32(seconds);
+            put32(micros);
+            put32(ipLength);
+            put32(ipLength);
+            file.write(reinterpret_cast<const char *>(headers), sizeof(headers));
+            file.write(reinterpret_cast<const char *>(response.data()), response.size());
+        }
+    }
+
+    // Reads a possibly compressed name as lowercase text; false if malformed
+    bool readName(const std::vector<uint8_t> &packet, size_t &pos, std::string &name) {
+        size_t cursor = pos;
+        bool jumped = false;
+        for (int hops = 0; hops < 64; hops++) {
+            if (cursor >= packet.size()) return false;
+            uint8_t length = packet[cursor];
+            if (length == 0) {
+                if (!jumped) pos = cursor + 1;
+                if (name.empty()) name = ".";
+                return true;
+            }
+            if ((length & 0xC0) == 0xC0) {
+                if (cursor + 1 >= packet.size()) return false;
+                if (!jumped) pos = cursor + 2;
+                jumped = true;
+                cursor = (length & 0x3F) << 8 | packet[cursor + 1];
+                continue;
+            }
+            if (cursor + 1 + length > packet.size()) return false;
+            for (size_t i = cursor + 1; i <= cursor + length; i++) name += static_cast<char>(tolower(packet[i]));
+            name += '.';
+            cursor += 1 + length;
+        }
+        return false;
+    }
+
+    // Text form of a message that ignores ID, TTLs, EDNS options and compression
+    std::string canonical(const std::vector<uint8_t> &packet, bool compareTtl) {
+        if (packet.size() < 12) {
+            return "<short packet>";
+        }
+        std::string out = "flags=" + std::to_string(big16(&packet[2]) & 0xFFFF);
+        size_t pos = 12;
+        uint16_t counts[4] = {big16(&packet[4]), big16(&packet[6]), big16(&packet[8]), big16(&packet[10])};
+        static const char *sections[4] = {"\nquestion", "\nanswer", "\nauthority", "\nadditional"};
+        for (int section = 0; section < 4; section++) {
+            std::vector<std::string> records;
+            for (int i = 0; i < counts[section]; i++) {
+                std::string owner;
+                if (!readName(packet, pos, owner) || pos + 4 > packet.size()) return out + "\n<malformed>";
+                uint16_t type = big16(&packet[pos]), rclass = big16(&packet[pos + 2]);
+                pos += 4;
+                std::string record = owner + " " + std::to_string(type) + " " + std::to_string(rclass);
+                if (section == 0) {
+                    records.push_back(record);
+                    continue;
+                }
+                if (pos + 6 > packet.size()) return out + "\n<malformed>";
+                uint32_t ttl = static_cast<uint32_t>(big16(&packet[pos])) << 16 | big16(&packet[pos + 2]);
+                uint16_t length = big16(&packet[pos + 4]);
+                pos += 6;
+                if (pos + length > packet.size()) return out + "\n<malformed>";
+                size_t end = pos + length;
+                if (type == 41) {
+                    // OPT: payload size and extended rcode/flags only
+                    records.push_back("OPT " + std::to_string(rclass) + " " + std::to_string(ttl));
+                    pos = end;
+                    continue;
+                }
+                if (compareTtl) record += " ttl=" + std::to_string(ttl);
+                std::string rdata;
+                if (type == 46) {
+                    rdata = "<rrsig>"; // signatures differ from run to run
+                } else {
+                    try {
+                        rdata = DNS::RData::toText(type, packet.data(), packet.size(), pos, length, true);
+                    } catch (const DNS::RData::Error &e) {
+                        rdata = std::string("<") + e.what() + ">";
+                    }
+                }
+                records.push_back(record + " " + rdata);
+                pos = end;
+            }
+            if (section != 0) std::sort(records.begin(), records.end());
+            for (const auto &record: records) out += sections[section] + (" " + record);
+        }
+        return out;
+    }
+
+    // Key for matching a reply with the golden one: original ID plus question
+    std::string matchKey(const std::vector<uint8_t> &packet) {
+        std::string key = std::to_string(big16(packet.data()));
+        size_t pos = 12;
+        if (big16(&packet[4]) > 0 && readName(packet, pos, key) && pos + 4 <= packet.size()) {
+            key += std::to_string(big16(&packet[pos])) + "/" + std::to_string(big16(&packet[pos + 2]));
+        }
+        return key;
+    }
+
+    void usage() {
+        std::cerr << "usage: dns-replay --input capture.pcap[ng] [--server 127.x.x.x] [--port n]\n"
+                     "                  [--capture-port n] [--speed x (0 = as fast as possible)] [--timeout-ms n]\n"
+                     "                  [--golden reference.pcap] [--write-golden out.pcap] [--compare-ttl 1]\n"
+                     "                  [--max-diffs n]\n";
+    }
+
+    // The tools put real load on what they point at, so they only aim at this host
+    bool loopback(const std::string &address) {
+        in_addr parsed{};
+        if (inet_pton(AF_INET, address.c_str(), &parsed) != 1 || (ntohl(parsed.s_addr) >> 24) != 127) {
+            std::cerr << "--server must be a loopback address (127.0.0.0/8): " << address << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool parseOptions(int argc, char **argv, Options &options) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string arg = argv[i], value = argv[i + 1];
+            try {
+                if (arg == "--input") options.input = value;
+                else if (arg == "--golden") options.golden = value;
+                else if (arg == "--write-golden") options.writeGolden = value;
+                else if (arg == "--server") options.server = value;
+                else if (arg == "--port") options.port = std::stoi(value);
+                else if (arg == "--capture-port") options.capturePort = std::stoi(value);
+                else if (arg == "--speed") options.speed = std::stod(value);
+                else if (arg == "--timeout-ms") options.timeoutMs = std::stoi(value);
+                else if (arg == "--max-diffs") options.maxDiffs = std::stoi(value);
+                else if (arg == "--compare-ttl") options.compareTtl = value != "0";
+                else return false;
+            } catch (const std::logic_error &) {
+                std::cerr << "bad value for " << arg << ": " << value << std::endl;
+                return false;
+            }
+        }
+        return argc % 2 == 1 && !options.input.empty() && loopback(options.server);
+    }
+
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    std::vector<Packet> queries;
+    if (!readCapture(options.input, options.capturePort, false, queries)) {
+        return 1;
+    }
+    if (queries.empty()) {
+        std::cerr << "No DNS queries to port " << options.capturePort << " in " << options.input << std::endl;
+        return 1;
+    }
+    if (queries.size() > 65536) {
+        std::cout << "Replaying the first 65536 of " << queries.size() << " queries\n";
+        queries.resize(65536);
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(options.port);
+    if (fd < 0 || inet_pton(AF_INET, options.server.c_str(), &server.sin_addr) != 1 ||
+        connect(fd, (const struct sockaddr *)&server, sizeof(server)) < 0) {
+        perror("socket setup failed");
+        return 1;
+    }
+    int bufferSize = 8 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+    // Replies indexed by replay sequence number, which is also the wire ID
+    std::vector<std::vector<uint8_t>> replies(queries.size());
+    std::vector<std::atomic<int64_t>> sentAt(queries.size());
+    std::vector<uint64_t> latency(DNS::Metrics::HISTOGRAM_BUCKETS, 0);
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> received(0);
+
+    std::thread receiver([&] {
+        std::vector<uint8_t> buffer(65535);
+        timeval timeout{0, 100000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        while (!stop.load()) {
+            ssize_t n = recv(fd, buffer.data(), buffer.size(), 0);
+            if (n < 12) continue;
+            uint16_t index = big16(buffer.data());
+            if (index >= replies.size() || !replies[index].empty()) continue;
+            int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+            latency[DNS::Metrics::bucketIndex(now - sentAt[index].load())]++;
+            replies[index].assign(buffer.begin(), buffer.begin() + n);
+            // Put the captured ID back so replies can be matched with the golden capture
+            replies[index][0] = queries[index].payload[0];
+            replies[index][1] = queries[index].payload[1];
+            received++;
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queries.size(); i++) {
+        if (options.speed > 0) {
+            auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>((queries[i].time - queries[0].time) / options.speed));
+            std::this_thread::sleep_until(due);
+        }
+        std::vector<uint8_t> packet = queries[i].payload;
+        packet[0] = static_cast<uint8_t>(i >> 8);
+        packet[1] = static_cast<uint8_t>(i & 0xFF);
+        sentAt[i].store(std::chrono::steady_clock::now().time_since_epoch().count());
+        if (send(fd, packet.data(), packet.size(), 0) < 0) {
+            perror("send failed");
+        }
+    }
+    double sendSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeoutMs);
+    while (received.load() < queries.size() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    stop.store(true);
+    receiver.join();
+    close(fd);
+
+    size_t answered = received.load();
+    double capturedSeconds = queries.back().time - queries.front().time;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Queries replayed:  " << queries.size() << " in " << sendSeconds << " s ("
+              << queries.size() / std::max(sendSeconds, 1e-9) << " qps; capture spans " << capturedSeconds << " s)\n";
+    std::cout << "Replies received:  " << answered << " (" << queries.size() - answered << " lost)\n";
+    if (answered != 0) {
+        auto quantile = [&](double q) {
+            uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(answered - 1)) + 1, seen = 0;
+            for (int i = 0; i < DNS::Metrics::HISTOGRAM_BUCKETS; i++) {
+                if ((seen += latency[i]) >= rank) return DNS::Metrics::bucketValue(i) / 1e6;
+            }
+            return 0.0;
+        };
+        std::cout << "Latency (ms):      p50 " << quantile(0.5) << "  p99 " << quantile(0.99) << "  max " << quantile(1.0) << '\n';
+    }
+
+    if (!options.writeGolden.empty()) {
+        writeCapture(options.writeGolden, replies);
+        std::cout << "Wrote " << answered << " replies to " << options.writeGolden << '\n';
+    }
+
+    int status = 0;
+    if (!options.golden.empty()) {
+        std::vector<Packet> goldenPackets;
+        if (!readCapture(options.golden, options.capturePort, true, goldenPackets)) {
+            return 1;
+        }
+        std::map<std::string, std::deque<const std::vector<uint8_t> *>> golden;
+        for (const auto &packet: goldenPackets) {
+            golden[matchKey(packet.payload)].push_back(&packet.payload);
+        }
+        size_t matched = 0, differing = 0, missing = 0;
+        for (size_t i = 0; i < queries.size(); i++) {
+            auto it = golden.find(matchKey(queries[i].payload));
+            if (it == golden.end() || it->second.empty()) {
+                missing++;
+                continue;
+            }
+            const std::vector<uint8_t> &expected = *it->second.front();
+            it->second.pop_front();
+            std::string want = canonical(expected, options.compareTtl);
+            std::string got = replies[i].empty() ? "<no reply>" : canonical(replies[i], options.compareTtl);
+            if (want == got) {
+                matched++;
+                continue;
+            }
+            if (static_cast<int>(differing++) < options.maxDiffs) {
+                std::cout << "--- query " << i << " expected:\n" << want << "\n+++ got:\n" << got << '\n';
+            }
+        }
+        std::cout << "Golden comparison: " << matched << " identical, " << differing << " different, "
+                  << missing << " without a golden response\n";
+        status = differing == 0 ? 0 : 2;
+    }
+    return status;
+}